@@ -50,6 +50,10 @@ struct SourceMetaData {
   int fd{-1};
   /// If true, fd was opened by wdt and must be closed after transfer finish
   bool needToClose{false};
+  /// sending priority, @see WdtFileInfo
+  int32_t priority{0};
+  /// sending deadline in milliseconds, 0 for none. @see WdtFileInfo
+  int64_t deadlineMillis{0};
 };
 
 class ByteSource {
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/MultiSender.h>
+
+#include <folly/Memory.h>
+
+namespace facebook {
+namespace wdt {
+
+MultiSender::MultiSender(
+    const std::vector<WdtTransferRequest> &transferRequests)
+    : discoveryAbortChecker_(discoveryAborted_) {
+  WDT_CHECK(!transferRequests.empty());
+  options_.copyInto(WdtOptions::get());
+  const std::string &srcDir = transferRequests[0].directory;
+  for (const auto &request : transferRequests) {
+    WDT_CHECK_EQ(srcDir, request.directory);
+    senders_.emplace_back(folly::make_unique<Sender>(request));
+    senders_.back()->enableBlockForwarding();
+  }
+  started_.resize(senders_.size(), false);
+  discoveryQueue_ = folly::make_unique<DirectorySourceQueue>(
+      options_, srcDir, &discoveryAbortChecker_);
+  discoveryQueue_->setIncludePattern(options_.include_regex);
+  discoveryQueue_->setExcludePattern(options_.exclude_regex);
+  discoveryQueue_->setPruneDirPattern(options_.prune_dir_regex);
+  discoveryQueue_->setFollowSymlinks(options_.follow_symlinks);
+  discoveryQueue_->setBlockSizeMbytes(options_.block_size_mbytes);
+  // the destinations open the files themselves
+  discoveryQueue_->setOpenFilesDuringDiscovery(0);
+  discoveryQueue_->setBlockListener(this);
+}
+
+MultiSender::~MultiSender() {
+  if (discoveryThread_.joinable()) {
+    discoveryAborted_.store(true);
+    discoveryThread_.join();
+  }
+}
+
+ErrorCode MultiSender::transferAsync() {
+  ErrorCode firstError = OK;
+  int numStarted = 0;
+  // set before the senders start, a sender leaves the cache when it ends
+  const int64_t maxBytes = options_.shared_read_buffer_mbytes * kMbToB;
+  blockCache_ =
+      folly::make_unique<SharedBlockCache>(senders_.size(), maxBytes);
+  for (size_t i = 0; i < senders_.size(); i++) {
+    senders_[i]->setBlockCache(blockCache_.get(), i);
+  }
+  for (size_t i = 0; i < senders_.size(); i++) {
+    ErrorCode code = senders_[i]->transferAsync();
+    if (code != OK) {
+      LOG(ERROR) << "Unable to start the transfer to destination " << i << " "
+                 << errorCodeToStr(code);
+      if (firstError == OK) {
+        firstError = code;
+      }
+      blockCache_->removeConsumer(i);
+      continue;
+    }
+    started_[i] = true;
+    numStarted++;
+  }
+  LOG(INFO) << "Sending to " << numStarted << " destinations out of "
+            << senders_.size();
+  discoveryThread_ = discoveryQueue_->buildQueueAsynchronously();
+  return firstError;
+}
+
+std::vector<std::unique_ptr<TransferReport>> MultiSender::finish() {
+  if (discoveryThread_.joinable()) {
+    discoveryThread_.join();
+  }
+  std::vector<std::unique_ptr<TransferReport>> reports;
+  for (auto &sender : senders_) {
+    reports.emplace_back(sender->finish());
+  }
+  return reports;
+}
+
+void MultiSender::abort(ErrorCode abortCode) {
+  discoveryAborted_.store(true);
+  for (auto &sender : senders_) {
+    sender->abort(abortCode);
+  }
+}
+
+int MultiSender::getNumDestinations() const {
+  return senders_.size();
+}
+
+Sender &MultiSender::getSender(int index) {
+  return *senders_[index];
+}
+
+void MultiSender::onBlockDiscovered(const SourceMetaData &metadata,
+                                    int64_t offset, int64_t size) {
+  for (size_t i = 0; i < senders_.size(); i++) {
+    // a destination which did not start or already ended would not send it
+    if (started_[i] && !senders_[i]->isStale()) {
+      senders_[i]->forwardBlock(metadata.relPath, metadata.size, offset,
+                                size);
+    }
+  }
+}
+
+void MultiSender::onDiscoveryFinished() {
+  for (auto &sender : senders_) {
+    sender->finishForwarding();
+  }
+}
+}
+}
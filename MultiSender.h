@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/AbortChecker.h>
+#include <wdt/Sender.h>
+#include <wdt/util/SharedBlockCache.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Sends the same directory to several receivers. The directory is discovered
+ * once and every block is read once from the disk for all the destinations
+ * (@see SharedBlockCache). Each destination has its own Sender, and so its
+ * own connections, checkpoints, retries and throttler: a slow or failing
+ * destination does not stall the others beyond shared_read_buffer_mbytes of
+ * blocks, it reads what it missed again.
+ * Download resumption is not supported, every destination gets all the
+ * files.
+ */
+class MultiSender : public BlockListener {
+ public:
+  /**
+   * @param transferRequests    one request per destination, all of them
+   *                            sending the same directory
+   */
+  explicit MultiSender(
+      const std::vector<WdtTransferRequest> &transferRequests);
+
+  /// Joins the discovery, the transfers have to be finished
+  virtual ~MultiSender();
+
+  /**
+   * Starts the transfers to all the destinations. The destinations which
+   * could not start end with an error in their report
+   *
+   * @return    OK if all the transfers started, error of the first one which
+   *            did not otherwise
+   */
+  ErrorCode transferAsync();
+
+  /**
+   * Waits for all the transfers to end
+   *
+   * @return    report of every destination, in the order of the requests
+   */
+  std::vector<std::unique_ptr<TransferReport>> finish();
+
+  /// Aborts the discovery and the transfers to all the destinations
+  void abort(ErrorCode abortCode);
+
+  /// @return   number of destinations
+  int getNumDestinations() const;
+
+  /// @return   sender of a destination, to configure it before starting
+  Sender &getSender(int index);
+
+  /// @see BlockListener
+  void onBlockDiscovered(const SourceMetaData &metadata, int64_t offset,
+                         int64_t size) override;
+
+  /// @see BlockListener
+  void onDiscoveryFinished() override;
+
+ private:
+  /// Options used for the discovery and the shared buffer
+  WdtOptions options_;
+
+  /// Blocks read once for the started destinations, outlives the senders
+  std::unique_ptr<SharedBlockCache> blockCache_;
+
+  /// Sender of every destination
+  std::vector<std::unique_ptr<Sender>> senders_;
+
+  /// Whether the sender of a destination started
+  std::vector<bool> started_;
+
+  /// Set to abort the discovery
+  std::atomic<bool> discoveryAborted_{false};
+
+  /// Abort checker of the discovery
+  WdtAbortChecker discoveryAbortChecker_;
+
+  /// Queue discovering the directory for all the destinations
+  std::unique_ptr<DirectorySourceQueue> discoveryQueue_;
+
+  /// Thread running the discovery
+  std::thread discoveryThread_;
+};
+}
+}
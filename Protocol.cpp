@@ -14,6 +14,7 @@
 
 #include <folly/String.h>  // exceptionStr
 #include <algorithm>
+#include <cstring>
 #include <folly/Bits.h>
 
 namespace facebook {
@@ -34,6 +35,11 @@ const int Protocol::CHECKPOINT_SEQ_ID_VERSION = 21;
 const int Protocol::ENCRYPTION_V1_VERSION = 23;
 const int Protocol::INCREMENTAL_TAG_VERIFICATION_VERSION = 25;
 const int Protocol::DELETE_CMD_VERSION = 26;
+const int Protocol::FILE_NAME_DICTIONARY_VERSION = 27;
+const int Protocol::BATCH_CMD_VERSION = 28;
+const int Protocol::CONNECTION_REUSE_VERSION = 29;
+const int Protocol::SINGLE_PORT_VERSION = 30;
+const int Protocol::DYNAMIC_PARALLELISM_VERSION = 31;
 
 const std::string Protocol::getFullVersion() {
   std::string fullVersion(WDT_VERSION_STR);
@@ -130,7 +136,14 @@ int Protocol::getMaxLocalCheckpointLength(int protocolVersion) {
 }
 
 void Protocol::encodeHeader(int senderProtocolVersion, char *dest, int64_t &off,
-                            int64_t max, const BlockDetails &blockDetails) {
+                            int64_t max, const BlockDetails &blockDetails,
+                            FileNameDictionary *dictionary) {
+  if (senderProtocolVersion >= FILE_NAME_DICTIONARY_VERSION) {
+    WDT_CHECK(dictionary != nullptr) << "Name dictionary needed for version "
+                                     << senderProtocolVersion;
+    encodeHeaderWithDictionary(dest, off, max, blockDetails, *dictionary);
+    return;
+  }
   encodeString(dest, off, blockDetails.fileName);
   encodeInt(dest, off, blockDetails.seqId);
   encodeInt(dest, off, blockDetails.dataSize);
@@ -150,7 +163,14 @@ void Protocol::encodeHeader(int senderProtocolVersion, char *dest, int64_t &off,
 
 bool Protocol::decodeHeader(int receiverProtocolVersion, char *src,
                             int64_t &off, int64_t max,
-                            BlockDetails &blockDetails) {
+                            BlockDetails &blockDetails,
+                            FileNameDictionary *dictionary) {
+  if (receiverProtocolVersion >= FILE_NAME_DICTIONARY_VERSION) {
+    WDT_CHECK(dictionary != nullptr) << "Name dictionary needed for version "
+                                     << receiverProtocolVersion;
+    return decodeHeaderWithDictionary(src, off, max, blockDetails,
+                                      *dictionary);
+  }
   folly::ByteRange br((uint8_t *)(src + off), max);
   try {
     if (!decodeString(br, src, max, blockDetails.fileName)) {
@@ -182,6 +202,132 @@ bool Protocol::decodeHeader(int receiverProtocolVersion, char *src,
   return !checkForOverflow(off, max);
 }
 
+void Protocol::encodeHeaderWithDictionary(char *dest, int64_t &off,
+                                          int64_t max,
+                                          const BlockDetails &blockDetails,
+                                          FileNameDictionary &dictionary) {
+  encodeInt(dest, off, blockDetails.seqId);
+  encodeInt(dest, off, blockDetails.dataSize);
+  encodeInt(dest, off, blockDetails.offset);
+  FileNameDictionary::Slot &slot = dictionary.getSlot(blockDetails.seqId);
+  // a stream only knows its size at the end, a change is sent again
+  const bool sendName = (slot.seqId != blockDetails.seqId ||
+                         slot.fileSize != blockDetails.fileSize);
+  uint8_t flags = blockDetails.allocationStatus;
+  if (sendName) {
+    flags |= kHeaderFileNameFlag;
+  }
+  dest[off++] = flags;
+  if (sendName) {
+    // front coding: only the part differing from the last name is sent
+    const string &fileName = blockDetails.fileName;
+    string &lastName = dictionary.lastName_;
+    const size_t maxPrefix = std::min(fileName.size(), lastName.size());
+    size_t prefixLen = 0;
+    while (prefixLen < maxPrefix && fileName[prefixLen] == lastName[prefixLen]) {
+      prefixLen++;
+    }
+    const int64_t suffixLen = fileName.size() - prefixLen;
+    encodeInt(dest, off, prefixLen);
+    encodeInt(dest, off, suffixLen);
+    memcpy(dest + off, fileName.data() + prefixLen, suffixLen);
+    off += suffixLen;
+    encodeInt(dest, off, blockDetails.fileSize);
+    slot.seqId = blockDetails.seqId;
+    slot.fileSize = blockDetails.fileSize;
+    lastName.assign(fileName);
+  }
+  if (blockDetails.allocationStatus == EXISTS_TOO_SMALL ||
+      blockDetails.allocationStatus == EXISTS_TOO_LARGE) {
+    encodeInt(dest, off, blockDetails.prevSeqId);
+  }
+  WDT_CHECK(off <= max) << "Memory corruption:" << off << " " << max;
+}
+
+bool Protocol::decodeHeaderWithDictionary(char *src, int64_t &off, int64_t max,
+                                          BlockDetails &blockDetails,
+                                          FileNameDictionary &dictionary) {
+  folly::ByteRange br((uint8_t *)(src + off), max);
+  int64_t seqId, dataSize, offset, prevSeqId = 0;
+  int64_t prefixLen = 0, suffixLen = 0, fileSize = 0;
+  const char *suffix = nullptr;
+  FileAllocationStatus allocationStatus;
+  bool hasName;
+  // nothing is modified until the whole header is validated, so that the
+  // dictionary stays in sync with the sender's
+  try {
+    seqId = decodeInt(br);
+    dataSize = decodeInt(br);
+    offset = decodeInt(br);
+    if (!(br.size() >= 1)) {
+      LOG(ERROR) << "Invalid (too short) input " << string(src + off, max);
+      return false;
+    }
+    uint8_t flags = br.front();
+    br.pop_front();
+    // first 3 bits are used to represent allocation status
+    allocationStatus = (FileAllocationStatus)(flags & 7);
+    hasName = (flags & kHeaderFileNameFlag);
+    if (hasName) {
+      prefixLen = decodeInt(br);
+      suffixLen = decodeInt(br);
+      if (prefixLen < 0 || prefixLen > (int64_t)dictionary.lastName_.size() ||
+          suffixLen < 0 || prefixLen + suffixLen > PATH_MAX) {
+        LOG(ERROR) << "Invalid file name encoding, prefix " << prefixLen
+                   << " suffix " << suffixLen << " last name length "
+                   << dictionary.lastName_.size();
+        return false;
+      }
+      int64_t suffixOff = br.start() - (uint8_t *)src;
+      if (suffixOff + suffixLen > max) {
+        LOG(ERROR) << "Not enough room with " << max << " to decode "
+                   << suffixLen << " at " << suffixOff;
+        return false;
+      }
+      suffix = (const char *)br.start();
+      br.advance(suffixLen);
+      fileSize = decodeInt(br);
+    }
+    if (allocationStatus == EXISTS_TOO_SMALL ||
+        allocationStatus == EXISTS_TOO_LARGE) {
+      prevSeqId = decodeInt(br);
+    }
+  } catch (const std::exception &ex) {
+    LOG(ERROR) << "got exception " << folly::exceptionStr(ex);
+    return false;
+  }
+  int64_t newOff = br.start() - (uint8_t *)src;
+  if (checkForOverflow(newOff, max)) {
+    return false;
+  }
+  if (seqId < 0) {
+    LOG(ERROR) << "Invalid seq-id " << seqId;
+    return false;
+  }
+  FileNameDictionary::Slot &slot = dictionary.getSlot(seqId);
+  if (hasName) {
+    string &lastName = dictionary.lastName_;
+    lastName.resize(prefixLen);
+    lastName.append(suffix, suffixLen);
+    slot.seqId = seqId;
+    slot.fileSize = fileSize;
+    slot.fileName.assign(lastName);
+  } else if (slot.seqId != seqId) {
+    LOG(ERROR) << "Header without file name for unknown seq-id " << seqId;
+    return false;
+  }
+  // assign() reuses the existing capacity of the strings
+  blockDetails.fileName.assign(slot.fileName);
+  blockDetails.seqId = seqId;
+  blockDetails.fileSize = slot.fileSize;
+  blockDetails.offset = offset;
+  blockDetails.dataSize = dataSize;
+  blockDetails.allocationStatus = allocationStatus;
+  blockDetails.prevSeqId = prevSeqId;
+  off = newOff;
+  return true;
+}
+
 void Protocol::encodeCheckpoints(int protocolVersion, char *dest, int64_t &off,
                                  int64_t max,
                                  const std::vector<Checkpoint> &checkpoints) {
@@ -315,6 +461,23 @@ void Protocol::decodeChunksCmd(char *src, int64_t &off, int64_t &bufSize,
   off += sizeof(int64_t);
 }
 
+void Protocol::encodeConnectionCmd(char *dest, int64_t &off, int32_t key) {
+  dest[off++] = CONNECTION_CMD;
+  folly::storeUnaligned<int32_t>(dest + off, folly::Endian::little(key));
+  off += sizeof(int32_t);
+}
+
+bool Protocol::decodeConnectionCmd(char *src, int64_t &off, int32_t &key) {
+  if (src[off] != CONNECTION_CMD) {
+    return false;
+  }
+  off++;
+  key = folly::loadUnaligned<int32_t>(src + off);
+  key = folly::Endian::little(key);
+  off += sizeof(int32_t);
+  return true;
+}
+
 void Protocol::encodeChunkInfo(char *dest, int64_t &off, int64_t max,
                                const Interval &chunk) {
   encodeInt(dest, off, chunk.start_);
@@ -440,6 +603,14 @@ void Protocol::encodeSettings(int senderProtocolVersion, char *dest,
     if (settings.blockModeDisabled) {
       flags |= (1 << 2);
     }
+    if (settings.keepConnection &&
+        senderProtocolVersion >= CONNECTION_REUSE_VERSION) {
+      flags |= (1 << 3);
+    }
+    if (settings.dynamicParallelism &&
+        senderProtocolVersion >= DYNAMIC_PARALLELISM_VERSION) {
+      flags |= (1 << 4);
+    }
     dest[off++] = flags;
   }
   WDT_CHECK(off <= max) << "Memory corruption:" << off << " " << max;
@@ -461,6 +632,7 @@ bool Protocol::decodeVersion(char *src, int64_t &off, int64_t max,
 bool Protocol::decodeSettings(int protocolVersion, char *src, int64_t &off,
                               int64_t max, Settings &settings) {
   settings.enableChecksum = settings.sendFileChunks = false;
+  settings.keepConnection = settings.dynamicParallelism = false;
   folly::ByteRange br((uint8_t *)(src + off), max);
   try {
     settings.readTimeoutMillis = decodeInt(br);
@@ -473,6 +645,12 @@ bool Protocol::decodeSettings(int protocolVersion, char *src, int64_t &off,
       settings.enableChecksum = flags & 1;
       settings.sendFileChunks = flags & (1 << 1);
       settings.blockModeDisabled = flags & (1 << 2);
+      if (protocolVersion >= CONNECTION_REUSE_VERSION) {
+        settings.keepConnection = flags & (1 << 3);
+      }
+      if (protocolVersion >= DYNAMIC_PARALLELISM_VERSION) {
+        settings.dynamicParallelism = flags & (1 << 4);
+      }
       br.pop_front();
     }
   } catch (const std::exception &ex) {
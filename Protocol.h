@@ -202,6 +202,48 @@ struct BlockDetails {
   int64_t prevSeqId{0};
 };
 
+/**
+ * Per connection state used to avoid resending file names in every block
+ * header. The first header of a seq-id carries the name (front coded against
+ * the last name sent on the connection) and the file size, later headers of
+ * the same seq-id only carry the seq-id. Sender and receiver update their
+ * dictionaries in the same order, so they must be reset whenever a new
+ * connection is established.
+ */
+class FileNameDictionary {
+ public:
+  /// number of seq-ids remembered, older entries are evicted on collision
+  static const int kNumSlots = 256;
+
+  /// forgets all the names, must be called for every new connection
+  void reset() {
+    for (Slot &slot : slots_) {
+      slot.seqId = -1;
+    }
+    lastName_.clear();
+  }
+
+ private:
+  friend class Protocol;
+
+  struct Slot {
+    /// seq-id of the file, -1 if the slot is empty
+    int64_t seqId{-1};
+    /// size of the file
+    int64_t fileSize{0};
+    /// name of the file, only filled on the receiver side
+    std::string fileName;
+  };
+
+  Slot &getSlot(int64_t seqId) {
+    return slots_[seqId % kNumSlots];
+  }
+
+  Slot slots_[kNumSlots];
+  /// last file name sent/received on the connection
+  std::string lastName_;
+};
+
 /// structure representing settings cmd
 struct Settings {
   /// sender side read timeout
@@ -216,6 +258,11 @@ struct Settings {
   bool sendFileChunks{0};
   /// whether block mode is disabled
   bool blockModeDisabled{false};
+  /// whether sender wants to keep the connection open after the transfer
+  bool keepConnection{false};
+  /// whether sender adds connections during the transfer, so the receiver
+  /// keeps waiting for the ones not connected yet
+  bool dynamicParallelism{false};
 };
 
 class Protocol {
@@ -246,6 +293,19 @@ class Protocol {
   static const int INCREMENTAL_TAG_VERIFICATION_VERSION;
   /// version from which file deletion was supported for resumption
   static const int DELETE_CMD_VERSION;
+  /// version from which file names are only sent with the first block of a
+  /// file and are front coded
+  static const int FILE_NAME_DICTIONARY_VERSION;
+  /// version from which small blocks can be sent in batches
+  static const int BATCH_CMD_VERSION;
+  /// version from which connections can be kept open and reused by the next
+  /// transfer to a long running receiver
+  static const int CONNECTION_REUSE_VERSION;
+  /// version from which a receiver can accept all the connections on a
+  /// single port
+  static const int SINGLE_PORT_VERSION;
+  /// version from which sender can open connections during the transfer
+  static const int DYNAMIC_PARALLELISM_VERSION;
 
   /// Both version, magic number and command byte
   enum CMD_MAGIC {
@@ -266,14 +326,21 @@ class Protocol {
                // number of checkpoints for local checkpoint is 1, we can treat
                // 0x01 to be a separate cmd
     ENCRYPTION_CMD = 0x65,  // (e)ncryption
+    BATCH_CMD = 0x42,       // B)atch
+    CONNECTION_CMD = 0x4E,  // coN)nection key, for single port receivers
   };
 
   /// Max size of sender or receiver id
   static const int64_t kMaxTransferIdLength = 50;
-  /// 1 byte for cmd, 2 bytes for file-name length, Max size of filename, 4
-  /// variants(seq-id, data-size, offset, file-size), 1 byte for flag, 10 bytes
-  /// prev seq-id
-  static const int64_t kMaxHeader = 1 + 2 + PATH_MAX + 4 * 10 + 1 + 10;
+  /// 1 byte for cmd, 2 bytes for file-name length, 2 bytes for front coded
+  /// prefix length, Max size of filename, 4 variants(seq-id, data-size,
+  /// offset, file-size), 1 byte for flag, 10 bytes prev seq-id
+  static const int64_t kMaxHeader = 1 + 2 + 2 + PATH_MAX + 4 * 10 + 1 + 10;
+  /// max size of a block header inside a batch, excluding the file name: 3
+  /// variants(seq-id, data-size, offset), 1 byte for flag, 2 variants for the
+  /// front coded name lengths, file-size and prev seq-id. The whole batch
+  /// cmd (1 byte for cmd, 1 for status, 2 for length) must fit in kMaxHeader
+  static const int64_t kMaxBatchEntryOverhead = 3 * 10 + 1 + 2 * 10 + 10 + 10;
   /// min number of bytes that must be send to unblock receiver
   static const int64_t kMinBufLength = 256;
   /// max size of done command encoding(1 byte for cmd, 1 for status, 10 for
@@ -292,6 +359,8 @@ class Protocol {
   static const int64_t kMaxChunkEncodeLen = 20;
   /// abort cmd length
   static const int64_t kAbortLength = sizeof(int32_t) + 1 + sizeof(int64_t);
+  /// connection cmd length (1 byte for cmd, rest for the connection key)
+  static const int64_t kConnectionCmdLen = 1 + sizeof(int32_t);
   /// max size of version encoding
   static const int64_t kMaxVersion = 10;
   /// max size of encryption cmd(1 byte for cmd, 1 byte for
@@ -326,15 +395,21 @@ class Protocol {
 
   /// encodes blockDetails into dest+off
   /// moves the off into dest pointer, not going past max
+  /// dictionary is the connection's name dictionary, required from
+  /// FILE_NAME_DICTIONARY_VERSION onwards
   /// @return false if there isn't enough room to encode
   static void encodeHeader(int senderProtocolVersion, char *dest, int64_t &off,
-                           int64_t max, const BlockDetails &blockDetails);
+                           int64_t max, const BlockDetails &blockDetails,
+                           FileNameDictionary *dictionary = nullptr);
 
   /// decodes from src+off and consumes/moves off but not past max
-  /// sets BlockDetails
+  /// sets BlockDetails, reusing the capacity of blockDetails.fileName
+  /// dictionary is the connection's name dictionary, required from
+  /// FILE_NAME_DICTIONARY_VERSION onwards
   /// @return false if there isn't enough data in src+off to src+max
   static bool decodeHeader(int receiverProtocolVersion, char *src, int64_t &off,
-                           int64_t max, BlockDetails &blockDetails);
+                           int64_t max, BlockDetails &blockDetails,
+                           FileNameDictionary *dictionary = nullptr);
 
   /// encodes checkpoints into dest+off
   /// moves the off into dest pointer, not going past max
@@ -439,6 +514,14 @@ class Protocol {
   static void decodeChunksCmd(char *src, int64_t &off, int64_t &bufSize,
                               int64_t &numFiles);
 
+  /// encodes the connection cmd and key into dest+off
+  /// moves the off into dest pointer
+  static void encodeConnectionCmd(char *dest, int64_t &off, int32_t key);
+
+  /// decodes from src+off and consumes/moves off
+  /// @return false if src+off does not start with a connection cmd
+  static bool decodeConnectionCmd(char *src, int64_t &off, int32_t &key);
+
   /// encodes chunk into dest+off
   /// moves the off into dest pointer
   static void encodeChunkInfo(char *dest, int64_t &off, int64_t max,
@@ -483,6 +566,21 @@ class Protocol {
   static bool decodeFileChunksInfoList(
       char *src, int64_t &off, int64_t dataSize,
       std::vector<FileChunksInfo> &fileChunksInfoList);
+
+ private:
+  /// bit of the header flags set when the file name and size follow
+  static const uint8_t kHeaderFileNameFlag = 1 << 3;
+
+  /// encodeHeader for FILE_NAME_DICTIONARY_VERSION and above
+  static void encodeHeaderWithDictionary(char *dest, int64_t &off,
+                                         int64_t max,
+                                         const BlockDetails &blockDetails,
+                                         FileNameDictionary &dictionary);
+
+  /// decodeHeader for FILE_NAME_DICTIONARY_VERSION and above
+  static bool decodeHeaderWithDictionary(char *src, int64_t &off, int64_t max,
+                                         BlockDetails &blockDetails,
+                                         FileNameDictionary &dictionary);
 };
 }
 }  // namespace facebook::wdt
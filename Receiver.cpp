@@ -82,7 +82,10 @@ void Receiver::startNewGlobalSession(const std::string &peerIp) {
     // when the current session ends
     throttler_->registerTransfer();
   }
-  startTime_ = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    startTime_ = Clock::now();
+  }
   if (options_.enable_download_resumption) {
     transferLogManager_.startThread();
     bool verifySuccessful = transferLogManager_.verifySenderIp(peerIp);
@@ -90,6 +93,12 @@ void Receiver::startNewGlobalSession(const std::string &peerIp) {
       fileChunksInfo_.clear();
     }
   }
+  if (fileCompletionTracker_) {
+    fileCompletionTracker_->reset(fileChunksInfo_);
+  }
+  // threads accepting later connections do not go through this function,
+  // forwarding has to be ready before they see the new transfer
+  startDownstream();
   hasNewTransferStarted_.store(true);
   LOG(INFO) << "Starting new transfer,  peerIp " << peerIp << " , transfer id "
             << getTransferId();
@@ -109,12 +118,14 @@ void Receiver::endCurGlobalSession() {
   if (throttler_) {
     throttler_->deRegisterTransfer();
   }
+  endDownstream();
   checkpoints_.clear();
   if (fileCreator_) {
     fileCreator_->clearAllocationMap();
   }
   // TODO might consider moving closing the transfer log here
   hasNewTransferStarted_.store(false);
+  dynamicParallelism_.store(false);
 }
 
 const WdtTransferRequest &Receiver::init() {
@@ -186,13 +197,24 @@ const WdtTransferRequest &Receiver::init() {
     }
     transferRequest_.encryptionData.erase();
   }
+  if (options_.single_port) {
+    ErrorCode code = initConnectionDispatcher();
+    if (code != OK) {
+      transferRequest_.errorCode = code;
+      return transferRequest_;
+    }
+  }
   threadsController_ = new ThreadsController(numThreads);
   threadsController_->setNumFunnels(ReceiverThread::NUM_FUNNELS);
   threadsController_->setNumBarriers(ReceiverThread::NUM_BARRIERS);
   threadsController_->setNumConditions(ReceiverThread::NUM_CONDITIONS);
   // TODO: take transferRequest directly !
-  receiverThreads_ = threadsController_->makeThreads<Receiver, ReceiverThread>(
-      this, transferRequest_.ports.size(), transferRequest_.ports);
+  {
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    receiverThreads_ =
+        threadsController_->makeThreads<Receiver, ReceiverThread>(
+            this, transferRequest_.ports.size(), transferRequest_.ports);
+  }
   size_t numSuccessfulInitThreads = 0;
   for (auto &receiverThread : receiverThreads_) {
     ErrorCode code = receiverThread->init();
@@ -233,6 +255,36 @@ const WdtTransferRequest &Receiver::init() {
   return transferRequest_;
 }
 
+ErrorCode Receiver::initConnectionDispatcher() {
+  if (protocolVersion_ < Protocol::SINGLE_PORT_VERSION) {
+    LOG(WARNING) << "Single port mode needs protocol version "
+                 << Protocol::SINGLE_PORT_VERSION << ", protocol version is "
+                 << protocolVersion_ << ", using one port per connection";
+    return OK;
+  }
+  const int numPorts = transferRequest_.ports.size();
+  const int port = transferRequest_.ports[0];
+  connectionDispatcher_ = folly::make_unique<ConnectionDispatcher>(
+      options_, port, backlog_, &abortCheckerCallback_);
+  ErrorCode code = ERROR;
+  for (int retries = 0; retries < options_.max_retries && code != OK;
+       retries++) {
+    code = connectionDispatcher_->listen();
+  }
+  if (code != OK) {
+    LOG(ERROR) << "Couldn't listen on single port " << port;
+    connectionDispatcher_.reset();
+    return CONN_ERROR;
+  }
+  // receiver threads keep distinct (logical) ports, used as connection keys
+  transferRequest_.ports = WdtTransferRequest::genPortsVector(
+      connectionDispatcher_->getPort(), numPorts);
+  transferRequest_.singlePort = true;
+  LOG(INFO) << "Accepting " << numPorts << " connections on single port "
+            << connectionDispatcher_->getPort();
+  return OK;
+}
+
 void Receiver::setDir(const std::string &destDir) {
   destDir_ = destDir;
   transferLogManager_.setRootDir(destDir_);
@@ -255,6 +307,174 @@ void Receiver::setRecoveryId(const std::string &recoveryId) {
   LOG(INFO) << "recovery id " << recoveryId_;
 }
 
+void Receiver::setDownstreamRequest(
+    const WdtTransferRequest &downstreamRequest) {
+  WDT_CHECK(!hasNewTransferStarted_.load());
+  downstreamRequest_ =
+      folly::make_unique<WdtTransferRequest>(downstreamRequest);
+  LOG(INFO) << "Forwarding to " << downstreamRequest.getLogSafeString();
+  if (options_.enable_download_resumption) {
+    LOG(WARNING) << "A resumed session forwards the chunks received by the "
+                 << "previous ones again, from the files";
+  }
+}
+
+void Receiver::setWriterFactory(std::shared_ptr<WriterFactory> writerFactory) {
+  WDT_CHECK(!hasNewTransferStarted_.load());
+  if (options_.enable_download_resumption) {
+    LOG(WARNING) << "Download resumption needs files, it will not find the "
+                 << "blocks written with the writer factory";
+  }
+  writerFactory_ = std::move(writerFactory);
+}
+
+WriterFactory *Receiver::getWriterFactory() const {
+  return writerFactory_.get();
+}
+
+void Receiver::setFileCompletionListener(
+    std::shared_ptr<FileCompletionListener> listener) {
+  WDT_CHECK(!hasNewTransferStarted_.load());
+  fileCompletionTracker_ =
+      folly::make_unique<FileCompletionTracker>(std::move(listener));
+}
+
+FileCompletionTracker *Receiver::getFileCompletionTracker() const {
+  return fileCompletionTracker_.get();
+}
+
+void Receiver::startDownstream() {
+  if (!downstreamRequest_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(forwardingMutex_);
+  forwardingFinished_ = false;
+  downstreamDone_ = false;
+  downstreamStatus_ = OK;
+  if (writerFactory_) {
+    LOG(ERROR) << "Blocks written with a writer factory can not be forwarded";
+    forwardingFinished_ = true;
+    downstreamDone_ = true;
+    downstreamStatus_ = ERROR;
+    return;
+  }
+  WdtTransferRequest request(*downstreamRequest_);
+  request.directory = destDir_;
+  downstreamSender_ = folly::make_unique<Sender>(request);
+  downstreamSender_->enableBlockForwarding();
+  ErrorCode code = downstreamSender_->transferAsync();
+  if (code != OK) {
+    LOG(ERROR) << "Unable to start the downstream transfer "
+               << errorCodeToStr(code);
+    downstreamSender_->finishForwarding();
+    forwardingFinished_ = true;
+    downstreamDone_ = true;
+    downstreamStatus_ = code;
+    return;
+  }
+  forwardPreviousChunksLocked();
+  forwardingThread_ = std::thread(&Receiver::waitForDownstream, this);
+}
+
+void Receiver::forwardPreviousChunksLocked() {
+  // the upstream sender does not send these again, the downstream receiver
+  // would miss them
+  const int64_t blockSize = options_.block_size_mbytes * 1024 * 1024;
+  int64_t numBlocks = 0;
+  for (const FileChunksInfo &chunksInfo : fileChunksInfo_) {
+    for (const Interval &chunk : chunksInfo.getChunks()) {
+      int64_t offset = chunk.start_;
+      do {
+        const int64_t size = blockSize > 0
+                                 ? std::min(blockSize, chunk.end_ - offset)
+                                 : chunk.end_ - offset;
+        downstreamSender_->forwardBlock(chunksInfo.getFileName(),
+                                        chunksInfo.getFileSize(), offset,
+                                        size);
+        offset += size;
+        numBlocks++;
+      } while (offset < chunk.end_);
+    }
+  }
+  if (numBlocks > 0) {
+    LOG(INFO) << "Forwarded " << numBlocks << " blocks received by previous "
+              << "sessions";
+  }
+}
+
+void Receiver::forwardBlock(const BlockDetails &blockDetails) {
+  if (!downstreamSender_ || blockDetails.allocationStatus == TO_BE_DELETED) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(forwardingMutex_);
+  if (forwardingFinished_) {
+    LOG(ERROR) << "Block of " << blockDetails.fileName << " at offset "
+               << blockDetails.offset << " received after the end of the "
+               << "transfer, not forwarded";
+    return;
+  }
+  downstreamSender_->forwardBlock(blockDetails.fileName,
+                                  blockDetails.fileSize, blockDetails.offset,
+                                  blockDetails.dataSize);
+}
+
+bool Receiver::finishForwarding(ErrorCode &status) {
+  status = OK;
+  if (!downstreamRequest_) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(forwardingMutex_);
+  if (!forwardingFinished_) {
+    LOG(INFO) << "All blocks forwarded, waiting for the downstream transfer";
+    downstreamSender_->finishForwarding();
+    forwardingFinished_ = true;
+  }
+  status = downstreamStatus_;
+  return downstreamDone_;
+}
+
+void Receiver::waitForDownstream() {
+  std::unique_ptr<TransferReport> report = downstreamSender_->finish();
+  const ErrorCode status = report->getSummary().getErrorCode();
+  {
+    std::lock_guard<std::mutex> lock(forwardingMutex_);
+    downstreamDone_ = true;
+    downstreamStatus_ = status;
+  }
+  // threads waiting for the end of the session check the downstream status
+  threadsController_->getCondition(
+                         ReceiverThread::WAIT_FOR_FINISH_OR_CHECKPOINT_CV)
+      ->acquire()
+      .notifyAll();
+}
+
+void Receiver::endDownstream() {
+  if (!downstreamSender_) {
+    return;
+  }
+  bool upstreamFinished;
+  {
+    std::lock_guard<std::mutex> lock(forwardingMutex_);
+    upstreamFinished = forwardingFinished_;
+  }
+  const ErrorCode abortCode = getCurAbortCode();
+  if (!upstreamFinished || abortCode != OK) {
+    // blocks are missing, the downstream must not complete with them. Aborted
+    // before its discovery ends, so it can not send its done command first
+    LOG(ERROR) << "Upstream session did not complete, aborting the "
+               << "downstream transfer";
+    downstreamSender_->abort(abortCode != OK ? abortCode : ABORT);
+  }
+  ErrorCode status;
+  finishForwarding(status);
+  if (forwardingThread_.joinable()) {
+    forwardingThread_.join();
+  }
+  LOG(INFO) << "Downstream transfer ended with "
+            << errorCodeToStr(downstreamStatus_);
+  downstreamSender_.reset();
+}
+
 Receiver::~Receiver() {
   TransferStatus status = getTransferStatus();
   if (status == ONGOING) {
@@ -308,7 +528,9 @@ std::unique_ptr<TransferReport> Receiver::finish() {
     // Make sure to join the progress thread.
     progressTrackerThread_.join();
   }
+  writeTrace(receiverThreads_, "receiver");
   std::unique_ptr<TransferReport> report = getTransferReport();
+  report->setThroughputSamples(throughputSeries_.getSamples());
   auto &summary = report->getSummary();
   bool transferSuccess = (report->getSummary().getErrorCode() == OK);
   fixAndCloseTransferLog(transferSuccess);
@@ -319,12 +541,15 @@ std::unique_ptr<TransferReport> Receiver::finish() {
     progressReporter_->end(report);
   }
   if (options_.enable_perf_stat_collection) {
-    PerfStatReport globalPerfReport(options_);
+    std::unique_ptr<PerfStatReport> globalPerfReport =
+        folly::make_unique<PerfStatReport>(options_);
     for (auto &receiverThread : receiverThreads_) {
-      globalPerfReport += receiverThread->getPerfReport();
+      *globalPerfReport += receiverThread->getPerfReport();
     }
-    LOG(INFO) << globalPerfReport;
+    LOG(INFO) << *globalPerfReport;
+    report->setPerfReport(std::move(globalPerfReport));
   }
+  writeReportJson(*report, "receiver");
 
   LOG(WARNING) << "WDT receiver's transfer has been finished";
   LOG(INFO) << *report;
@@ -348,6 +573,23 @@ std::unique_ptr<TransferReport> Receiver::getTransferReport() {
   return transferReport;
 }
 
+void Receiver::exportMetrics(OpenMetricsSerializer &serializer,
+                             const MetricLabels &labels) {
+  WdtBase::exportMetrics(serializer, labels);
+  if (getTransferStatus() == NOT_STARTED) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(metricsMutex_);
+  std::unique_ptr<TransferReport> report = getTransferReport();
+  report->setTotalTime(durationSeconds(Clock::now() - startTime_));
+  serializer.addTransferReport(*report, labels);
+  PerfStatReport perfReport(options_);
+  for (auto &receiverThread : receiverThreads_) {
+    perfReport += receiverThread->getPerfReport();
+  }
+  serializer.addPerfStatReport(perfReport, labels);
+}
+
 ErrorCode Receiver::transferAsync() {
   isJoinable_ = true;
   int progressReportIntervalMillis = options_.progress_report_interval_millis;
@@ -409,11 +651,12 @@ void Receiver::progressTracker() {
       globalStats += receiverThread->getTransferStats();
     }
     totalSenderBytes = globalStats.getTotalSenderBytes();
+    auto transferReport = folly::make_unique<TransferReport>(
+        std::move(globalStats), totalTime, totalSenderBytes);
+    recordThroughputSample(*transferReport);
     if (totalSenderBytes == -1) {
       continue;
     }
-    auto transferReport = folly::make_unique<TransferReport>(
-        std::move(globalStats), totalTime, totalSenderBytes);
     intervalsSinceLastUpdate++;
     if (intervalsSinceLastUpdate >= throughputUpdateInterval) {
       auto curTime = Clock::now();
@@ -433,7 +676,11 @@ void Receiver::progressTracker() {
 ErrorCode Receiver::start() {
   WDT_CHECK_EQ(getTransferStatus(), NOT_STARTED)
       << "There is already a transfer running on this instance of receiver";
-  startTime_ = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(metricsMutex_);
+    startTime_ = Clock::now();
+  }
+  throughputSeries_.reset(options_.throughput_series_size);
   LOG(INFO) << "Starting (receiving) server on ports [ "
             << transferRequest_.ports << "] Target dir : " << destDir_;
   // TODO do the init stuff here
@@ -455,6 +702,7 @@ ErrorCode Receiver::start() {
     // with the same sockets
     for (auto &receiverThread : receiverThreads_) {
       receiverThread->finish();
+      std::lock_guard<std::mutex> lock(metricsMutex_);
       receiverThread->reset();
     }
     threadsController_->reset();
@@ -10,10 +10,15 @@
 
 #include <wdt/WdtBase.h>
 #include <wdt/ReceiverThread.h>
+#include <wdt/Sender.h>
+#include <wdt/Writer.h>
+#include <wdt/util/ConnectionDispatcher.h>
+#include <wdt/util/FileCompletionTracker.h>
 #include <wdt/util/FileCreator.h>
 #include <wdt/util/ServerSocket.h>
 #include <wdt/util/TransferLogManager.h>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <chrono>
@@ -71,6 +76,43 @@ class Receiver : public WdtBase {
   /// @param recoveryId   unique-id used to verify transfer log
   void setRecoveryId(const std::string &recoveryId);
 
+  /**
+   * Makes this receiver a link of a replication chain: every block received
+   * is forwarded to the next receiver as soon as it is written, and a
+   * transfer only completes once the next receiver got all of it. With
+   * download resumption, the chunks received by earlier sessions are
+   * forwarded again when a session starts. Must be called before starting
+   *
+   * @param downstreamRequest   transfer request of the next receiver, the
+   *                            directory of this receiver is sent
+   */
+  void setDownstreamRequest(const WdtTransferRequest &downstreamRequest);
+
+  /**
+   * Received blocks are written with the writers of the factory instead of
+   * into files under the destination directory. Download resumption and
+   * forwarding to a downstream receiver read the files back, so they can
+   * not be used with a factory. Must be called before starting
+   *
+   * @param writerFactory   factory of the writers of the blocks
+   */
+  void setWriterFactory(std::shared_ptr<WriterFactory> writerFactory);
+
+  /**
+   * Files are reported to the listener as soon as they are received, so
+   * that they can be processed before the end of the transfer. Must be
+   * called before starting
+   *
+   * @param listener        listener of the completed files
+   */
+  void setFileCompletionListener(
+      std::shared_ptr<FileCompletionListener> listener);
+
+  /// Exports the transfer counters and perf stats of the ongoing transfer
+  /// (@see WdtBase.h)
+  void exportMetrics(OpenMetricsSerializer &serializer,
+                     const MetricLabels &labels) override;
+
   /**
    * Destructor for the receiver. The destructor automatically cancels
    * any incomplete transfers that are going on. 'Incomplete transfer' is a
@@ -102,6 +144,12 @@ class Receiver : public WdtBase {
   /// Responsible for basic setup and starting threads
   ErrorCode start();
 
+  /**
+   * Sets up the dispatcher listening on the first port for the single port
+   * mode and changes the other ports to connection keys following it
+   */
+  ErrorCode initConnectionDispatcher();
+
   /**
    * Periodically calculates current transfer report and send it to progress
    * reporter. This only works in the single transfer mode.
@@ -130,6 +178,39 @@ class Receiver : public WdtBase {
   /// Has steps to do when the current transfer is ended
   void endCurGlobalSession();
 
+  /// @return   factory of the writers set by the application, null if none
+  WriterFactory *getWriterFactory() const;
+
+  /// @return   tracker of the completed files, null if there is no listener
+  FileCompletionTracker *getFileCompletionTracker() const;
+
+  /// starts the transfer to the next receiver of the chain
+  void startDownstream();
+
+  /// forwards a block written by a thread to the next receiver of the chain
+  void forwardBlock(const BlockDetails &blockDetails);
+
+  /// forwards the chunks received by previous sessions, with download
+  /// resumption. forwardingMutex_ must be held
+  void forwardPreviousChunksLocked();
+
+  /**
+   * Called once the sender is done on all the connections, no more blocks
+   * are forwarded after that
+   *
+   * @param status    set to the status of the downstream transfer
+   *
+   * @return          whether the downstream transfer is over, always true
+   *                  without a downstream receiver
+   */
+  bool finishForwarding(ErrorCode &status);
+
+  /// waits for the end of the downstream transfer, runs in forwardingThread_
+  void waitForDownstream();
+
+  /// ends the downstream transfer with the session
+  void endDownstream();
+
   /// adds log header and also a directory invalidation entry if needed
   void addTransferLogHeader(bool isBlockMode, bool isSenderResuming);
 
@@ -170,6 +251,9 @@ class Receiver : public WdtBase {
    */
   std::vector<std::unique_ptr<WdtThread>> receiverThreads_;
 
+  /// Accepts the connections in single port mode, null otherwise
+  std::unique_ptr<ConnectionDispatcher> connectionDispatcher_;
+
   /// Transfer log manager
   TransferLogManager transferLogManager_;
 
@@ -179,14 +263,48 @@ class Receiver : public WdtBase {
   /// Start time of the session
   std::chrono::time_point<Clock> startTime_;
 
+  /// Protects the creation of receiverThreads_, the reset of their stats and
+  /// startTime_ against concurrent exportMetrics() calls
+  std::mutex metricsMutex_;
+
   /// already transferred file chunks
   std::vector<FileChunksInfo> fileChunksInfo_;
 
   /// Marks when a new transfer has started
   std::atomic<bool> hasNewTransferStarted_{false};
 
+  /// Whether the sender of the current session may open connections late
+  std::atomic<bool> dynamicParallelism_{false};
+
   /// Backlog used by the sockets
   int backlog_;
+
+  /// Factory of the writers of the blocks, null to write files
+  std::shared_ptr<WriterFactory> writerFactory_;
+
+  /// Reports the completed files, null if there is no listener
+  std::unique_ptr<FileCompletionTracker> fileCompletionTracker_;
+
+  /// Request of the next receiver of the chain, null if there is none
+  std::unique_ptr<WdtTransferRequest> downstreamRequest_;
+
+  /// Sends the received blocks to the next receiver during a session
+  std::unique_ptr<Sender> downstreamSender_;
+
+  /// Thread running waitForDownstream()
+  std::thread forwardingThread_;
+
+  /// protects the forwarding state below
+  std::mutex forwardingMutex_;
+
+  /// whether all the blocks of the session have been forwarded
+  bool forwardingFinished_{false};
+
+  /// whether the downstream transfer is over
+  bool downstreamDone_{false};
+
+  /// status of the downstream transfer once it is over
+  ErrorCode downstreamStatus_{OK};
 };
 }
 }  // namespace facebook::wdt
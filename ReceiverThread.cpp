@@ -8,6 +8,7 @@
  */
 #include <wdt/ReceiverThread.h>
 #include <wdt/util/FileWriter.h>
+#include <wdt/util/Tracepoints.h>
 #include <folly/Conv.h>
 #include <folly/Memory.h>
 #include <folly/String.h>
@@ -20,6 +21,7 @@ namespace wdt {
 
 const static int kTimeoutBufferMillis = 1000;
 const static int kWaitTimeoutFactor = 5;
+const static int kStandbyAcceptMillis = 200;
 std::ostream &operator<<(std::ostream &os,
                          const ReceiverThread &receiverThread) {
   os << "Thread[" << receiverThread.threadIndex_
@@ -85,7 +87,8 @@ const ReceiverThread::StateFunction ReceiverThread::stateMap_[] = {
     &ReceiverThread::acceptWithTimeout, &ReceiverThread::sendLocalCheckpoint,
     &ReceiverThread::readNextCmd, &ReceiverThread::processFileCmd,
     &ReceiverThread::processSettingsCmd, &ReceiverThread::processDoneCmd,
-    &ReceiverThread::processSizeCmd, &ReceiverThread::sendFileChunks,
+    &ReceiverThread::processSizeCmd, &ReceiverThread::processBatchCmd,
+    &ReceiverThread::sendFileChunks,
     &ReceiverThread::sendGlobalCheckpoint, &ReceiverThread::sendDoneCmd,
     &ReceiverThread::sendAbortCmd,
     &ReceiverThread::waitForFinishOrNewCheckpoint,
@@ -95,7 +98,8 @@ ReceiverThread::ReceiverThread(Receiver *wdtParent, int threadIndex,
                                int32_t port, ThreadsController *controller)
     : WdtThread(wdtParent->options_, threadIndex, port,
                 wdtParent->getProtocolVersion(), controller),
-      wdtParent_(wdtParent) {
+      wdtParent_(wdtParent),
+      socketTuner_(wdtParent->options_, /* receiver */ false) {
   controller_->registerThread(threadIndex_);
   threadCtx_->setAbortChecker(&wdtParent_->abortCheckerCallback_);
 }
@@ -135,7 +139,10 @@ ReceiverState ReceiverThread::acceptFirstConnection() {
   VLOG(1) << *this << " entered ACCEPT_FIRST_CONNECTION state";
 
   reset();
-  socket_->closeNoCheck();
+  if (!connectionKept_) {
+    socket_->closeNoCheck();
+  }
+  markConnected(false);
   auto timeout = options_.accept_timeout_millis;
   int acceptAttempts = 0;
   while (true) {
@@ -165,6 +172,9 @@ ReceiverState ReceiverThread::acceptFirstConnection() {
     }
     ++acceptAttempts;
   }
+  markConnected(true);
+  socketTuner_.start(*socket_, threadStats_.getTotalBytes(), 0);
+  connectionKept_ = false;
   // Make the parent start new global session. This is executed
   // only by the first thread that calls this function
   controller_->executeAtStart(
@@ -184,7 +194,11 @@ ReceiverState ReceiverThread::acceptWithTimeout() {
     threadStats_.setLocalErrorCode(socketErrCode);
     return END;
   }
-  socket_->closeNoCheck();
+  if (!connectionKept_) {
+    socket_->closeNoCheck();
+  }
+  // the kept connection is either reused or closed by the accept below
+  connectionKept_ = false;
   blocksWaitingVerification_.clear();
 
   auto timeout = options_.accept_window_millis;
@@ -196,13 +210,26 @@ ReceiverState ReceiverThread::acceptWithTimeout() {
   ErrorCode code =
       socket_->acceptNextConnection(timeout, curConnectionVerified_);
   curConnectionVerified_ = false;
+  // without settings on this connection yet, the sender may open it later
+  // in the transfer or not at all. Checked after the accept, the settings of
+  // the first connection may have arrived meanwhile
+  if (code != OK && senderReadTimeout_ < 0 &&
+      wdtParent_->dynamicParallelism_.load()) {
+    if (!waitForStandbyConnection()) {
+      return END;
+    }
+    code = OK;
+  }
   if (code != OK) {
     LOG(ERROR) << *this << " accept() failed with timeout " << timeout;
     threadStats_.setLocalErrorCode(code);
     return FINISH_WITH_ERROR;
   }
+  markConnected(true);
+  socketTuner_.start(*socket_, threadStats_.getTotalBytes(), 0);
 
   numRead_ = off_ = 0;
+  fileNameDictionary_.reset();
   pendingCheckpointIndex_ = checkpointIndex_;
   ReceiverState nextState = READ_NEXT_CMD;
   if (threadStats_.getLocalErrorCode() != OK) {
@@ -233,12 +260,16 @@ ReceiverState ReceiverThread::sendLocalCheckpoint() {
     return ACCEPT_WITH_TIMEOUT;
   }
   threadStats_.addHeaderBytes(checkpointLen);
+  threadCtx_->traceInstant("Local checkpoint", checkpoint_.numBlocks);
+  WDT_TRACEPOINT3(checkpoint__send, checkpoint_.port, checkpoint_.numBlocks,
+                  checkpoint_.lastBlockReceivedBytes);
   return READ_NEXT_CMD;
 }
 
 /***READ_NEXT_CMD***/
 ReceiverState ReceiverThread::readNextCmd() {
   VLOG(1) << *this << " entered READ_NEXT_CMD state";
+  socketTuner_.onProgress(*socket_, threadStats_.getTotalBytes());
   oldOffset_ = off_;
   // TODO: we shouldn't have off_ here and buffer/size inside buffer.
   numRead_ = readAtLeast(*socket_, buf_ + off_, bufSize_ - off_,
@@ -256,6 +287,9 @@ ReceiverState ReceiverThread::readNextCmd() {
   if (cmd == Protocol::FILE_CMD) {
     return PROCESS_FILE_CMD;
   }
+  if (cmd == Protocol::BATCH_CMD) {
+    return PROCESS_BATCH_CMD;
+  }
   if (cmd == Protocol::SETTINGS_CMD) {
     return PROCESS_SETTINGS_CMD;
   }
@@ -321,6 +355,10 @@ ReceiverState ReceiverThread::processSettingsCmd() {
   senderReadTimeout_ = settings.readTimeoutMillis;
   senderWriteTimeout_ = settings.writeTimeoutMillis;
   isBlockMode_ = !settings.blockModeDisabled;
+  keepConnectionRequested_ = settings.keepConnection;
+  if (settings.dynamicParallelism) {
+    wdtParent_->dynamicParallelism_.store(true);
+  }
   curConnectionVerified_ = true;
 
   // determine footer type
@@ -354,36 +392,109 @@ ReceiverState ReceiverThread::processSettingsCmd() {
 /***PROCESS_FILE_CMD***/
 ReceiverState ReceiverThread::processFileCmd() {
   VLOG(1) << *this << " entered PROCESS_FILE_CMD state";
-  // following block needs to be executed for the first file cmd. There is no
-  // harm in executing it more than once. number of blocks equal to 0 is a good
-  // approximation for first file cmd. Did not want to introduce another boolean
-  if (options_.enable_download_resumption && threadStats_.getNumBlocks() == 0) {
-    auto sendChunksFunnel = controller_->getFunnel(SEND_FILE_CHUNKS_FUNNEL);
-    auto state = sendChunksFunnel->getStatus();
-    if (state == FUNNEL_START) {
-      // sender is not in resumption mode
-      wdtParent_->addTransferLogHeader(isBlockMode_,
-                                       /* sender not resuming */ false);
-      sendChunksFunnel->notifySuccess();
+  auto guard = folly::makeGuard([&] {
+    if (threadStats_.getLocalErrorCode() != OK) {
+      threadStats_.incrFailedAttempts();
     }
+  });
+  int16_t headerLen;
+  if (!readFullHeader(headerLen)) {
+    return ACCEPT_WITH_TIMEOUT;
   }
-  checkpoint_.resetLastBlockDetails();
-  BlockDetails blockDetails;
+  BlockDetails &blockDetails = blockDetails_;
+  blockDetails.allocationStatus = NOT_EXISTS;
+  blockDetails.prevSeqId = 0;
+  bool success =
+      Protocol::decodeHeader(threadProtocolVersion_, buf_, off_,
+                             numRead_ + oldOffset_, blockDetails,
+                             &fileNameDictionary_);
+  int64_t headerBytes = off_ - oldOffset_;
+  // transferred header length must match decoded header length
+  WDT_CHECK_EQ(headerLen, headerBytes) << " " << blockDetails.fileName << " "
+                                       << blockDetails.seqId << " "
+                                       << threadProtocolVersion_;
+  threadStats_.addHeaderBytes(headerBytes);
+  threadStats_.addEffectiveBytes(headerBytes, 0);
+  if (!success) {
+    LOG(ERROR) << *this << " Error decoding at"
+               << " ooff:" << oldOffset_ << " off_: " << off_
+               << " numRead_: " << numRead_;
+    threadStats_.setLocalErrorCode(PROTOCOL_ERROR);
+    return FINISH_WITH_ERROR;
+  }
+  return receiveBlock(blockDetails, headerBytes);
+}
+
+/***PROCESS_BATCH_CMD***/
+ReceiverState ReceiverThread::processBatchCmd() {
+  VLOG(1) << *this << " entered PROCESS_BATCH_CMD state";
   auto guard = folly::makeGuard([&] {
     if (threadStats_.getLocalErrorCode() != OK) {
       threadStats_.incrFailedAttempts();
     }
   });
+  if (threadProtocolVersion_ < Protocol::BATCH_CMD_VERSION) {
+    LOG(ERROR) << *this << " Batch cmd not supported in protocol "
+               << threadProtocolVersion_;
+    threadStats_.setLocalErrorCode(PROTOCOL_ERROR);
+    return FINISH_WITH_ERROR;
+  }
+  int16_t headerLen;
+  if (!readFullHeader(headerLen)) {
+    return ACCEPT_WITH_TIMEOUT;
+  }
+  // all the headers are decoded upfront, the payloads follow back to back
+  const int64_t headerEnd = oldOffset_ + headerLen;
+  int64_t numBlocks = 0;
+  bool success = true;
+  while (off_ < headerEnd) {
+    if (numBlocks == (int64_t)batchBlocks_.size()) {
+      batchBlocks_.emplace_back();
+    }
+    if (!Protocol::decodeHeader(threadProtocolVersion_, buf_, off_, headerEnd,
+                                batchBlocks_[numBlocks],
+                                &fileNameDictionary_)) {
+      success = false;
+      break;
+    }
+    numBlocks++;
+  }
+  int64_t headerBytes = off_ - oldOffset_;
+  threadStats_.addHeaderBytes(headerBytes);
+  threadStats_.addEffectiveBytes(headerBytes, 0);
+  if (!success || numBlocks == 0 || headerBytes != headerLen) {
+    LOG(ERROR) << *this << " Error decoding batch of " << headerLen
+               << " bytes at ooff:" << oldOffset_ << " off_: " << off_
+               << " numRead_: " << numRead_ << " decoded " << numBlocks;
+    threadStats_.setLocalErrorCode(PROTOCOL_ERROR);
+    return FINISH_WITH_ERROR;
+  }
+  VLOG(2) << *this << " Received batch of " << numBlocks << " blocks";
+  for (int64_t i = 0; i < numBlocks; i++) {
+    if (i > 0) {
+      // next payload directly follows the previous block
+      oldOffset_ = off_;
+    }
+    // the batch header is accounted with the first block
+    ReceiverState state =
+        receiveBlock(batchBlocks_[i], (i == 0) ? headerBytes : 0);
+    if (state != READ_NEXT_CMD) {
+      return state;
+    }
+  }
+  return READ_NEXT_CMD;
+}
 
+bool ReceiverThread::readFullHeader(int16_t &headerLen) {
   ErrorCode transferStatus = (ErrorCode)buf_[off_++];
   if (transferStatus != OK) {
     // TODO: use this status information to implement fail fast mode
     VLOG(1) << *this << " sender entered into error state "
             << errorCodeToStr(transferStatus);
   }
-  int16_t headerLen = folly::loadUnaligned<int16_t>(buf_ + off_);
+  headerLen = folly::loadUnaligned<int16_t>(buf_ + off_);
   headerLen = folly::Endian::little(headerLen);
-  VLOG(2) << "Processing FILE_CMD, header len " << headerLen;
+  VLOG(2) << "Processing header of len " << headerLen;
 
   if (headerLen > numRead_) {
     int64_t end = oldOffset_ + numRead_;
@@ -394,25 +505,31 @@ ReceiverState ReceiverThread::processFileCmd() {
     LOG(ERROR) << *this << " Unable to read full header " << headerLen << " "
                << numRead_;
     threadStats_.setLocalErrorCode(SOCKET_READ_ERROR);
-    return ACCEPT_WITH_TIMEOUT;
+    return false;
   }
   off_ += sizeof(int16_t);
-  bool success = Protocol::decodeHeader(threadProtocolVersion_, buf_, off_,
-                                        numRead_ + oldOffset_, blockDetails);
-  int64_t headerBytes = off_ - oldOffset_;
-  // transferred header length must match decoded header length
-  WDT_CHECK_EQ(headerLen, headerBytes) << " " << blockDetails.fileName << " "
-                                       << blockDetails.seqId << " "
-                                       << threadProtocolVersion_;
-  threadStats_.addHeaderBytes(headerBytes);
-  threadStats_.addEffectiveBytes(headerBytes, 0);
-  if (!success) {
-    LOG(ERROR) << *this << " Error decoding at"
-               << " ooff:" << oldOffset_ << " off_: " << off_
-               << " numRead_: " << numRead_;
-    threadStats_.setLocalErrorCode(PROTOCOL_ERROR);
-    return FINISH_WITH_ERROR;
+  return true;
+}
+
+ReceiverState ReceiverThread::receiveBlock(BlockDetails &blockDetails,
+                                           int64_t headerBytes) {
+  // following block needs to be executed for the first file cmd. There is no
+  // harm in executing it more than once. number of blocks equal to 0 is a good
+  // approximation for first file cmd. Did not want to introduce another boolean
+  if (options_.enable_download_resumption && threadStats_.getNumBlocks() == 0) {
+    auto sendChunksFunnel = controller_->getFunnel(SEND_FILE_CHUNKS_FUNNEL);
+    auto state = sendChunksFunnel->getStatus();
+    if (state == FUNNEL_START) {
+      // sender is not in resumption mode
+      wdtParent_->addTransferLogHeader(isBlockMode_,
+                                       /* sender not resuming */ false);
+      sendChunksFunnel->notifySuccess();
+    }
   }
+  checkpoint_.resetLastBlockDetails();
+  TraceScope receiveScope(*threadCtx_, "Receive block", blockDetails.seqId);
+  WDT_TRACEPOINT3(block__receive__start, blockDetails.seqId,
+                  blockDetails.offset, blockDetails.dataSize);
   if (blockDetails.allocationStatus == TO_BE_DELETED &&
       (blockDetails.fileSize != 0 || blockDetails.dataSize != 0)) {
     LOG(ERROR) << *this << " Invalid file header, file to be deleted, but "
@@ -429,17 +546,47 @@ ReceiverState ReceiverThread::processFileCmd() {
   VLOG(1) << *this << " Read id:" << blockDetails.fileName
           << " size:" << blockDetails.dataSize << " ooff:" << oldOffset_
           << " off_: " << off_ << " numRead_: " << numRead_;
-  auto &fileCreator = wdtParent_->getFileCreator();
-  FileWriter writer(*threadCtx_, &blockDetails, fileCreator.get());
+  std::unique_ptr<Writer> writer;
+  WriterFactory *writerFactory = wdtParent_->getWriterFactory();
+  if (writerFactory) {
+    writer = writerFactory->makeWriter(*threadCtx_, blockDetails);
+    if (!writer) {
+      LOG(ERROR) << *this << " No writer for " << blockDetails.fileName;
+      threadStats_.setLocalErrorCode(FILE_WRITE_ERROR);
+      return SEND_ABORT_CMD;
+    }
+  } else {
+    auto &fileCreator = wdtParent_->getFileCreator();
+    writer = folly::make_unique<FileWriter>(*threadCtx_, &blockDetails,
+                                            fileCreator.get());
+  }
   auto writtenGuard = folly::makeGuard([&] {
     if (threadProtocolVersion_ >= Protocol::CHECKPOINT_OFFSET_VERSION &&
         footerType_ == NO_FOOTER) {
       checkpoint_.setLastBlockDetails(blockDetails.seqId, blockDetails.offset,
-                                      writer.getTotalWritten());
-      threadStats_.addEffectiveBytes(headerBytes, writer.getTotalWritten());
+                                      writer->getTotalWritten());
+      threadStats_.addEffectiveBytes(headerBytes, writer->getTotalWritten());
+      // the sender resumes after these bytes, they are not received again
+      if (writer->getTotalWritten() > 0) {
+        BlockDetails writtenPart(blockDetails);
+        writtenPart.dataSize = writer->getTotalWritten();
+        WriterFactory *writerFactory = wdtParent_->getWriterFactory();
+        if (writerFactory) {
+          writerFactory->onBlockVerified(writtenPart);
+        }
+        FileCompletionTracker *tracker =
+            wdtParent_->getFileCompletionTracker();
+        if (tracker) {
+          tracker->addVerifiedBytes(writtenPart, writtenPart.dataSize);
+        }
+        wdtParent_->forwardBlock(writtenPart);
+      }
     }
+    WDT_TRACEPOINT4(block__receive__done, blockDetails.seqId,
+                    blockDetails.offset, writer->getTotalWritten(),
+                    (int)threadStats_.getLocalErrorCode());
   });
-  if (writer.open() != OK) {
+  if (writer->open() != OK) {
     threadStats_.setLocalErrorCode(FILE_WRITE_ERROR);
     return SEND_ABORT_CMD;
   }
@@ -468,7 +615,7 @@ ReceiverState ReceiverThread::processFileCmd() {
   }
   ErrorCode code = ERROR;
   if (toWrite > 0) {
-    code = writer.write(buf_ + off_, toWrite);
+    code = writer->write(buf_ + off_, toWrite);
     if (code != OK) {
       threadStats_.setLocalErrorCode(code);
       return SEND_ABORT_CMD;
@@ -477,15 +624,16 @@ ReceiverState ReceiverThread::processFileCmd() {
   off_ += toWrite;
   remainingData -= toWrite;
   // also means no leftOver so it's ok we use buf_ from start
-  while (writer.getTotalWritten() < blockDetails.dataSize) {
+  while (writer->getTotalWritten() < blockDetails.dataSize) {
     if (wdtParent_->getCurAbortCode() != OK) {
       LOG(ERROR) << *this << "Thread marked for abort while processing "
                  << blockDetails.fileName << " " << blockDetails.seqId
                  << " port : " << socket_->getPort();
       return FAILED;
     }
-    int64_t nres = readAtMost(*socket_, buf_, bufSize_,
-                              blockDetails.dataSize - writer.getTotalWritten());
+    int64_t nres =
+        readAtMost(*socket_, buf_, bufSize_,
+                   blockDetails.dataSize - writer->getTotalWritten());
     if (nres <= 0) {
       break;
     }
@@ -498,13 +646,13 @@ ReceiverState ReceiverThread::processFileCmd() {
     if (footerType_ == CHECKSUM_FOOTER) {
       checksum = folly::crc32c((const uint8_t *)buf_, nres, checksum);
     }
-    code = writer.write(buf_, nres);
+    code = writer->write(buf_, nres);
     if (code != OK) {
       threadStats_.setLocalErrorCode(code);
       return SEND_ABORT_CMD;
     }
   }
-  if (writer.getTotalWritten() != blockDetails.dataSize) {
+  if (writer->getTotalWritten() != blockDetails.dataSize) {
     // This can only happen if there are transmission errors
     // Write errors to disk are already taken care of above
     LOG(ERROR) << *this << " could not read entire content for "
@@ -591,13 +739,23 @@ ReceiverState ReceiverThread::processFileCmd() {
   } else {
     markBlockVerified(blockDetails);
   }
+  wdtParent_->forwardBlock(blockDetails);
   return READ_NEXT_CMD;
 }
 
 void ReceiverThread::markBlockVerified(const BlockDetails &blockDetails) {
+  threadCtx_->traceInstant("Verified", blockDetails.seqId);
   threadStats_.addEffectiveBytes(0, blockDetails.dataSize);
   threadStats_.incrNumBlocks();
   checkpoint_.incrNumBlocks();
+  WriterFactory *writerFactory = wdtParent_->getWriterFactory();
+  if (writerFactory) {
+    writerFactory->onBlockVerified(blockDetails);
+  }
+  FileCompletionTracker *tracker = wdtParent_->getFileCompletionTracker();
+  if (tracker) {
+    tracker->addVerifiedBytes(blockDetails, blockDetails.dataSize);
+  }
   if (!options_.isLogBasedResumption()) {
     return;
   }
@@ -779,6 +937,8 @@ ReceiverState ReceiverThread::sendGlobalCheckpoint() {
     return ACCEPT_WITH_TIMEOUT;
   } else {
     threadStats_.addHeaderBytes(off_);
+    threadCtx_->traceInstant("Global checkpoint", newCheckpoints_.size());
+    WDT_TRACEPOINT1(global__checkpoint__send, newCheckpoints_.size());
     pendingCheckpointIndex_ = checkpointIndex_ + newCheckpoints_.size();
     numRead_ = off_ = 0;
     return READ_NEXT_CMD;
@@ -807,14 +967,23 @@ ReceiverState ReceiverThread::sendAbortCmd() {
 
 ReceiverState ReceiverThread::sendDoneCmd() {
   VLOG(1) << *this << " entered SEND_DONE_CMD state";
-  buf_[0] = Protocol::DONE_CMD;
-  if (socket_->write(buf_, 1) != 1) {
+  // only a long running receiver is still listening for the next transfer,
+  // connections from the dispatcher of the single port mode are not kept
+  const bool keepConnection = keepConnectionRequested_ &&
+                              !wdtParent_->isJoinable_ &&
+                              !wdtParent_->connectionDispatcher_;
+  int toWrite = 0;
+  buf_[toWrite++] = Protocol::DONE_CMD;
+  if (keepConnectionRequested_) {
+    buf_[toWrite++] = keepConnection;
+  }
+  if (socket_->write(buf_, toWrite) != toWrite) {
     PLOG(ERROR) << *this << " unable to send DONE " << threadIndex_;
     threadStats_.setLocalErrorCode(SOCKET_WRITE_ERROR);
     return ACCEPT_WITH_TIMEOUT;
   }
 
-  threadStats_.addHeaderBytes(1);
+  threadStats_.addHeaderBytes(toWrite);
 
   auto read = socket_->read(buf_, 1);
   if (read != 1 || buf_[0] != Protocol::DONE_CMD) {
@@ -822,7 +991,8 @@ ReceiverState ReceiverThread::sendDoneCmd() {
     threadStats_.setLocalErrorCode(SOCKET_READ_ERROR);
     return ACCEPT_WITH_TIMEOUT;
   }
-  ErrorCode code = socket_->expectEndOfStream();
+  ErrorCode code = keepConnection ? socket_->finishSession()
+                                  : socket_->expectEndOfStream();
   if (code != OK) {
     LOG(ERROR) << *this << " error while processing logical end of stream "
                << errorCodeToStr(code);
@@ -831,6 +1001,12 @@ ReceiverState ReceiverThread::sendDoneCmd() {
   } else if (footerType_ == ENC_TAG_FOOTER) {
     markReceivedBlocksVerified();
   }
+  if (keepConnection) {
+    connectionKept_ = true;
+    LOG(INFO) << *this << " got ack for DONE, keeping the connection open. "
+              << "Transfer finished";
+    return END;
+  }
   threadStats_.setLocalErrorCode(socket_->closeConnection());
   LOG(INFO) << *this << " got ack for DONE and logical eof. Transfer finished";
   return END;
@@ -847,10 +1023,37 @@ ReceiverState ReceiverThread::finishWithError() {
   auto guard = cv->acquire();
   wdtParent_->addCheckpoint(checkpoint_);
   controller_->markState(threadIndex_, FINISHED);
-  guard.notifyOne();
+  guard.notifyAll();
   return END;
 }
 
+void ReceiverThread::markConnected(bool connected) {
+  auto cv = controller_->getCondition(WAIT_FOR_FINISH_OR_CHECKPOINT_CV);
+  auto guard = cv->acquire();
+  controller_->markState(threadIndex_, connected ? RUNNING : INIT);
+  guard.notifyAll();
+}
+
+bool ReceiverThread::waitForStandbyConnection() {
+  LOG(INFO) << *this << " waiting for the sender to open the connection";
+  // other threads do not wait for this one to finish the session
+  markConnected(false);
+  while (wdtParent_->getCurAbortCode() == OK) {
+    // one last attempt after the other connections are done, the sender
+    // opens connections only while it has blocks to send
+    const bool lastAttempt = !controller_->hasThreads(threadIndex_, RUNNING) &&
+                             !controller_->hasThreads(threadIndex_, WAITING);
+    if (socket_->acceptNextConnection(kStandbyAcceptMillis, false) == OK) {
+      return true;
+    }
+    if (lastAttempt) {
+      break;
+    }
+  }
+  VLOG(1) << *this << " connection not opened by the sender";
+  return false;
+}
+
 ReceiverState ReceiverThread::checkForFinishOrNewCheckpoints() {
   auto checkpoints = wdtParent_->getNewCheckpoints(checkpointIndex_);
   if (!checkpoints.empty()) {
@@ -858,8 +1061,24 @@ ReceiverState ReceiverThread::checkForFinishOrNewCheckpoints() {
     controller_->markState(threadIndex_, RUNNING);
     return SEND_GLOBAL_CHECKPOINTS;
   }
-  bool existActiveThreads = controller_->hasThreads(threadIndex_, RUNNING);
+  // threads without a connection yet (INIT) are waited for, unless the
+  // sender opens connections only as needed
+  bool existActiveThreads =
+      controller_->hasThreads(threadIndex_, RUNNING) ||
+      (!wdtParent_->dynamicParallelism_.load() &&
+       controller_->hasThreads(threadIndex_, INIT));
   if (!existActiveThreads) {
+    // with a downstream receiver, done only once it got everything too
+    ErrorCode status;
+    if (!wdtParent_->finishForwarding(status)) {
+      return WAIT_FOR_FINISH_OR_NEW_CHECKPOINT;
+    }
+    if (status != OK) {
+      LOG(ERROR) << *this << " Downstream transfer failed "
+                 << errorCodeToStr(status);
+      threadStats_.setLocalErrorCode(status);
+      return FINISH_WITH_ERROR;
+    }
     controller_->markState(threadIndex_, FINISHED);
     return SEND_DONE_CMD;
   }
@@ -871,26 +1090,30 @@ ReceiverState ReceiverThread::waitForFinishOrNewCheckpoint() {
   // should only be called if the are no errors
   WDT_CHECK(threadStats_.getLocalErrorCode() == OK);
   auto cv = controller_->getCondition(WAIT_FOR_FINISH_OR_CHECKPOINT_CV);
-  int timeoutMillis = senderReadTimeout_ / kWaitTimeoutFactor;
+  const auto keepAliveInterval =
+      std::chrono::milliseconds(senderReadTimeout_ / kWaitTimeoutFactor);
   controller_->markState(threadIndex_, WAITING);
   while (true) {
     WDT_CHECK(senderReadTimeout_ > 0);  // must have received settings
     {
+      // every change which can end the wait (thread done, new checkpoint)
+      // notifies, the timeout is only for the keep alive below
+      const auto keepAliveTime = Clock::now() + keepAliveInterval;
       auto guard = cv->acquire();
-      auto state = checkForFinishOrNewCheckpoints();
-      if (state != WAIT_FOR_FINISH_OR_NEW_CHECKPOINT) {
-        guard.notifyOne();
-        return state;
-      }
-      {
+      while (true) {
+        auto state = checkForFinishOrNewCheckpoints();
+        if (state != WAIT_FOR_FINISH_OR_NEW_CHECKPOINT) {
+          guard.notifyAll();
+          return state;
+        }
+        const int remainingMillis =
+            durationMillis(keepAliveTime - Clock::now());
+        if (remainingMillis <= 0) {
+          break;
+        }
         PerfStatCollector statCollector(*threadCtx_,
                                         PerfStatReport::RECEIVER_WAIT_SLEEP);
-        guard.wait(timeoutMillis);
-      }
-      state = checkForFinishOrNewCheckpoints();
-      if (state != WAIT_FOR_FINISH_OR_NEW_CHECKPOINT) {
-        guard.notifyOne();
-        return state;
+        guard.wait(remainingMillis);
       }
     }
     // send WAIT cmd to keep sender thread alive
@@ -911,6 +1134,7 @@ void ReceiverThread::start() {
     threadStats_.setLocalErrorCode(MEMORY_ALLOCATION_ERROR);
     return;
   }
+  threadCtx_->getActivityTracker().start(&threadStats_);
   ReceiverState state = LISTEN;
   while (true) {
     ErrorCode abortCode = wdtParent_->getCurAbortCode();
@@ -925,7 +1149,13 @@ void ReceiverThread::start() {
     }
     state = (this->*stateMap_[state])();
   }
+  threadCtx_->getActivityTracker().stop();
   controller_->deRegisterThread(threadIndex_);
+  {
+    // threads waiting for the end of the session might wait for this one
+    auto cv = controller_->getCondition(WAIT_FOR_FINISH_OR_CHECKPOINT_CV);
+    cv->acquire().notifyAll();
+  }
   controller_->executeAtEnd([&]() { wdtParent_->endCurGlobalSession(); });
   WDT_CHECK(socket_.get());
   threadStats_.setEncryptionType(socket_->getEncryptionType());
@@ -941,6 +1171,9 @@ ErrorCode ReceiverThread::init() {
       wdtParent_->transferRequest_.encryptionData;
   socket_ = folly::make_unique<ServerSocket>(
       *threadCtx_, port_, wdtParent_->backlog_, encryptionData);
+  if (wdtParent_->connectionDispatcher_) {
+    socket_->setConnectionDispatcher(wdtParent_->connectionDispatcher_.get());
+  }
   int max_retries = options_.max_retries;
   for (int retries = 0; retries < max_retries; retries++) {
     if (socket_->listen() == OK) {
@@ -958,9 +1191,11 @@ ErrorCode ReceiverThread::init() {
 
 void ReceiverThread::reset() {
   numRead_ = off_ = 0;
+  fileNameDictionary_.reset();
   checkpointIndex_ = pendingCheckpointIndex_ = 0;
   senderReadTimeout_ = senderWriteTimeout_ = -1;
   curConnectionVerified_ = false;
+  keepConnectionRequested_ = false;
   threadStats_.reset();
   checkpoints_.clear();
   newCheckpoints_.clear();
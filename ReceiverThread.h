@@ -11,6 +11,7 @@
 #include <wdt/WdtThread.h>
 #include <wdt/Receiver.h>
 #include <wdt/util/ServerSocket.h>
+#include <wdt/util/SocketTuner.h>
 
 namespace facebook {
 namespace wdt {
@@ -32,6 +33,7 @@ enum ReceiverState {
   PROCESS_SETTINGS_CMD,
   PROCESS_DONE_CMD,
   PROCESS_SIZE_CMD,
+  PROCESS_BATCH_CMD,
   SEND_FILE_CHUNKS,
   SEND_GLOBAL_CHECKPOINTS,
   SEND_DONE_CMD,
@@ -108,7 +110,8 @@ class ReceiverThread : public WdtThread {
    * whether a new session has started or not. If a new session has started then
    * goes to ACCEPT_WITH_TIMEOUT state. Also does session initialization. In
    * joinable mode, tries to accept for a limited number of user specified
-   * retries.
+   * retries. In long running mode, the connection kept open by the previous
+   * transfer (if any) is reused when the sender starts a new transfer on it.
    * Previous states : LISTEN,
    *                   END(if in long running mode)
    * Next states : ACCEPT_WITH_TIMEOUT(if a new transfer has started and this
@@ -154,8 +157,10 @@ class ReceiverThread : public WdtThread {
    *                   ACCEPT_WITH_TIMEOUT,
    *                   PROCESS_SETTINGS_CMD,
    *                   PROCESS_FILE_CMD,
+   *                   PROCESS_BATCH_CMD,
    *                   SEND_GLOBAL_CHECKPOINTS,
    * Next states : PROCESS_FILE_CMD,
+   *               PROCESS_BATCH_CMD,
    *               PROCESS_DONE_CMD,
    *               PROCESS_SETTINGS_CMD,
    *               PROCESS_SIZE_CMD,
@@ -172,6 +177,15 @@ class ReceiverThread : public WdtThread {
    *               ACCEPT_WITH_TIMEOUT(socket read failure)
    */
   ReceiverState processFileCmd();
+  /**
+   * Processes batch cmd: decodes the headers of all the blocks of the batch
+   * and then receives their payloads, which are sent back to back.
+   * Previous states : READ_NEXT_CMD
+   * Next states : READ_NEXT_CMD(success),
+   *               FINISH_WITH_ERROR(protocol error),
+   *               ACCEPT_WITH_TIMEOUT(socket read failure)
+   */
+  ReceiverState processBatchCmd();
   /**
    * Processes settings cmd. Settings has a connection settings,
    * protocol version, transfer id, etc. For more info check Protocol.h
@@ -222,7 +236,8 @@ class ReceiverThread : public WdtThread {
    * Sends DONE to sender, also tries to read back ack. If anything fails during
    * this state, doneSendFailure_ thread variable is set. This flag makes the
    * state machine behave differently, effectively bypassing all session related
-   * things.
+   * things. If the sender asked for it, a long running receiver keeps the
+   * connection open for the next transfer.
    * Previous states : SEND_LOCAL_CHECKPOINT,
    *                   FINISH_WITH_ERROR
    * Next states : END(success),
@@ -270,9 +285,47 @@ class ReceiverThread : public WdtThread {
    */
   ReceiverState finishWithError();
 
+  /**
+   * Waits for the first connection of a thread the sender did not use so
+   * far (dynamic parallelism), without holding back the end of the session
+   *
+   * @return    true if a connection was accepted, false if the session ended
+   *            without it
+   */
+  bool waitForStandbyConnection();
+
+  /**
+   * Marks whether the thread has a connection of the current session and
+   * wakes up the threads waiting for the end of the session
+   */
+  void markConnected(bool connected);
+
   /// marks a block a verified
   void markBlockVerified(const BlockDetails &blockDetails);
 
+  /**
+   * Reads the transfer status and the length of a file or batch cmd header
+   * and makes sure the whole header is in the buffer. off_ is moved to the
+   * start of the encoded block header(s)
+   *
+   * @param headerLen   set to the length of the header, including the cmd
+   *
+   * @return            false on socket read failure
+   */
+  bool readFullHeader(int16_t &headerLen);
+
+  /**
+   * Receives the data and footer of a block whose header has been decoded.
+   * The data starts at off_, oldOffset_ + numRead_ being the end of the
+   * buffered bytes
+   *
+   * @param blockDetails  details of the block
+   * @param headerBytes   header bytes received for this block
+   *
+   * @return              next state, same as processFileCmd
+   */
+  ReceiverState receiveBlock(BlockDetails &blockDetails, int64_t headerBytes);
+
   /// verifies received blocks which are not already verified
   void markReceivedBlocksVerified();
 
@@ -326,11 +379,31 @@ class ReceiverThread : public WdtThread {
   /// the server socket
   bool curConnectionVerified_{false};
 
+  /// whether the sender asked to keep the current connection open at the end
+  /// of the transfer
+  bool keepConnectionRequested_{false};
+
+  /// whether the connection was kept open at the end of the previous transfer,
+  /// not reset between transfers
+  bool connectionKept_{false};
+
   /// Checkpoints that have not been sent back to the sender
   std::vector<Checkpoint> newCheckpoints_;
 
   /// list of received blocks which have not yet been verified
   std::vector<BlockDetails> blocksWaitingVerification_;
+
+  /// file names received on the current connection
+  FileNameDictionary fileNameDictionary_;
+
+  /// details of the block being received, reused to avoid allocations
+  BlockDetails blockDetails_;
+
+  /// details of the blocks of the batch being received, reused across batches
+  std::vector<BlockDetails> batchBlocks_;
+
+  /// tunes the buffers of the current connection
+  SocketTuner socketTuner_;
 };
 }
 }
@@ -9,8 +9,11 @@
 #include <wdt/Reporting.h>
 #include <wdt/WdtOptions.h>
 #include <wdt/Protocol.h>
+#include <wdt/util/JsonWriter.h>
+#include <folly/Conv.h>
 #include <folly/String.h>
 
+#include <cctype>
 #include <iostream>
 #include <iomanip>
 #include <set>
@@ -21,16 +24,58 @@ namespace wdt {
 
 const static int64_t kMaxEntriesToPrint = 10;
 
+const char* threadActivityToStr(ThreadActivity activity) {
+  static const char* kActivityNames[] = {
+      "other",       "disk-read",    "disk-write", "disk-metadata",
+      "socket-read", "socket-write", "throttled",  "queue-wait",
+      "receiver-wait"};
+  static_assert(sizeof(kActivityNames) / sizeof(kActivityNames[0]) ==
+                    NUM_THREAD_ACTIVITIES,
+                "Mismatch between number of activities and names");
+  return kActivityNames[activity];
+}
+
+std::string activityBreakdownToStr(const ActivityTimes& times) {
+  int64_t totalMicros = 0;
+  std::vector<std::pair<int64_t, int>> sortedTimes;
+  for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+    totalMicros += times[i];
+    sortedTimes.emplace_back(times[i], i);
+  }
+  if (totalMicros <= 0) {
+    return "";
+  }
+  std::sort(sortedTimes.rbegin(), sortedTimes.rend());
+  std::string result;
+  for (const auto& pair : sortedTimes) {
+    int percent = 100 * pair.first / totalMicros;
+    if (percent < 1) {
+      break;
+    }
+    if (!result.empty()) {
+      result.append(", ");
+    }
+    result.append(folly::to<std::string>(
+        percent, "% ", threadActivityToStr((ThreadActivity)pair.second)));
+  }
+  return result;
+}
+
 TransferStats& TransferStats::operator+=(const TransferStats& stats) {
   folly::RWSpinLock::WriteHolder writeLock(mutex_.get());
   folly::RWSpinLock::ReadHolder readLock(stats.mutex_.get());
-  headerBytes_ += stats.headerBytes_;
-  dataBytes_ += stats.dataBytes_;
-  effectiveHeaderBytes_ += stats.effectiveHeaderBytes_;
-  effectiveDataBytes_ += stats.effectiveDataBytes_;
-  numFiles_ += stats.numFiles_;
-  numBlocks_ += stats.numBlocks_;
-  failedAttempts_ += stats.failedAttempts_;
+  // header and data bytes are only ever merged by the owner thread, the other
+  // counters can be adjusted concurrently by the checkpoint processing thread
+  headerBytes_.add(stats.headerBytes_.get());
+  dataBytes_.add(stats.dataBytes_.get());
+  effectiveHeaderBytes_.addShared(stats.effectiveHeaderBytes_.get());
+  effectiveDataBytes_.addShared(stats.effectiveDataBytes_.get());
+  numFiles_.addShared(stats.numFiles_.get());
+  numBlocks_.addShared(stats.numBlocks_.get());
+  failedAttempts_.addShared(stats.failedAttempts_.get());
+  for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+    activityMicros_[i].add(stats.activityMicros_[i].get());
+  }
   if (numBlocksSend_ == -1) {
     numBlocksSend_ = stats.numBlocksSend_;
   } else if (stats.numBlocksSend_ != -1 &&
@@ -62,15 +107,58 @@ TransferStats& TransferStats::operator+=(const TransferStats& stats) {
   return *this;
 }
 
+void TransferStats::writeJson(JsonWriter& json) const {
+  folly::RWSpinLock::ReadHolder lock(mutex_.get());
+  json.beginObject();
+  if (!id_.empty()) {
+    json.key("id").value(id_);
+  }
+  json.key("error_code")
+      .value(errorCodeToStr(getMoreInterestingError(localErrCode_,
+                                                    remoteErrCode_)))
+      .key("local_error_code")
+      .value(errorCodeToStr(localErrCode_))
+      .key("remote_error_code")
+      .value(errorCodeToStr(remoteErrCode_))
+      .key("header_bytes")
+      .value(headerBytes_.get())
+      .key("data_bytes")
+      .value(dataBytes_.get())
+      .key("effective_header_bytes")
+      .value(effectiveHeaderBytes_.get())
+      .key("effective_data_bytes")
+      .value(effectiveDataBytes_.get())
+      .key("num_files")
+      .value(numFiles_.get())
+      .key("num_blocks")
+      .value(numBlocks_.get())
+      .key("failed_attempts")
+      .value(failedAttempts_.get())
+      .key("encryption")
+      .value(encryptionTypeToStr(encryptionType_));
+  json.key("activity_usec").beginObject();
+  for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+    json.key(threadActivityToStr((ThreadActivity)i))
+        .value(activityMicros_[i].get());
+  }
+  json.endObject();
+  json.endObject();
+}
+
 std::ostream& operator<<(std::ostream& os, const TransferStats& stats) {
   folly::RWSpinLock::ReadHolder lock(stats.mutex_.get());
   double headerOverhead = 100;
   double failureOverhead = 100;
-
-  if (stats.effectiveDataBytes_ > 0) {
-    headerOverhead = 100.0 * stats.headerBytes_ / stats.effectiveDataBytes_;
-    failureOverhead = 100.0 * (stats.dataBytes_ - stats.effectiveDataBytes_) /
-                      stats.effectiveDataBytes_;
+  // snapshot of the counters
+  const int64_t headerBytes = stats.headerBytes_.get();
+  const int64_t dataBytes = stats.dataBytes_.get();
+  const int64_t effectiveDataBytes = stats.effectiveDataBytes_.get();
+  const int64_t numFiles = stats.numFiles_.get();
+
+  if (effectiveDataBytes > 0) {
+    headerOverhead = 100.0 * headerBytes / effectiveDataBytes;
+    failureOverhead =
+        100.0 * (dataBytes - effectiveDataBytes) / effectiveDataBytes;
   }
 
   if (stats.localErrCode_ == OK && stats.remoteErrCode_ == OK) {
@@ -82,17 +170,17 @@ std::ostream& operator<<(std::ostream& os, const TransferStats& stats) {
        << ", (remote) = " << errorCodeToStr(stats.remoteErrCode_) << ".";
   }
 
-  if (stats.numFiles_ > 0) {
-    os << " Number of files transferred = " << stats.numFiles_ << ".";
+  if (numFiles > 0) {
+    os << " Number of files transferred = " << numFiles << ".";
   } else {
-    os << " Number of blocks transferred = " << stats.numBlocks_ << ".";
-  }
-  os << " Data Mbytes = " << stats.effectiveDataBytes_ / kMbToB
-     << ". Header Kbytes = " << stats.headerBytes_ / 1024. << " ("
-     << headerOverhead << "% overhead)"
-     << ". Total bytes = " << (stats.dataBytes_ + stats.headerBytes_)
-     << ". Wasted bytes due to failure = "
-     << (stats.dataBytes_ - stats.effectiveDataBytes_) << " ("
+    os << " Number of blocks transferred = " << stats.numBlocks_.get() << ".";
+  }
+  os << " Data Mbytes = " << effectiveDataBytes / kMbToB
+     << ". Header Kbytes = " << headerBytes / 1024. << " (" << headerOverhead
+     << "% overhead)"
+     << ". Total bytes = " << (dataBytes + headerBytes)
+     << ". Wasted bytes due to failure = " << (dataBytes - effectiveDataBytes)
+     << " ("
      << failureOverhead << "% overhead)"
      << ". Encryption type = " << encryptionTypeToStr(stats.encryptionType_)
      << ".";
@@ -207,8 +295,127 @@ TransferReport::TransferReport(TransferStats&& globalStats)
   summary_.setLocalErrorCode(summaryErrorCode);
 }
 
+void ThroughputSeries::reset(int64_t capacity) {
+  capacity_ = std::max<int64_t>(0, capacity);
+  numRecorded_ = 0;
+  samples_.clear();
+  samples_.reserve(capacity_);
+}
+
+void ThroughputSeries::addSample(const ThroughputSample& sample) {
+  if (capacity_ == 0) {
+    return;
+  }
+  if ((int64_t)samples_.size() < capacity_) {
+    samples_.push_back(sample);
+  } else {
+    samples_[numRecorded_ % capacity_] = sample;
+  }
+  numRecorded_++;
+}
+
+std::vector<ThroughputSample> ThroughputSeries::getSamples() const {
+  std::vector<ThroughputSample> samples;
+  const int64_t numSamples = samples_.size();
+  const int64_t first = numRecorded_ - numSamples;
+  for (int64_t i = 0; i < numSamples; i++) {
+    samples.push_back(samples_[(first + i) % capacity_]);
+  }
+  return samples;
+}
+
+static void writeThroughputSamples(
+    JsonWriter& json, const std::vector<ThroughputSample>& samples) {
+  json.beginArray();
+  for (const auto& sample : samples) {
+    json.beginObject()
+        .key("elapsed_sec")
+        .value(sample.elapsedSeconds)
+        .key("total_bytes")
+        .value(sample.totalBytes)
+        .key("effective_bytes")
+        .value(sample.effectiveBytes)
+        .key("active_threads")
+        .value(sample.activeThreads)
+        .key("failed_attempts")
+        .value(sample.failedAttempts)
+        .key("throttled_usec")
+        .value(sample.throttledMicros)
+        .endObject();
+  }
+  json.endArray();
+}
+
+std::string TransferReport::getThroughputSamplesJson() const {
+  JsonWriter json;
+  writeThroughputSamples(json, throughputSamples_);
+  return json.str();
+}
+
+/// writes the stats as a JSON array
+static void writeStatsArray(JsonWriter& json,
+                            const std::vector<TransferStats>& statsList) {
+  json.beginArray();
+  for (const auto& stats : statsList) {
+    stats.writeJson(json);
+  }
+  json.endArray();
+}
+
+void TransferReport::writeJson(JsonWriter& json) const {
+  json.beginObject()
+      .key("total_time_sec")
+      .value(totalTime_)
+      .key("total_file_size")
+      .value(totalFileSize_);
+  if (totalTime_ > 0) {
+    json.key("throughput_mbytes_per_sec").value(getThroughputMBps());
+  }
+  json.key("summary");
+  summary_.writeJson(json);
+  json.key("threads");
+  writeStatsArray(json, threadStats_);
+  json.key("transferred_sources");
+  writeStatsArray(json, transferredSourceStats_);
+  json.key("failed_sources");
+  writeStatsArray(json, failedSourceStats_);
+  json.key("failed_directories").beginArray();
+  for (const auto& directory : failedDirectories_) {
+    json.value(directory);
+  }
+  json.endArray();
+  json.key("throughput_samples");
+  writeThroughputSamples(json, throughputSamples_);
+  json.key("deadlines").beginArray();
+  for (const auto& deadline : deadlineReports_) {
+    json.beginObject()
+        .key("file")
+        .value(deadline.fileName)
+        .key("deadline_ms")
+        .value(deadline.deadlineMillis)
+        .key("sent_ms")
+        .value(deadline.sentMillis)
+        .key("met")
+        .value(deadline.met())
+        .endObject();
+  }
+  json.endArray();
+  json.key("perf_stats");
+  if (perfReport_) {
+    perfReport_->writeJson(json);
+  } else {
+    json.nullValue();
+  }
+  json.endObject();
+}
+
 std::ostream& operator<<(std::ostream& os, const TransferReport& report) {
   os << report.getSummary();
+  const std::string breakdown =
+      activityBreakdownToStr(report.getActivityTimes());
+  if (!breakdown.empty()) {
+    os << " Thread time breakdown: " << breakdown << ".";
+  }
   if (!report.failedSourceStats_.empty()) {
     if (report.summary_.getNumFiles() == 0) {
       os << " All files failed.";
@@ -251,6 +458,30 @@ std::ostream& operator<<(std::ostream& os, const TransferReport& report) {
          << " directories)";
     }
   }
+  int64_t numMissedDeadlines = 0;
+  for (const auto& deadline : report.deadlineReports_) {
+    if (!deadline.met()) {
+      numMissedDeadlines++;
+    }
+  }
+  if (numMissedDeadlines > 0) {
+    os << "\n"
+       << "Missed deadlines " << numMissedDeadlines << " of "
+       << report.deadlineReports_.size() << " :\n";
+    int64_t displayCount = 0;
+    for (const auto& deadline : report.deadlineReports_) {
+      if (deadline.met()) {
+        continue;
+      }
+      if (displayCount >= kMaxEntriesToPrint) {
+        os << "more...(" << numMissedDeadlines - displayCount << " files)";
+        break;
+      }
+      os << deadline.fileName << " deadline " << deadline.deadlineMillis
+         << " ms sent " << deadline.sentMillis << " ms\n";
+      displayCount++;
+    }
+  }
   return os;
 }
 
@@ -261,13 +492,20 @@ void ProgressReporter::progress(const std::unique_ptr<TransferReport>& report) {
   if (totalDiscoveredSize > 0) {
     progress = stats.getEffectiveDataBytes() * 100 / totalDiscoveredSize;
   }
+  // breakdown of the thread time for the last interval only
+  const ActivityTimes activityTimes = report->getActivityTimes();
+  ActivityTimes intervalTimes;
+  for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+    intervalTimes[i] = activityTimes[i] - lastActivityTimes_[i];
+  }
+  lastActivityTimes_ = activityTimes;
   if (isTty_) {
     displayProgress(progress, report->getThroughputMBps(),
                     report->getCurrentThroughputMBps());
   } else {
     logProgress(stats.getEffectiveDataBytes(), progress,
                 report->getThroughputMBps(),
-                report->getCurrentThroughputMBps());
+                report->getCurrentThroughputMBps(), intervalTimes);
   }
 }
 
@@ -305,11 +543,14 @@ void ProgressReporter::displayProgress(int progress, double averageThroughput,
 
 void ProgressReporter::logProgress(int64_t effectiveDataBytes, int progress,
                                    double averageThroughput,
-                                   double currentThroughput) {
+                                   double currentThroughput,
+                                   const ActivityTimes& activityTimes) {
+  const std::string breakdown = activityBreakdownToStr(activityTimes);
   LOG(INFO) << "wdt transfer progress " << (effectiveDataBytes / kMbToB)
             << " Mbytes, completed " << progress << "%, Average throughput "
             << averageThroughput << " Mbytes/s, Recent throughput "
-            << currentThroughput << " Mbytes/s";
+            << currentThroughput << " Mbytes/s"
+            << (breakdown.empty() ? "" : ", Threads: ") << breakdown;
 }
 
 const std::string PerfStatReport::statTypeDescription_[] = {
@@ -327,11 +568,9 @@ PerfStatReport::PerfStatReport(const WdtOptions& options) {
 }
 
 /**
- *  Semi log bucket definitions covering 5 order of magnitude (more
- *  could be added) with high resolution in small numbers and relatively
- *  small number of total buckets
- *  For efficiency a look up table is created so the last value shouldn't
- *  be too large (or will incur large memory overhead)
+ *  Semi log bucket definitions (in ms) used to display the histograms,
+ *  covering 5 order of magnitude with high resolution in small numbers and
+ *  relatively small number of total buckets
  *  value between   [ bucket(i-1), bucket(i) [ go in slot i
  *  plus every value > bucket(last) in last bucket
  */
@@ -348,95 +587,117 @@ const int32_t PerfStatReport::kHistogramBuckets[] = {
     20000, 30000, 40000, 50000, 75000, 100000};
 
 void PerfStatReport::addPerfStat(StatType statType, int64_t timeInMicros) {
-  int64_t timeInMillis = timeInMicros / kMicroToMilli;
   if (timeInMicros >= networkTimeoutMillis_ * 750) {
     LOG(WARNING) << statTypeDescription_[statType] << " system call took "
-                 << timeInMillis << " ms";
-  }
-  perfStats_[statType][timeInMillis]++;
-  maxValueMicros_[statType] =
-      std::max<int64_t>(maxValueMicros_[statType], timeInMicros);
-  minValueMicros_[statType] =
-      std::min<int64_t>(minValueMicros_[statType], timeInMicros);
-  count_[statType]++;
-  sumMicros_[statType] += timeInMicros;
+                 << timeInMicros / kMicroToMilli << " ms";
+  }
+  perfStats_[statType].record(timeInMicros);
 }
 
 PerfStatReport& PerfStatReport::operator+=(const PerfStatReport& statReport) {
   for (int i = 0; i < kNumTypes_; i++) {
-    for (const auto& pair : statReport.perfStats_[i]) {
-      int64_t key = pair.first;
-      int64_t value = pair.second;
-      perfStats_[i][key] += value;
-    }
-    maxValueMicros_[i] =
-        std::max<int64_t>(maxValueMicros_[i], statReport.maxValueMicros_[i]);
-    minValueMicros_[i] =
-        std::min<int64_t>(minValueMicros_[i], statReport.minValueMicros_[i]);
-    count_[i] += statReport.count_[i];
-    sumMicros_[i] += statReport.sumMicros_[i];
+    perfStats_[i] += statReport.perfStats_[i];
   }
   return *this;
 }
 
+std::string PerfStatReport::getStatTypeName(StatType statType) {
+  std::string name = statTypeDescription_[statType];
+  for (char& c : name) {
+    c = (c == ' ') ? '_' : std::tolower(c);
+  }
+  return name;
+}
+
+void PerfStatReport::writeJson(JsonWriter& json) const {
+  json.beginArray();
+  for (int i = 0; i < kNumTypes_; i++) {
+    const Histogram& histogram = perfStats_[i];
+    if (histogram.getCount() == 0) {
+      continue;
+    }
+    json.beginObject()
+        .key("stat")
+        .value(getStatTypeName((StatType)i))
+        .key("count")
+        .value(histogram.getCount())
+        .key("sum_usec")
+        .value(histogram.getSum())
+        .key("min_usec")
+        .value(histogram.getMin())
+        .key("max_usec")
+        .value(histogram.getMax())
+        .key("avg_usec")
+        .value(histogram.getAverage())
+        .key("p50_usec")
+        .value(histogram.getPercentile(50))
+        .key("p90_usec")
+        .value(histogram.getPercentile(90))
+        .key("p99_usec")
+        .value(histogram.getPercentile(99))
+        .key("p999_usec")
+        .value(histogram.getPercentile(99.9));
+    // non empty buckets as [start, end[ in usec and count
+    json.key("buckets").beginArray();
+    for (int b = 0; b < Histogram::kNumBuckets; b++) {
+      const int64_t count = histogram.getBucketCount(b);
+      if (count == 0) {
+        continue;
+      }
+      json.beginArray()
+          .value(Histogram::getBucketStart(b))
+          .value(Histogram::getBucketEnd(b))
+          .value(count)
+          .endArray();
+    }
+    json.endArray();
+    json.endObject();
+  }
+  json.endArray();
+}
+
 std::ostream& operator<<(std::ostream& os, const PerfStatReport& statReport) {
   os << "\n***** PERF STATS *****\n";
   for (int i = 0; i < PerfStatReport::kNumTypes_; i++) {
-    if (statReport.count_[i] == 0) {
+    const Histogram& histogram = statReport.perfStats_[i];
+    if (histogram.getCount() == 0) {
       continue;
     }
-    double max = statReport.maxValueMicros_[i] / kMicroToMilli;
-    double min = statReport.minValueMicros_[i] / kMicroToMilli;
-    double sum = (statReport.sumMicros_[i] / kMicroToMilli);
-    double avg = (((double)statReport.sumMicros_[i]) / statReport.count_[i] /
-                  kMicroToMilli);
+    double max = histogram.getMax() / kMicroToMilli;
+    double min = histogram.getMin() / kMicroToMilli;
+    double sum = histogram.getSum() / kMicroToMilli;
+    double avg = histogram.getAverage() / kMicroToMilli;
 
-    os << std::fixed << std::setprecision(2);
+    os << std::fixed << std::setprecision(3);
     os << statReport.statTypeDescription_[i] << " : ";
-    os << "Ncalls " << statReport.count_[i] << " Stats in ms : sum " << sum
-       << " Min " << min << " Max " << max << " Avg " << avg << " ";
+    os << "Ncalls " << histogram.getCount() << " Stats in ms : sum " << sum
+       << " Min " << min << " Max " << max << " Avg " << avg << " p50 "
+       << histogram.getPercentile(50) / kMicroToMilli << " p90 "
+       << histogram.getPercentile(90) / kMicroToMilli << " p99 "
+       << histogram.getPercentile(99) / kMicroToMilli << " p999 "
+       << histogram.getPercentile(99.9) / kMicroToMilli << '\n';
 
     // One extra bucket for values extending beyond last bucket
     int numBuckets = 1 +
                      sizeof(PerfStatReport::kHistogramBuckets) /
                          sizeof(PerfStatReport::kHistogramBuckets[0]);
     std::vector<int64_t> buckets(numBuckets);
-
-    auto& perfStatMap = statReport.perfStats_[i];
-    std::vector<int64_t> timesInMillis;
-    for (const auto& pair : perfStatMap) {
-      timesInMillis.emplace_back(pair.first);
-    }
-    std::sort(timesInMillis.begin(), timesInMillis.end());
+    // fold the fine grained buckets into the display ones, using the start of
+    // each histogram bucket to decide where it goes
     int currentBucketIndex = 0;
-
-    int64_t runningCount = 0;
-    int64_t p50Count = statReport.count_[i] * 0.50;
-    int64_t p95Count = statReport.count_[i] * 0.95;
-    int64_t p99Count = statReport.count_[i] * 0.99;
-
-    for (auto time : timesInMillis) {
-      WDT_CHECK(time >= 0) << time;
-      int64_t count = perfStatMap.find(time)->second;
-
-      if (p50Count > runningCount && p50Count <= runningCount + count) {
-        os << "p50 " << time << " ";
-      }
-      if (p95Count > runningCount && p95Count <= runningCount + count) {
-        os << "p95 " << time << " ";
-      }
-      if (p99Count > runningCount && p99Count <= runningCount + count) {
-        os << "p99 " << time;
+    for (int b = 0; b < Histogram::kNumBuckets; b++) {
+      int64_t count = histogram.getBucketCount(b);
+      if (count == 0) {
+        continue;
       }
-      runningCount += count;
-
+      double startMillis = Histogram::getBucketStart(b) / kMicroToMilli;
       while (currentBucketIndex < numBuckets - 1 &&
-             time >= PerfStatReport::kHistogramBuckets[currentBucketIndex]) {
+             startMillis >=
+                 PerfStatReport::kHistogramBuckets[currentBucketIndex]) {
         currentBucketIndex++;
       }
       buckets[currentBucketIndex] += count;
     }
-    os << '\n';
     for (int i = 0; i < numBuckets; i++) {
       if (buckets[i] == 0) {
         continue;
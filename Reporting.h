@@ -13,14 +13,16 @@
 #include <wdt/util/EncryptionUtils.h>
 #include <wdt/WdtTransferRequest.h>
 #include <wdt/AbortChecker.h>
+#include <wdt/util/Histogram.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <chrono>
 #include <limits>
 #include <iterator>
-#include <unordered_map>
 
 #include <folly/RWSpinLock.h>
 #include <folly/SpinLock.h>
@@ -29,6 +31,12 @@
 namespace facebook {
 namespace wdt {
 
+class JsonWriter;
+class PerfStatReport;
+
+/// version of the JSON report format, bumped on incompatible changes
+const int kReportJsonVersion = 1;
+
 const double kMbToB = 1024 * 1024;
 const double kMicroToMilli = 1000;
 const double kMicroToSec = 1000 * 1000;
@@ -56,28 +64,124 @@ std::ostream &operator<<(std::ostream &os, const std::vector<T> &v) {
   return os;
 }
 
+/// size of a cache line, used to keep hot counters of different threads apart
+const int kCacheLineSize = 64;
+
+/**
+ * 64 bit counter which can be read from any thread without locking. add() is
+ * a plain load + store and must only be used by the single thread owning the
+ * counter, addShared() is an atomic add to be used when other threads may
+ * update the same counter concurrently. Copying is not atomic with respect to
+ * concurrent updates (it is a snapshot).
+ */
+class StatCounter {
+ public:
+  explicit StatCounter(int64_t value = 0) : value_(value) {
+  }
+
+  StatCounter(const StatCounter &other) : value_(other.get()) {
+  }
+
+  StatCounter &operator=(const StatCounter &other) {
+    set(other.get());
+    return *this;
+  }
+
+  /// @return current value of the counter
+  int64_t get() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  /// @param value    new value of the counter
+  void set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  /// @param count    amount to add, only safe from the owner thread
+  void add(int64_t count) {
+    value_.store(get() + count, std::memory_order_relaxed);
+  }
+
+  /// @param count    amount to add, safe from any thread
+  void addShared(int64_t count) {
+    value_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> value_;
+};
+
+/**
+ * Exclusive activities the wall time of sender and receiver threads is
+ * attributed to. Tells whether a slow transfer is bound by the disk, the
+ * network, the throttler or the work distribution.
+ */
+enum ThreadActivity {
+  ACT_OTHER,          // protocol processing, checksums, connecting, etc...
+  ACT_DISK_READ,      // reading source files
+  ACT_DISK_WRITE,     // writing and syncing destination files
+  ACT_DISK_METADATA,  // open, close, seek, mkdir, unlink, fadvise
+  ACT_SOCKET_READ,    // blocked reading from the socket
+  ACT_SOCKET_WRITE,   // blocked writing to the socket
+  ACT_THROTTLED,      // sleeping in the throttler
+  ACT_QUEUE_WAIT,     // waiting for the source queue to produce work
+  ACT_RECEIVER_WAIT,  // receiver waiting for other threads (WAIT_CMD loop)
+  NUM_THREAD_ACTIVITIES
+};
+
+/// @return   short name of the activity, e.g "socket-write"
+const char *threadActivityToStr(ThreadActivity activity);
+
+/// time spent in microseconds for each ThreadActivity
+typedef std::array<int64_t, NUM_THREAD_ACTIVITIES> ActivityTimes;
+
+/**
+ * @param times   time spent in each activity
+ *
+ * @return        breakdown by decreasing share, skipping activities under 1%
+ *                e.g "62% socket-write, 20% disk-read, 10% throttled"
+ */
+std::string activityBreakdownToStr(const ActivityTimes &times);
+
 // TODO rename to ThreadResult
-/// class representing statistics related to file transfer
+/**
+ * class representing statistics related to file transfer
+ *
+ * Byte and block counters are lock-free: they are updated several times per
+ * buffer on the hot path by the owning thread and read concurrently by the
+ * progress reporter. Header/data bytes have a single writer (the owning
+ * thread). Effective bytes, blocks and failed attempts can also be adjusted
+ * by the thread processing a global checkpoint, so they use atomic adds. The
+ * counters are surrounded by padding and the rarely written fields so that
+ * the counters of two different threads never share a cache line. Those
+ * rarely written fields are protected by mutex_ when the object is locked.
+ */
 class TransferStats {
  private:
+  /// padding to avoid false sharing with whatever precedes this object
+  char padding_[kCacheLineSize];
+
   /// number of header bytes transferred
-  int64_t headerBytes_ = 0;
+  StatCounter headerBytes_;
   /// number of data bytes transferred
-  int64_t dataBytes_ = 0;
+  StatCounter dataBytes_;
 
   /// number of header bytes transferred as part of successful file transfer
-  int64_t effectiveHeaderBytes_ = 0;
+  StatCounter effectiveHeaderBytes_;
   /// number of data bytes transferred as part of successful file transfer
-  int64_t effectiveDataBytes_ = 0;
+  StatCounter effectiveDataBytes_;
 
   /// number of files successfully transferred
-  int64_t numFiles_ = 0;
+  StatCounter numFiles_;
 
   /// number of blocks successfully transferred
-  int64_t numBlocks_ = 0;
+  StatCounter numBlocks_;
 
   /// number of failed transfers
-  int64_t failedAttempts_ = 0;
+  StatCounter failedAttempts_;
+
+  /// time in microseconds spent by the owner thread in each activity
+  StatCounter activityMicros_[NUM_THREAD_ACTIVITIES];
 
   /// Total number of blocks sent by sender
   int64_t numBlocksSend_{-1};
@@ -97,7 +201,7 @@ class TransferStats {
   /// encryption type used
   EncryptionType encryptionType_{ENC_NONE};
 
-  /// mutex to support synchronized access
+  /// mutex to support synchronized access to the non counter fields
   std::unique_ptr<folly::RWSpinLock> mutex_{nullptr};
 
  public:
@@ -120,10 +224,16 @@ class TransferStats {
 
   void reset() {
     folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    headerBytes_ = dataBytes_ = 0;
-    effectiveHeaderBytes_ = effectiveDataBytes_ = 0;
-    numFiles_ = numBlocks_ = 0;
-    failedAttempts_ = 0;
+    headerBytes_.set(0);
+    dataBytes_.set(0);
+    effectiveHeaderBytes_.set(0);
+    effectiveDataBytes_.set(0);
+    numFiles_.set(0);
+    numBlocks_.set(0);
+    failedAttempts_.set(0);
+    for (auto &activityMicros : activityMicros_) {
+      activityMicros.set(0);
+    }
     localErrCode_ = remoteErrCode_ = OK;
   }
 
@@ -141,30 +251,23 @@ class TransferStats {
 
   /// @return number of header bytes transferred
   int64_t getHeaderBytes() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return headerBytes_;
+    return headerBytes_.get();
   }
 
   /// @return number of data bytes transferred
   int64_t getDataBytes() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return dataBytes_;
+    return dataBytes_.get();
   }
 
   /**
-   * @param needLocking     specifies whether we need to lock or not. this is
-   *                        for performance improvement. in sender, we do not
-   *                        need locking for this call, even though the other
-   *                        calls have to be locked
+   * @param needLocking     kept for compatibility, the byte counters are
+   *                        lock-free so this is ignored
    *
    * @return                number of total bytes transferred
    */
   int64_t getTotalBytes(bool needLocking = true) const {
-    if (needLocking) {
-      folly::RWSpinLock::ReadHolder lock(mutex_.get());
-      return headerBytes_ + dataBytes_;
-    }
-    return headerBytes_ + dataBytes_;
+    (void)needLocking;
+    return headerBytes_.get() + dataBytes_.get();
   }
 
   /**
@@ -172,8 +275,7 @@ class TransferStats {
    *            transfer
    */
   int64_t getEffectiveHeaderBytes() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return effectiveHeaderBytes_;
+    return effectiveHeaderBytes_.get();
   }
 
   /**
@@ -181,8 +283,7 @@ class TransferStats {
    *            transfer
    */
   int64_t getEffectiveDataBytes() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return effectiveDataBytes_;
+    return effectiveDataBytes_.get();
   }
 
   /**
@@ -190,26 +291,31 @@ class TransferStats {
    *            transfer
    */
   int64_t getEffectiveTotalBytes() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return effectiveHeaderBytes_ + effectiveDataBytes_;
+    return effectiveHeaderBytes_.get() + effectiveDataBytes_.get();
   }
 
   /// @return number of files successfully transferred
   int64_t getNumFiles() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return numFiles_;
+    return numFiles_.get();
   }
 
   /// @return number of blocks successfully transferred
   int64_t getNumBlocks() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return numBlocks_;
+    return numBlocks_.get();
   }
 
   /// @return number of failed transfers
   int64_t getFailedAttempts() const {
-    folly::RWSpinLock::ReadHolder lock(mutex_.get());
-    return failedAttempts_;
+    return failedAttempts_.get();
+  }
+
+  /// @return time spent in each activity (in microseconds)
+  ActivityTimes getActivityTimes() const {
+    ActivityTimes times;
+    for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+      times[i] = activityMicros_[i].get();
+    }
+    return times;
   }
 
   /// @return error code based on combinator of local and remote error
@@ -235,16 +341,22 @@ class TransferStats {
     return id_;
   }
 
-  /// @param number of additional data bytes transferred
+  /// @param number of additional data bytes transferred (owner thread only)
   void addDataBytes(int64_t count) {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    dataBytes_ += count;
+    dataBytes_.add(count);
   }
 
-  /// @param number of additional header bytes transferred
+  /// @param number of additional header bytes transferred (owner thread only)
   void addHeaderBytes(int64_t count) {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    headerBytes_ += count;
+    headerBytes_.add(count);
+  }
+
+  /**
+   * @param activity    activity the time was spent in
+   * @param micros      time spent in microseconds (owner thread only)
+   */
+  void addActivityTime(ThreadActivity activity, int64_t micros) {
+    activityMicros_[activity].add(micros);
   }
 
   /// @param set num blocks send
@@ -261,8 +373,7 @@ class TransferStats {
 
   /// one more file transfer failed
   void incrFailedAttempts() {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    failedAttempts_++;
+    failedAttempts_.addShared(1);
   }
 
   /// @param status of the transfer
@@ -285,19 +396,16 @@ class TransferStats {
 
   /// @param numFiles number of files successfully send
   void setNumFiles(int64_t numFiles) {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    numFiles_ = numFiles;
+    numFiles_.set(numFiles);
   }
 
   /// one more block successfully transferred
   void incrNumBlocks() {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    numBlocks_++;
+    numBlocks_.addShared(1);
   }
 
   void decrNumBlocks() {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    numBlocks_--;
+    numBlocks_.addShared(-1);
   }
 
   /**
@@ -307,15 +415,13 @@ class TransferStats {
    *                    transfer
    */
   void addEffectiveBytes(int64_t headerBytes, int64_t dataBytes) {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    effectiveHeaderBytes_ += headerBytes;
-    effectiveDataBytes_ += dataBytes;
+    effectiveHeaderBytes_.addShared(headerBytes);
+    effectiveDataBytes_.addShared(dataBytes);
   }
 
   void subtractEffectiveBytes(int64_t headerBytes, int64_t dataBytes) {
-    folly::RWSpinLock::WriteHolder lock(mutex_.get());
-    effectiveHeaderBytes_ -= headerBytes;
-    effectiveDataBytes_ -= dataBytes;
+    effectiveHeaderBytes_.addShared(-headerBytes);
+    effectiveDataBytes_.addShared(-dataBytes);
   }
 
   void setEncryptionType(EncryptionType encryptionType) {
@@ -328,11 +434,74 @@ class TransferStats {
     return encryptionType_;
   }
 
+  /**
+   * Merges the given stats into this one. The counters of stats are read
+   * without locking, so this is also a cheap way to snapshot the stats of a
+   * running thread into an unlocked object.
+   */
   TransferStats &operator+=(const TransferStats &stats);
 
+  /// writes the stats as a JSON object
+  void writeJson(JsonWriter &json) const;
+
   friend std::ostream &operator<<(std::ostream &os, const TransferStats &stats);
 };
 
+/// One point of the throughput time series of a transfer, values are
+/// cumulative since the start of the transfer
+struct ThroughputSample {
+  /// seconds since the start of the transfer
+  double elapsedSeconds{0};
+  /// header and data bytes, including retransmissions
+  int64_t totalBytes{0};
+  /// header and data bytes of successfully transferred blocks
+  int64_t effectiveBytes{0};
+  /// number of threads still transferring
+  int32_t activeThreads{0};
+  /// failed block transfer attempts
+  int64_t failedAttempts{0};
+  /// time spent by all the threads sleeping in the throttler
+  int64_t throttledMicros{0};
+};
+
+/**
+ * Fixed size ring of throughput samples, the oldest samples are overwritten
+ * once full. Written by the progress reporting thread and read once that
+ * thread has been joined, so there is no locking.
+ */
+class ThroughputSeries {
+ public:
+  /// @param capacity   max number of samples kept, 0 disables the series
+  void reset(int64_t capacity);
+
+  /// records a sample, no-op if the capacity is 0
+  void addSample(const ThroughputSample &sample);
+
+  /// @return   kept samples, oldest first
+  std::vector<ThroughputSample> getSamples() const;
+
+ private:
+  std::vector<ThroughputSample> samples_;
+  int64_t capacity_{0};
+  /// total number of samples ever recorded
+  int64_t numRecorded_{0};
+};
+
+/// Whether a file with a deadline was sent in time (@see WdtFileInfo)
+struct FileDeadlineReport {
+  std::string fileName;
+  /// milliseconds since the start of the transfer
+  int64_t deadlineMillis{0};
+  /// milliseconds between the start of the transfer and the write of the
+  /// last block of the file on the sockets, -1 if it was not sent
+  int64_t sentMillis{-1};
+
+  /// @return   whether the deadline was met
+  bool met() const {
+    return sentMillis >= 0 && sentMillis <= deadlineMillis;
+  }
+};
+
 /**
  * Class representing entire client transfer report.
  * Unit are mebibyte (MiB), ie 1048576 bytes which we call "Mbytes"
@@ -391,10 +560,31 @@ class TransferReport {
   int64_t getTotalFileSize() const {
     return totalFileSize_;
   }
+  /// @return   time spent by all the threads in each activity
+  ActivityTimes getActivityTimes() const {
+    return summary_.getActivityTimes();
+  }
   /// @return   recent throughput in Mbytes/sec
   double getCurrentThroughputMBps() const {
     return currentThroughput_ / kMbToB;
   }
+  /// @return   throughput samples taken every progress interval
+  const std::vector<ThroughputSample> &getThroughputSamples() const {
+    return throughputSamples_;
+  }
+  /// @return   throughput samples as a JSON array of objects
+  std::string getThroughputSamplesJson() const;
+  /// @return   files with a deadline, in the order of their deadlines
+  const std::vector<FileDeadlineReport> &getDeadlineReports() const {
+    return deadlineReports_;
+  }
+  /// @return   perf stats of the transfer, nullptr if not collected
+  const PerfStatReport *getPerfReport() const {
+    return perfReport_.get();
+  }
+  /// writes the whole report (summary, threads, sources, samples, perf stats)
+  /// as a JSON object
+  void writeJson(JsonWriter &json) const;
   /// @param stats  stats to added
   void addTransferStats(const TransferStats &stats) {
     summary_ += stats;
@@ -409,6 +599,15 @@ class TransferReport {
   void setTotalFileSize(int64_t totalFileSize) {
     totalFileSize_ = totalFileSize;
   }
+  void setThroughputSamples(std::vector<ThroughputSample> &&samples) {
+    throughputSamples_ = std::move(samples);
+  }
+  void setDeadlineReports(std::vector<FileDeadlineReport> &&reports) {
+    deadlineReports_ = std::move(reports);
+  }
+  void setPerfReport(std::unique_ptr<PerfStatReport> perfReport) {
+    perfReport_ = std::move(perfReport);
+  }
   void setErrorCode(const ErrorCode errCode) {
     summary_.setLocalErrorCode(errCode);
     summary_.setRemoteErrorCode(errCode);
@@ -432,6 +631,12 @@ class TransferReport {
   int64_t totalFileSize_{0};
   /// recent throughput in bytes/sec
   double currentThroughput_{0};
+  /// throughput time series of the transfer
+  std::vector<ThroughputSample> throughputSamples_;
+  /// merged perf stats of the threads, only set at the end of the transfer
+  std::unique_ptr<PerfStatReport> perfReport_;
+  /// files with a deadline, only set at the end of the transfer
+  std::vector<FileDeadlineReport> deadlineReports_;
 };
 
 /**
@@ -492,12 +697,17 @@ class ProgressReporter {
    * @param progress              progress percentage
    * @param throughput            average throughput
    * @param currentThroughput     recent throughput
+   * @param activityTimes         thread time breakdown since the last call
    */
   void logProgress(int64_t effectiveDataBytes, int progress,
-                   double averageThroughput, double currentThroughput);
+                   double averageThroughput, double currentThroughput,
+                   const ActivityTimes &activityTimes);
 
   /// whether stdout is redirected to a terminal or not
   bool isTty_;
+
+  /// activity times at the previous progress call
+  ActivityTimes lastActivityTimes_{};
 };
 
 /// class representing perf stat collection
@@ -527,11 +737,30 @@ class PerfStatReport {
   explicit PerfStatReport(const WdtOptions &options);
 
   /**
+   * Records one sample. This is O(1) and allocation free so that perf stat
+   * collection is cheap enough to be left on.
+   *
    * @param statType      stat-type
    * @param timeInMicros  time taken by the operation in microseconds
    */
   void addPerfStat(StatType statType, int64_t timeInMicros);
 
+  /// @return   histogram (in microseconds) of the given stat type
+  const Histogram &getHistogram(StatType statType) const {
+    return perfStats_[statType];
+  }
+
+  /// @return   human readable description of the stat type
+  static const std::string &getStatTypeDescription(StatType statType) {
+    return statTypeDescription_[statType];
+  }
+
+  /// @return   stable machine friendly name of the stat type (e.g file_write)
+  static std::string getStatTypeName(StatType statType);
+
+  /// writes the non empty histograms as a JSON array
+  void writeJson(JsonWriter &json) const;
+
   friend std::ostream &operator<<(std::ostream &os,
                                   const PerfStatReport &statReport);
   PerfStatReport &operator+=(const PerfStatReport &statReport);
@@ -540,16 +769,8 @@ class PerfStatReport {
   const static int kNumTypes_ = PerfStatReport::END;
   const static std::string statTypeDescription_[];
   const static int32_t kHistogramBuckets[];
-  /// mapping from time to number of entries
-  std::unordered_map<int64_t, int64_t> perfStats_[kNumTypes_];
-  /// max time for different stat types
-  int64_t maxValueMicros_[kNumTypes_] = {0};
-  /// min time for different stat types
-  int64_t minValueMicros_[kNumTypes_] = {std::numeric_limits<int64_t>::max()};
-  /// number of records for different stat types
-  int64_t count_[kNumTypes_] = {0};
-  /// sum of all records for different stat types
-  int64_t sumMicros_[kNumTypes_] = {0};
+  /// log-linear histogram of durations in microseconds for each stat type
+  Histogram perfStats_[kNumTypes_];
   /// network timeout in milliseconds
   int networkTimeoutMillis_;
 };
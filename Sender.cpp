@@ -32,6 +32,10 @@ void Sender::endCurTransfer() {
   if (throttler_) {
     throttler_->deRegisterTransfer();
   }
+  if (blockCache_) {
+    // the other destinations must not keep blocks for this one
+    blockCache_->removeConsumer(blockCacheConsumer_);
+  }
 }
 
 void Sender::startNewTransfer() {
@@ -157,6 +161,35 @@ void Sender::setFollowSymlinks(const bool followSymlinks) {
   dirQueue_->setFollowSymlinks(followSymlinks);
 }
 
+void Sender::enableBlockForwarding() {
+  dirQueue_->enableExternalBlocks();
+}
+
+void Sender::forwardBlock(const std::string &relPath, int64_t fileSize,
+                          int64_t offset, int64_t size) {
+  dirQueue_->addBlock(relPath, fileSize, offset, size);
+}
+
+ErrorCode Sender::addSource(const std::string &relPath, int64_t size,
+                            std::shared_ptr<SourceReader> reader) {
+  return dirQueue_->addSource(relPath, size, std::move(reader));
+}
+
+ErrorCode Sender::addStream(const std::string &relPath,
+                            std::shared_ptr<StreamReader> reader) {
+  return dirQueue_->addStream(relPath, std::move(reader));
+}
+
+void Sender::finishForwarding() {
+  dirQueue_->finishAddingBlocks();
+}
+
+void Sender::setBlockCache(SharedBlockCache *blockCache, int consumer) {
+  blockCache_ = blockCache;
+  blockCacheConsumer_ = consumer;
+  dirQueue_->setBlockCache(blockCache, consumer);
+}
+
 void Sender::setProgressReportIntervalMillis(
     const int progressReportIntervalMillis) {
   progressReportIntervalMillis_ = progressReportIntervalMillis;
@@ -223,6 +256,26 @@ std::unique_ptr<TransferReport> Sender::getTransferReport() {
   return transferReport;
 }
 
+void Sender::exportMetrics(OpenMetricsSerializer &serializer,
+                           const MetricLabels &labels) {
+  WdtBase::exportMetrics(serializer, labels);
+  std::lock_guard<std::mutex> lock(threadStatsMutex_);
+  if (senderThreads_.empty() || threadStatsMoved_) {
+    // not started yet or finished, in which case finish() returned the report
+    return;
+  }
+  serializer.addTransferReport(*getTransferReport(), labels);
+  serializer.addSample("wdt_queued_blocks", OpenMetricsSerializer::GAUGE,
+                       "Blocks waiting in the sender queue", labels,
+                       dirQueue_->getNumPendingBlocks());
+  PerfStatReport perfReport(options_);
+  for (auto &senderThread : senderThreads_) {
+    perfReport += senderThread->getPerfReport();
+  }
+  perfReport += dirQueue_->getPerfReport();
+  serializer.addPerfStatReport(perfReport, labels);
+}
+
 Clock::time_point Sender::getEndTime() {
   return endTime_;
 }
@@ -263,14 +316,26 @@ std::unique_ptr<TransferReport> Sender::finish() {
   if (progressReportEnabled) {
     progressReporterThread_.join();
   }
+  if (parallelismController_) {
+    parallelismThread_.join();
+  }
   std::vector<TransferStats> threadStats;
-  for (auto &senderThread : senderThreads_) {
-    threadStats.push_back(senderThread->moveStats());
+  {
+    std::lock_guard<std::mutex> lock(threadStatsMutex_);
+    for (auto &senderThread : senderThreads_) {
+      threadStats.push_back(senderThread->moveStats());
+    }
+    threadStatsMoved_ = true;
   }
+  writeTrace(senderThreads_, "sender");
 
   bool allSourcesAcked = false;
-  for (auto &senderThread : senderThreads_) {
-    auto &stats = senderThread->getTransferStats();
+  for (size_t i = 0; i < senderThreads_.size(); i++) {
+    if (parallelismController_ && !parallelismController_->wasActivated(i)) {
+      // never connected, so it did not get anything acked
+      continue;
+    }
+    auto &stats = senderThreads_[i]->getTransferStats();
     if (stats.getErrorCode() == OK) {
       // at least one thread finished correctly
       // that means all transferred sources are acked
@@ -306,18 +371,23 @@ std::unique_ptr<TransferReport> Sender::finish() {
           transferredSourceStats, dirQueue_->getFailedSourceStats(),
           threadStats, dirQueue_->getFailedDirectories(), totalTime,
           totalFileSize, dirQueue_->getCount());
+  transferReport->setThroughputSamples(throughputSeries_.getSamples());
+  transferReport->setDeadlineReports(dirQueue_->getDeadlineReports(startTime_));
 
   if (progressReportEnabled) {
     progressReporter_->end(transferReport);
   }
   if (options_.enable_perf_stat_collection) {
-    PerfStatReport report(options_);
+    std::unique_ptr<PerfStatReport> report =
+        folly::make_unique<PerfStatReport>(options_);
     for (auto &senderThread : senderThreads_) {
-      report += senderThread->getPerfReport();
+      *report += senderThread->getPerfReport();
     }
-    report += dirQueue_->getPerfReport();
-    LOG(INFO) << report;
+    *report += dirQueue_->getPerfReport();
+    LOG(INFO) << *report;
+    transferReport->setPerfReport(std::move(report));
   }
+  writeReportJson(*transferReport, "sender");
   double directoryTime;
   directoryTime = dirQueue_->getDirectoryTime();
   LOG(INFO) << "Total sender time = " << totalTime << " seconds ("
@@ -372,8 +442,22 @@ ErrorCode Sender::start() {
   threadsController_->setNumFunnels(SenderThread::NUM_FUNNELS);
   threadsController_->setNumConditions(SenderThread::NUM_CONDITIONS);
   // TODO: fix this ! use transferRequest! (and dup from Receiver)
-  senderThreads_ = threadsController_->makeThreads<Sender, SenderThread>(
-      this, transferRequest_.ports.size(), transferRequest_.ports);
+  {
+    std::lock_guard<std::mutex> lock(threadStatsMutex_);
+    senderThreads_ = threadsController_->makeThreads<Sender, SenderThread>(
+        this, transferRequest_.ports.size(), transferRequest_.ports);
+  }
+  if ((options_.dynamic_parallelism || isTinyTransferEnabled()) &&
+      transferRequest_.ports.size() > 1) {
+    // the other connections wait in standby until they are needed
+    if (protocolVersion_ >= Protocol::DYNAMIC_PARALLELISM_VERSION) {
+      parallelismController_ = folly::make_unique<ParallelismController>(
+          transferRequest_.ports.size(), options_.parallelism_min_gain);
+    } else if (options_.dynamic_parallelism) {
+      LOG(WARNING) << "Turning off dynamic parallelism because of protocol "
+                      "version " << protocolVersion_;
+    }
+  }
   if (downloadResumptionEnabled_ && options_.delete_extra_files) {
     if (protocolVersion_ >= Protocol::DELETE_CMD_VERSION) {
       dirQueue_->enableFileDeletion();
@@ -390,10 +474,14 @@ ErrorCode Sender::start() {
     senderThread->startThread();
   }
   if (progressReportEnabled) {
+    throughputSeries_.reset(options_.throughput_series_size);
     progressReporter_->start();
     std::thread reporterThread(&Sender::reportProgress, this);
     progressReporterThread_ = std::move(reporterThread);
   }
+  if (parallelismController_) {
+    parallelismThread_ = std::thread(&Sender::adjustParallelism, this);
+  }
   return OK;
 }
 
@@ -464,11 +552,12 @@ void Sender::reportProgress() {
         break;
       }
     }
+    std::unique_ptr<TransferReport> transferReport = getTransferReport();
+    recordThroughputSample(*transferReport);
     if (!dirQueue_->fileDiscoveryFinished()) {
       continue;
     }
 
-    std::unique_ptr<TransferReport> transferReport = getTransferReport();
     intervalsSinceLastUpdate++;
     if (intervalsSinceLastUpdate >= throughputUpdateInterval) {
       auto curTime = Clock::now();
@@ -485,5 +574,68 @@ void Sender::reportProgress() {
     progressReporter_->progress(transferReport);
   }
 }
+
+bool Sender::isTinyTransferEnabled() const {
+  return options_.tiny_transfer_max_bytes > 0 &&
+         options_.tiny_transfer_max_files > 0;
+}
+
+bool Sender::isTinyTransfer() {
+  std::call_once(tinyTransferDecided_, [this] {
+    tinyTransfer_ =
+        isTinyTransferEnabled() &&
+        dirQueue_->waitForDiscovery(options_.tiny_transfer_max_files,
+                                    options_.tiny_transfer_max_bytes,
+                                    kTinyTransferWaitMillis,
+                                    &abortCheckerCallback_);
+  });
+  return tinyTransfer_;
+}
+
+void Sender::adjustParallelism() {
+  if (isTinyTransferEnabled()) {
+    if (isTinyTransfer()) {
+      // setting up more connections would take longer than the transfer
+      LOG(INFO) << "Tiny transfer of " << dirQueue_->getCount() << " files, "
+                << dirQueue_->getTotalSize() << " bytes, using a single "
+                << "connection";
+      return;
+    }
+    if (!options_.dynamic_parallelism) {
+      parallelismController_->activateAll();
+      return;
+    }
+  }
+  WDT_CHECK(options_.parallelism_adjust_interval_millis > 0);
+  auto waitingTime =
+      std::chrono::milliseconds(options_.parallelism_adjust_interval_millis);
+  std::vector<int64_t> lastBytes(senderThreads_.size(), 0);
+  std::vector<double> throughputs(senderThreads_.size(), 0);
+  auto lastTime = Clock::now();
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      conditionFinished_.wait_for(lock, waitingTime);
+      if (transferStatus_ != ONGOING) {
+        break;
+      }
+    }
+    auto curTime = Clock::now();
+    double time = durationSeconds(curTime - lastTime);
+    lastTime = curTime;
+    for (size_t i = 0; i < senderThreads_.size(); i++) {
+      int64_t curBytes =
+          senderThreads_[i]->getTransferStats().getEffectiveDataBytes();
+      throughputs[i] = (curBytes - lastBytes[i]) / time;
+      lastBytes[i] = curBytes;
+    }
+    // retiring sends the done cmd, which needs the final number of blocks
+    const bool discoveryFinished = dirQueue_->fileDiscoveryFinished();
+    const bool hasPendingWork =
+        !discoveryFinished || dirQueue_->getNumPendingBlocks() > 0;
+    parallelismController_->update(throughputs, hasPendingWork,
+                                   discoveryFinished);
+  }
+}
 }
 }  // namespace facebook::wdt
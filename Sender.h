@@ -10,8 +10,10 @@
 
 #include <wdt/WdtBase.h>
 #include <wdt/util/ClientSocket.h>
+#include <wdt/util/ParallelismController.h>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <iostream>
 
 namespace facebook {
@@ -112,6 +114,68 @@ class Sender : public WdtBase {
   /// @param followSymlinks   whether to follow symlinks or not
   void setFollowSymlinks(bool followSymlinks);
 
+  /**
+   * The blocks to send are added with forwardBlock() or addSource() instead
+   * of being discovered in the source directory. Used by a receiver
+   * forwarding what it receives to the next receiver of a chain, or to send
+   * application data. Must be called before transferAsync()
+   */
+  void enableBlockForwarding();
+
+  /**
+   * Adds a block of a file already written in the source directory
+   *
+   * @param relPath       relative path of the file
+   * @param fileSize      size of the whole file
+   * @param offset        offset of the block in the file
+   * @param size          size of the block
+   */
+  void forwardBlock(const std::string &relPath, int64_t fileSize,
+                    int64_t offset, int64_t size);
+
+  /**
+   * Adds a source which is not a file of the source directory, e.g. a
+   * snapshot in memory (@see MemorySourceReader) or data produced on demand
+   * by the application (@see SourceReader). It is received as a file.
+   * Needs enableBlockForwarding()
+   *
+   * @param relPath       relative path of the file on the receiver
+   * @param size          size of the source
+   * @param reader        reader of the content of the source
+   *
+   * @return              ALREADY_EXISTS if the path was already added
+   */
+  ErrorCode addSource(const std::string &relPath, int64_t size,
+                      std::shared_ptr<SourceReader> reader);
+
+  /**
+   * Adds a source whose size is only known once it ends, e.g. the output of
+   * a dump process (@see FdStreamReader). Its blocks are sent while it is
+   * being read, it is spooled to a file of stream_spool_dir so that blocks
+   * can be sent again. Needs enableBlockForwarding()
+   *
+   * @param relPath       relative path of the file on the receiver
+   * @param reader        reader of the stream
+   *
+   * @return              ALREADY_EXISTS if the path was already added
+   */
+  ErrorCode addStream(const std::string &relPath,
+                      std::shared_ptr<StreamReader> reader);
+
+  /// no more blocks will be forwarded or sources added, the transfer ends
+  /// once they are sent
+  void finishForwarding();
+
+  /**
+   * Forwarded blocks are read once for this sender and the other senders of
+   * the cache (@see MultiSender). The sender leaves the cache once its
+   * transfer ends
+   *
+   * @param blockCache    cache of the blocks of all the senders
+   * @param consumer      destination of this sender in the cache
+   */
+  void setBlockCache(SharedBlockCache *blockCache, int consumer);
+
   /// Get the destination sender is sending to
   /// @return     destination host-name
   const std::string &getDestination() const;
@@ -131,6 +195,11 @@ class Sender : public WdtBase {
   /// @return    minimal transfer report using transfer stats of the thread
   std::unique_ptr<TransferReport> getTransferReport();
 
+  /// Exports the transfer counters, queue depth and perf stats while the
+  /// transfer is running (@see WdtBase.h)
+  void exportMetrics(OpenMetricsSerializer &serializer,
+                     const MetricLabels &labels) override;
+
   /// Interface to make socket
   class ISocketCreator {
    public:
@@ -211,10 +280,34 @@ class Sender : public WdtBase {
    */
   void reportProgress();
 
+  /**
+   * Keeps a tiny transfer on the first connection, then periodically
+   * measures the throughput of every connection and lets the parallelism
+   * controller open or retire connections (dynamic_parallelism)
+   */
+  void adjustParallelism();
+
+  /// @return   whether tiny transfers use a single connection
+  bool isTinyTransferEnabled() const;
+
+  /**
+   * Tells whether the transfer is tiny, i.e. at most tiny_transfer_max_files
+   * files and tiny_transfer_max_bytes bytes. The first call waits for the
+   * discovery, at most kTinyTransferWaitMillis, the result is kept for the
+   * other calls. Transfers of forwarded blocks or streams are never tiny
+   *
+   * @return    true if tiny transfers are enabled and this one is
+   */
+  bool isTinyTransfer();
+
   /// Address of the destination host where the files are sent
   const std::string destHost_;
   /// Pointer to DirectorySourceQueue which reads the srcDir and the files
   std::unique_ptr<DirectorySourceQueue> dirQueue_;
+  /// Cache of the forwarded blocks shared with other senders, if any
+  SharedBlockCache *blockCache_{nullptr};
+  /// Destination of this sender in blockCache_
+  int blockCacheConsumer_{0};
   /// Number of active threads, decremented every time a thread is finished
   int32_t numActiveThreads_{0};
   /// The directory from where the files are read
@@ -231,8 +324,25 @@ class Sender : public WdtBase {
   std::thread dirThread_;
   /// Threads which are responsible for transfer of the sources
   std::vector<std::unique_ptr<WdtThread>> senderThreads_;
+  /// Protects senderThreads_ creation and the move of their stats in finish()
+  /// against concurrent exportMetrics() calls
+  std::mutex threadStatsMutex_;
+  /// Whether finish() already moved the stats out of the threads
+  bool threadStatsMoved_{false};
   /// Thread responsible for doing the progress checks. Uses reportProgress()
   std::thread progressReporterThread_;
+  /// Decides which connections are used, only set with dynamic_parallelism
+  /// or for tiny transfers
+  std::unique_ptr<ParallelismController> parallelismController_;
+  /// Thread running adjustParallelism()
+  std::thread parallelismThread_;
+  /// Makes the first isTinyTransfer() call decide for the others
+  std::once_flag tinyTransferDecided_;
+  /// Whether the transfer is tiny, set once by isTinyTransfer()
+  bool tinyTransfer_{false};
+  /// Longest wait of the discovery to tell whether the transfer is tiny, a
+  /// longer discovery is not worth delaying the first connection
+  static const int64_t kTinyTransferWaitMillis = 200;
 
   /// Returns the protocol negotiation status of the parent sender
   ProtoNegotiationStatus getNegotiationStatus();
@@ -9,6 +9,8 @@
 #include <wdt/SenderThread.h>
 #include <wdt/Sender.h>
 #include <wdt/util/ClientSocket.h>
+#include <wdt/util/ConnectionPool.h>
+#include <wdt/util/Tracepoints.h>
 #include <folly/Conv.h>
 #include <folly/Memory.h>
 #include <folly/String.h>
@@ -41,13 +43,32 @@ std::unique_ptr<ClientSocket> SenderThread::connectToReceiver(
   std::unique_ptr<ClientSocket> socket;
   const EncryptionParams &encryptionData =
       wdtParent_->transferRequest_.encryptionData;
+  // single port receivers accept every connection on their first port and
+  // route them using the connection cmd, port is then only the key
+  const bool singlePort = wdtParent_->transferRequest_.singlePort;
+  const int connectPort =
+      singlePort ? wdtParent_->transferRequest_.ports[0] : port;
+  if (options_.reuse_connections && !singlePort &&
+      !wdtParent_->socketCreator_) {
+    std::string peerIp;
+    int fd = ConnectionPool::get().acquire(wdtParent_->destHost_, port, peerIp);
+    if (fd >= 0) {
+      socket = folly::make_unique<ClientSocket>(
+          *threadCtx_, wdtParent_->destHost_, port, encryptionData);
+      socket->adoptConnection(fd, peerIp);
+      LOG(INFO) << "Reusing pooled connection to " << wdtParent_->destHost_
+                << " port " << port;
+      errCode = OK;
+      return socket;
+    }
+  }
   if (!wdtParent_->socketCreator_) {
     // socket creator not set, creating ClientSocket
     socket = folly::make_unique<ClientSocket>(
-        *threadCtx_, wdtParent_->destHost_, port, encryptionData);
+        *threadCtx_, wdtParent_->destHost_, connectPort, encryptionData);
   } else {
     socket = wdtParent_->socketCreator_->makeSocket(
-        *threadCtx_, wdtParent_->destHost_, port, encryptionData);
+        *threadCtx_, wdtParent_->destHost_, connectPort, encryptionData);
   }
   double retryInterval = options_.sleep_millis;
   int maxRetries = options_.max_retries;
@@ -58,6 +79,12 @@ std::unique_ptr<ClientSocket> SenderThread::connectToReceiver(
   for (int i = 1; i <= maxRetries; ++i) {
     ++connectAttempts;
     errCode = socket->connect();
+    if (errCode == OK && singlePort) {
+      errCode = socket->writeConnectionCmd(port);
+      if (errCode != OK) {
+        socket->closeNoCheck();
+      }
+    }
     if (errCode == OK) {
       break;
     } else if (errCode == CONN_ERROR) {
@@ -106,6 +133,24 @@ SenderState SenderThread::connect() {
     threadStats_.setLocalErrorCode(NO_PROGRESS);
     return END;
   }
+  ParallelismController *parallelismController =
+      wdtParent_->parallelismController_.get();
+  if (parallelismController) {
+    if (threadProtocolVersion_ < Protocol::DYNAMIC_PARALLELISM_VERSION) {
+      // receiver would not wait for a connection opened later
+      parallelismController->activate(threadIndex_);
+    } else if (!parallelismController->waitForActivation(
+                   threadIndex_, threadCtx_->getAbortChecker())) {
+      if (getThreadAbortCode() == VERSION_MISMATCH) {
+        return PROCESS_VERSION_MISMATCH;
+      }
+      if (getThreadAbortCode() != OK) {
+        threadStats_.setLocalErrorCode(ABORT);
+      }
+      VLOG(1) << *this << " connection not needed by the transfer";
+      return END;
+    }
+  }
   ErrorCode code;
   // TODO cleanup more but for now avoid having 2 socket object live per port
   socket_ = nullptr;
@@ -121,6 +166,18 @@ SenderState SenderThread::connect() {
     threadStats_.setLocalErrorCode(code);
     return END;
   }
+  if (wdtParent_->isTinyTransfer()) {
+    // settings, size, small blocks and done leave in as few packets as
+    // possible, the socket uncorks once we wait for the receiver. Bigger
+    // transfers would only delay their first blocks
+    socket_->setCorked(true);
+  }
+  double pacingRate = 0;
+  if (options_.kernel_pacing && wdtParent_->getThrottler()) {
+    pacingRate = wdtParent_->getThrottler()->getAvgRateBytesPerSec() /
+                 wdtParent_->transferRequest_.ports.size();
+  }
+  socketTuner_.start(*socket_, threadStats_.getTotalBytes(), pacingRate);
   auto nextState = SEND_SETTINGS;
   if (threadStats_.getLocalErrorCode() != OK) {
     nextState = READ_LOCAL_CHECKPOINT;
@@ -168,6 +225,9 @@ SenderState SenderThread::readLocalCheckPoint() {
   const Checkpoint &checkpoint = checkpoints[0];
   auto numBlocks = checkpoint.numBlocks;
   VLOG(1) << "received local checkpoint " << checkpoint;
+  threadCtx_->traceInstant("Local checkpoint", numBlocks);
+  WDT_TRACEPOINT3(checkpoint__receive, checkpoint.port, numBlocks,
+                  checkpoint.lastBlockReceivedBytes);
 
   if (numBlocks == -1) {
     // Receiver failed while sending DONE cmd
@@ -201,6 +261,14 @@ SenderState SenderThread::sendSettings() {
   settings.enableChecksum = (footerType_ == CHECKSUM_FOOTER);
   settings.sendFileChunks = sendFileChunks;
   settings.blockModeDisabled = (options_.block_size_mbytes <= 0);
+  // sockets from a socket creator are not pooled
+  settings.keepConnection =
+      options_.reuse_connections && !wdtParent_->socketCreator_;
+  settings.dynamicParallelism =
+      (wdtParent_->parallelismController_ != nullptr);
+  keepConnectionRequested_ =
+      settings.keepConnection &&
+      threadProtocolVersion_ >= Protocol::CONNECTION_REUSE_VERSION;
   Protocol::encodeSettings(threadProtocolVersion_, buf_, off,
                            Protocol::kMaxSettings, settings);
   int64_t toWrite = sendFileChunks ? Protocol::kMinBufLength : off;
@@ -216,23 +284,63 @@ SenderState SenderThread::sendSettings() {
 
 SenderState SenderThread::sendBlocks() {
   VLOG(1) << *this << " entered SEND_BLOCKS state";
-  ThreadTransferHistory &transferHistory = getTransferHistory();
   if (threadProtocolVersion_ >= Protocol::RECEIVER_PROGRESS_REPORT_VERSION &&
       !totalSizeSent_ && dirQueue_->fileDiscoveryFinished()) {
     return SEND_SIZE_CMD;
   }
+  socketTuner_.onProgress(*socket_, threadStats_.getTotalBytes());
+  if (wdtParent_->parallelismController_ &&
+      wdtParent_->parallelismController_->isRetired(threadIndex_)) {
+    // other connections send the rest, blocks sent by this one are
+    // acknowledged by the receiver reply to the done cmd
+    return SEND_DONE_CMD;
+  }
   ErrorCode transferStatus;
-  std::unique_ptr<ByteSource> source =
-      dirQueue_->getNextSource(threadCtx_.get(), transferStatus);
+  std::unique_ptr<ByteSource> source;
+  {
+    TraceScope dequeueScope(*threadCtx_, "Dequeue");
+    source = dirQueue_->getNextSource(threadCtx_.get(), transferStatus);
+  }
   if (!source) {
     return SEND_DONE_CMD;
   }
   WDT_CHECK(!source->hasError());
-  TransferStats transferStats = sendOneByteSource(source, transferStatus);
+  WDT_TRACEPOINT4(queue__dequeue, source->getMetaData().seqId,
+                  source->getOffset(), source->getSize(), threadIndex_);
+  if (threadProtocolVersion_ >= Protocol::BATCH_CMD_VERSION &&
+      options_.max_blocks_per_batch > 1 &&
+      source->getSize() <= options_.max_batch_bytes) {
+    fillBatch(source);
+    if (batch_.size() > 1) {
+      return sendBatch(transferStatus);
+    }
+    // nothing to batch with
+    source = std::move(batch_.front());
+    batch_.clear();
+  }
+  const int64_t seqId = source->getMetaData().seqId;
+  TransferStats transferStats;
+  {
+    TraceScope sendScope(*threadCtx_, "Send block", seqId);
+    WDT_TRACEPOINT3(block__send__start, seqId, source->getOffset(),
+                    source->getSize());
+    transferStats = sendOneByteSource(source, transferStatus);
+    WDT_TRACEPOINT4(block__send__done, seqId, source->getOffset(),
+                    transferStats.getDataBytes(),
+                    (int)transferStats.getLocalErrorCode());
+  }
+  return addSourceToHistory(source, transferStats);
+}
+
+SenderState SenderThread::addSourceToHistory(
+    std::unique_ptr<ByteSource> &source, const TransferStats &transferStats) {
   threadStats_ += transferStats;
   source->addTransferStats(transferStats);
   source->close();
-  if (!transferHistory.addSource(source)) {
+  if (transferStats.getLocalErrorCode() == OK) {
+    dirQueue_->markSourceSent(*source);
+  }
+  if (!getTransferHistory().addSource(source)) {
     // global checkpoint received for this thread. no point in
     // continuing
     LOG(ERROR) << *this << " global checkpoint received. Stopping";
@@ -245,46 +353,145 @@ SenderState SenderThread::sendBlocks() {
   return SEND_BLOCKS;
 }
 
-TransferStats SenderThread::sendOneByteSource(
-    const std::unique_ptr<ByteSource> &source, ErrorCode transferStatus) {
-  TransferStats stats;
+void SenderThread::fillBatch(std::unique_ptr<ByteSource> &source) {
+  batch_.clear();
+  int64_t batchBytes = source->getSize();
+  int64_t headerBytes = 1 + 1 + sizeof(int16_t) +
+                        Protocol::kMaxBatchEntryOverhead +
+                        source->getMetaData().relPath.size();
+  batch_.emplace_back(std::move(source));
+  while ((int64_t)batch_.size() < options_.max_blocks_per_batch) {
+    std::unique_ptr<ByteSource> next = dirQueue_->tryGetNextSource(
+        threadCtx_.get(), options_.max_batch_bytes - batchBytes);
+    if (!next) {
+      break;
+    }
+    const int64_t entryBytes =
+        Protocol::kMaxBatchEntryOverhead + next->getMetaData().relPath.size();
+    if (headerBytes + entryBytes > Protocol::kMaxHeader) {
+      // header is full (long file names), keep it for the next round
+      next->close();
+      dirQueue_->returnToQueue(next);
+      break;
+    }
+    WDT_TRACEPOINT4(queue__dequeue, next->getMetaData().seqId,
+                    next->getOffset(), next->getSize(), threadIndex_);
+    batchBytes += next->getSize();
+    headerBytes += entryBytes;
+    batch_.emplace_back(std::move(next));
+  }
+}
+
+SenderState SenderThread::sendBatch(ErrorCode transferStatus) {
   char headerBuf[Protocol::kMaxHeader];
   int64_t off = 0;
-  headerBuf[off++] = Protocol::FILE_CMD;
+  headerBuf[off++] = Protocol::BATCH_CMD;
   headerBuf[off++] = transferStatus;
   char *headerLenPtr = headerBuf + off;
   off += sizeof(int16_t);
-  const int64_t expectedSize = source->getSize();
-  int64_t actualSize = 0;
-  const SourceMetaData &metadata = source->getMetaData();
   BlockDetails blockDetails;
+  for (const auto &source : batch_) {
+    setBlockDetails(*source, blockDetails);
+    Protocol::encodeHeader(threadProtocolVersion_, headerBuf, off,
+                           Protocol::kMaxHeader, blockDetails,
+                           &fileNameDictionary_);
+  }
+  int16_t littleEndianOff = folly::Endian::little((int16_t)off);
+  folly::storeUnaligned<int16_t>(headerLenPtr, littleEndianOff);
+  VLOG(2) << *this << " sending batch of " << batch_.size() << " blocks, "
+          << off << " header bytes";
+  int64_t written = socket_->write(headerBuf, off);
+  const bool headerSent = (written == off);
+  if (!headerSent) {
+    PLOG(ERROR) << "Write error/mismatch " << written << " " << off
+                << ". fd = " << socket_->getFd()
+                << ". port = " << socket_->getPort();
+  }
+  // the payloads follow back to back, in the order of the headers
+  SenderState nextState = SEND_BLOCKS;
+  for (size_t i = 0; i < batch_.size(); i++) {
+    std::unique_ptr<ByteSource> &source = batch_[i];
+    if (nextState != SEND_BLOCKS) {
+      // never sent, the receiver doesn't know about it
+      source->close();
+      dirQueue_->returnToQueue(source);
+      continue;
+    }
+    TransferStats transferStats;
+    if (!headerSent) {
+      transferStats.setLocalErrorCode(SOCKET_WRITE_ERROR);
+      transferStats.incrFailedAttempts();
+    } else {
+      // the batch header is accounted with the first block
+      const int64_t headerBytes = (i == 0) ? off : 0;
+      transferStats.addHeaderBytes(headerBytes);
+      const int64_t seqId = source->getMetaData().seqId;
+      TraceScope sendScope(*threadCtx_, "Send block", seqId);
+      WDT_TRACEPOINT3(block__send__start, seqId, source->getOffset(),
+                      source->getSize());
+      sendBlockData(source, headerBytes, transferStats);
+      WDT_TRACEPOINT4(block__send__done, seqId, source->getOffset(),
+                      transferStats.getDataBytes(),
+                      (int)transferStats.getLocalErrorCode());
+    }
+    nextState = addSourceToHistory(source, transferStats);
+  }
+  batch_.clear();
+  return nextState;
+}
+
+void SenderThread::setBlockDetails(const ByteSource &source,
+                                   BlockDetails &blockDetails) {
+  const SourceMetaData &metadata = source.getMetaData();
   blockDetails.fileName = metadata.relPath;
   blockDetails.seqId = metadata.seqId;
   blockDetails.fileSize = metadata.size;
-  blockDetails.offset = source->getOffset();
-  blockDetails.dataSize = expectedSize;
+  blockDetails.offset = source.getOffset();
+  blockDetails.dataSize = source.getSize();
   blockDetails.allocationStatus = metadata.allocationStatus;
   blockDetails.prevSeqId = metadata.prevSeqId;
-  Protocol::encodeHeader(wdtParent_->getProtocolVersion(), headerBuf, off,
-                         Protocol::kMaxHeader, blockDetails);
+}
+
+TransferStats SenderThread::sendOneByteSource(
+    const std::unique_ptr<ByteSource> &source, ErrorCode transferStatus) {
+  TransferStats stats;
+  char headerBuf[Protocol::kMaxHeader];
+  int64_t off = 0;
+  headerBuf[off++] = Protocol::FILE_CMD;
+  headerBuf[off++] = transferStatus;
+  char *headerLenPtr = headerBuf + off;
+  off += sizeof(int16_t);
+  BlockDetails blockDetails;
+  setBlockDetails(*source, blockDetails);
+  Protocol::encodeHeader(threadProtocolVersion_, headerBuf, off,
+                         Protocol::kMaxHeader, blockDetails,
+                         &fileNameDictionary_);
   int16_t littleEndianOff = folly::Endian::little((int16_t)off);
   folly::storeUnaligned<int16_t>(headerLenPtr, littleEndianOff);
   int64_t written = socket_->write(headerBuf, off);
   if (written != off) {
     PLOG(ERROR) << "Write error/mismatch " << written << " " << off
                 << ". fd = " << socket_->getFd()
-                << ". file = " << metadata.relPath
+                << ". file = " << blockDetails.fileName
                 << ". port = " << socket_->getPort();
     stats.setLocalErrorCode(SOCKET_WRITE_ERROR);
     stats.incrFailedAttempts();
     return stats;
   }
   stats.addHeaderBytes(written);
-  int64_t byteSourceHeaderBytes = written;
-  int64_t throttlerInstanceBytes = byteSourceHeaderBytes;
-  int64_t totalThrottlerBytes = 0;
   VLOG(3) << "Sent " << written << " on " << socket_->getFd() << " : "
           << folly::humanify(std::string(headerBuf, off));
+  sendBlockData(source, written, stats);
+  return stats;
+}
+
+void SenderThread::sendBlockData(const std::unique_ptr<ByteSource> &source,
+                                 int64_t headerBytes, TransferStats &stats) {
+  const int64_t expectedSize = source->getSize();
+  int64_t actualSize = 0;
+  const SourceMetaData &metadata = source->getMetaData();
+  int64_t throttlerInstanceBytes = headerBytes;
+  int64_t totalThrottlerBytes = 0;
   int32_t checksum = 0;
   while (!source->finished()) {
     int64_t size;
@@ -313,13 +520,13 @@ TransferStats SenderThread::sendOneByteSource(
       totalThrottlerBytes += throttlerInstanceBytes;
       throttlerInstanceBytes = 0;
     }
-    written = socket_->write(buffer, size, /* retry writes */ true);
+    int64_t written = socket_->write(buffer, size, /* retry writes */ true);
     if (getThreadAbortCode() != OK) {
       LOG(ERROR) << "Transfer aborted during block transfer "
                  << socket_->getPort() << " " << source->getIdentifier();
       stats.setLocalErrorCode(ABORT);
       stats.incrFailedAttempts();
-      return stats;
+      return;
     }
     if (written != size) {
       LOG(ERROR) << "Write error " << written << " (" << size << ")"
@@ -328,7 +535,7 @@ TransferStats SenderThread::sendOneByteSource(
                  << ". port = " << socket_->getPort();
       stats.setLocalErrorCode(SOCKET_WRITE_ERROR);
       stats.incrFailedAttempts();
-      return stats;
+      return;
     }
     stats.addDataBytes(written);
     actualSize += written;
@@ -347,10 +554,10 @@ TransferStats SenderThread::sendOneByteSource(
     }
     stats.setLocalErrorCode(BYTE_SOURCE_READ_ERROR);
     stats.incrFailedAttempts();
-    return stats;
+    return;
   }
   if (wdtParent_->getThrottler() && actualSize > 0) {
-    WDT_CHECK(totalThrottlerBytes == actualSize + byteSourceHeaderBytes)
+    WDT_CHECK(totalThrottlerBytes == actualSize + headerBytes)
         << totalThrottlerBytes << " " << (actualSize + totalThrottlerBytes);
   }
   if (footerType_ != NO_FOOTER) {
@@ -358,23 +565,23 @@ TransferStats SenderThread::sendOneByteSource(
     if (footerType_ == ENC_TAG_FOOTER) {
       tag = socket_->computeCurEncryptionTag();
     }
-    off = 0;
-    headerBuf[off++] = Protocol::FOOTER_CMD;
-    Protocol::encodeFooter(headerBuf, off, Protocol::kMaxFooter, checksum, tag);
+    char footerBuf[Protocol::kMaxFooter];
+    int64_t off = 0;
+    footerBuf[off++] = Protocol::FOOTER_CMD;
+    Protocol::encodeFooter(footerBuf, off, Protocol::kMaxFooter, checksum, tag);
     int toWrite = off;
-    written = socket_->write(headerBuf, toWrite);
+    int64_t written = socket_->write(footerBuf, toWrite);
     if (written != toWrite) {
       LOG(ERROR) << "Write mismatch " << written << " " << toWrite;
       stats.setLocalErrorCode(SOCKET_WRITE_ERROR);
       stats.incrFailedAttempts();
-      return stats;
+      return;
     }
     stats.addHeaderBytes(toWrite);
   }
   stats.setLocalErrorCode(OK);
   stats.incrNumBlocks();
   stats.addEffectiveBytes(stats.getHeaderBytes(), stats.getDataBytes());
-  return stats;
 }
 
 SenderState SenderThread::sendSizeCmd() {
@@ -682,19 +889,37 @@ SenderState SenderThread::processDoneCmd() {
   // DONE cmd implies that all the blocks sent till now is acked
   ThreadTransferHistory &transferHistory = getTransferHistory();
   transferHistory.markAllAcknowledged();
+  threadCtx_->traceInstant("Acked");
+
+  bool keepConnection = false;
+  if (keepConnectionRequested_) {
+    // receiver tells whether it keeps the connection open
+    if (socket_->read(buf_, 1) != 1) {
+      LOG(ERROR) << "Unable to read keep connection flag, port " << port_;
+      threadStats_.setLocalErrorCode(SOCKET_READ_ERROR);
+      return CONNECT;
+    }
+    keepConnection = buf_[0];
+  }
 
   // send ack for DONE
   buf_[0] = Protocol::DONE_CMD;
   socket_->write(buf_, 1);
 
-  socket_->shutdownWrites();
-  ErrorCode retCode = socket_->expectEndOfStream();
+  ErrorCode retCode;
+  if (keepConnection) {
+    retCode = socket_->finishSession();
+  } else {
+    socket_->shutdownWrites();
+    retCode = socket_->expectEndOfStream();
+  }
   if (retCode != OK) {
     LOG(WARNING) << "Logical EOF not found when expected "
                  << errorCodeToStr(retCode);
     threadStats_.setLocalErrorCode(retCode);
     return CONNECT;
   }
+  connectionKept_ = keepConnection;
   VLOG(1) << "done with transfer, port " << port_;
   return END;
 }
@@ -704,6 +929,7 @@ SenderState SenderThread::processWaitCmd() {
   // similar to DONE, WAIT also verifies all the blocks
   ThreadTransferHistory &transferHistory = getTransferHistory();
   transferHistory.markAllAcknowledged();
+  threadCtx_->traceInstant("Acked");
   VLOG(1) << "received WAIT_CMD, port " << port_;
   return READ_RECEIVER_CMD;
 }
@@ -713,6 +939,7 @@ SenderState SenderThread::processErrCmd() {
   // similar to DONE, global checkpoint cmd also verifies all the blocks
   ThreadTransferHistory &transferHistory = getTransferHistory();
   transferHistory.markAllAcknowledged();
+  threadCtx_->traceInstant("Acked");
   int64_t toRead = sizeof(int16_t);
   int64_t numRead = socket_->read(buf_, toRead);
   if (numRead != toRead) {
@@ -742,6 +969,8 @@ SenderState SenderThread::processErrCmd() {
   }
   for (auto &checkpoint : checkpoints) {
     LOG(INFO) << *this << " Received global checkpoint " << checkpoint;
+    WDT_TRACEPOINT2(global__checkpoint__receive, checkpoint.port,
+                    checkpoint.numBlocks);
     transferHistoryController_->handleGlobalCheckpoint(checkpoint);
   }
   return SEND_BLOCKS;
@@ -889,6 +1118,7 @@ void SenderThread::start() {
 
   setFooterType();
 
+  threadCtx_->getActivityTracker().start(&threadStats_);
   controller_->executeAtStart([&]() { wdtParent_->startNewTransfer(); });
   SenderState state = CONNECT;
 
@@ -905,6 +1135,7 @@ void SenderThread::start() {
     }
     state = (this->*stateMap_[state])();
   }
+  threadCtx_->getActivityTracker().stop();
 
   EncryptionType encryptionType =
       (socket_ ? socket_->getEncryptionType() : ENC_NONE);
@@ -917,8 +1148,16 @@ void SenderThread::start() {
 
   ThreadTransferHistory &transferHistory = getTransferHistory();
   transferHistory.markNotInUse();
+  if (wdtParent_->parallelismController_) {
+    wdtParent_->parallelismController_->markEnded(threadIndex_);
+  }
   controller_->deRegisterThread(threadIndex_);
   controller_->executeAtEnd([&]() { wdtParent_->endCurTransfer(); });
+  if (connectionKept_) {
+    ConnectionPool::get().release(wdtParent_->destHost_, port_,
+                                  socket_->getPeerIp(),
+                                  socket_->releaseConnection());
+  }
   // Important to delete the socket before the thread dies for sub class
   // of clientsocket which have thread local data
   socket_ = nullptr;
@@ -940,6 +1179,8 @@ ErrorCode SenderThread::init() {
 
 void SenderThread::reset() {
   totalSizeSent_ = false;
+  keepConnectionRequested_ = connectionKept_ = false;
+  fileNameDictionary_.reset();
   threadStats_.setLocalErrorCode(OK);
 }
 
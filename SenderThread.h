@@ -11,6 +11,7 @@
 #include <wdt/WdtThread.h>
 #include <wdt/Sender.h>
 #include <wdt/util/ClientSocket.h>
+#include <wdt/util/SocketTuner.h>
 #include <wdt/util/ThreadTransferHistory.h>
 
 namespace facebook {
@@ -78,7 +79,8 @@ class SenderThread : public WdtThread {
                   sender->getProtocolVersion(), threadsController),
         wdtParent_(sender),
         dirQueue_(sender->dirQueue_.get()),
-        transferHistoryController_(sender->transferHistoryController_.get()) {
+        transferHistoryController_(sender->transferHistoryController_.get()),
+        socketTuner_(sender->options_, /* sender */ true) {
     controller_->registerThread(threadIndex_);
     transferHistoryController_->addThreadHistory(port_, threadStats_);
     threadAbortChecker_ = folly::make_unique<SocketAbortChecker>(this);
@@ -276,6 +278,43 @@ class SenderThread : public WdtThread {
   TransferStats sendOneByteSource(const std::unique_ptr<ByteSource> &source,
                                   ErrorCode transferStatus);
 
+  /**
+   * Sends the data and footer of a block whose header has already been sent
+   *
+   * @param source        source to send
+   * @param headerBytes   header bytes sent for this block, they are throttled
+   *                      along with the first data buffer
+   * @param stats         stats of the block, updated
+   */
+  void sendBlockData(const std::unique_ptr<ByteSource> &source,
+                     int64_t headerBytes, TransferStats &stats);
+
+  /**
+   * Moves source into batch_ and adds following small enough sources, without
+   * waiting for the queue
+   */
+  void fillBatch(std::unique_ptr<ByteSource> &source);
+
+  /**
+   * Sends all the headers of batch_ in one BATCH_CMD, followed by the data of
+   * each block. Blocks not sent because of an error are returned to the queue
+   *
+   * @return    next state, same as sendBlocks
+   */
+  SenderState sendBatch(ErrorCode transferStatus);
+
+  /**
+   * Updates stats and adds a source, sent or failed, to the transfer history
+   *
+   * @return    next state, same as sendBlocks
+   */
+  SenderState addSourceToHistory(std::unique_ptr<ByteSource> &source,
+                                 const TransferStats &transferStats);
+
+  /// sets the block details describing source
+  static void setBlockDetails(const ByteSource &source,
+                              BlockDetails &blockDetails);
+
   /// mapping from sender states to state functions
   static const StateFunction stateMap_[];
 
@@ -290,6 +329,20 @@ class SenderThread : public WdtThread {
   /// whether total file size has been sent to the receiver
   bool totalSizeSent_{false};
 
+  /// whether we asked the receiver to keep the connection open at the end of
+  /// the transfer
+  bool keepConnectionRequested_{false};
+
+  /// whether the connection was kept open, it is returned to the connection
+  /// pool when the thread finishes
+  bool connectionKept_{false};
+
+  /// file names already sent on the current connection
+  FileNameDictionary fileNameDictionary_;
+
+  /// sources of the batch being sent
+  std::vector<std::unique_ptr<ByteSource>> batch_;
+
   /// number of consecutive reconnects without any progress
   int numReconnectWithoutProgress_{0};
 
@@ -301,6 +354,9 @@ class SenderThread : public WdtThread {
 
   /// Thread history controller shared across all threads
   TransferHistoryController *transferHistoryController_;
+
+  /// tunes the buffers and pacing of the current connection
+  SocketTuner socketTuner_;
 };
 }
 }
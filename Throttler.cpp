@@ -9,6 +9,7 @@
 #include <wdt/Throttler.h>
 #include <wdt/ErrorCodes.h>
 #include <wdt/WdtOptions.h>
+#include <wdt/util/Tracepoints.h>
 #include <cmath>
 
 namespace facebook {
@@ -121,6 +122,9 @@ void Throttler::limit(ThreadCtx& threadCtx, double deltaProgress) {
     printPeriodicLogs(now, deltaProgress);
   }
   if (sleepTimeSeconds > 0) {
+    WDT_TRACEPOINT2(throttler__sleep,
+                    (int64_t)(sleepTimeSeconds * kMicroToSec),
+                    (int64_t)deltaProgress);
     /* sleep override */
     PerfStatCollector statCollector(threadCtx, PerfStatReport::THROTTLER_SLEEP);
     std::this_thread::sleep_for(
@@ -8,6 +8,9 @@
  */
 #include <wdt/WdtBase.h>
 #include <wdt/WdtTransferRequest.h>
+#include <wdt/util/JsonWriter.h>
+#include <folly/Conv.h>
+#include <fstream>
 #include <random>
 using namespace std;
 
@@ -77,6 +80,96 @@ std::shared_ptr<Throttler> WdtBase::getThrottler() const {
   return throttler_;
 }
 
+void WdtBase::writeTrace(
+    const std::vector<std::unique_ptr<WdtThread>>& threads,
+    const std::string& role) {
+  if (options_.trace_file_prefix.empty()) {
+    return;
+  }
+  std::vector<const TraceBuffer*> buffers;
+  for (const auto& thread : threads) {
+    buffers.push_back(thread->getTraceBuffer());
+  }
+  const std::string transferId = getTransferId();
+  writeChromeTrace(
+      folly::to<std::string>(options_.trace_file_prefix, role, "_", transferId,
+                             ".json"),
+      folly::to<std::string>("wdt ", role, " ", transferId), buffers);
+}
+
+void WdtBase::recordThroughputSample(const TransferReport& report) {
+  const TransferStats& summary = report.getSummary();
+  ThroughputSample sample;
+  sample.elapsedSeconds = report.getTotalTime();
+  sample.totalBytes = summary.getTotalBytes();
+  sample.effectiveBytes = summary.getEffectiveTotalBytes();
+  sample.activeThreads =
+      threadsController_ ? threadsController_->getNumThreads(RUNNING) : 0;
+  sample.failedAttempts = summary.getFailedAttempts();
+  sample.throttledMicros = summary.getActivityTimes()[ACT_THROTTLED];
+  throughputSeries_.addSample(sample);
+}
+
+std::string WdtBase::getReportJson(const TransferReport& report,
+                                   const std::string& role) {
+  JsonWriter json;
+  json.beginObject()
+      .key("version")
+      .value(kReportJsonVersion)
+      .key("role")
+      .value(role)
+      .key("transfer_id")
+      .value(getTransferId())
+      .key("protocol_version")
+      .value(getProtocolVersion());
+  json.key("throttler");
+  std::shared_ptr<Throttler> throttler = getThrottler();
+  if (throttler) {
+    json.beginObject()
+        .key("avg_rate_bytes_per_sec")
+        .value(throttler->getAvgRateBytesPerSec())
+        .key("peak_rate_bytes_per_sec")
+        .value(throttler->getPeakRateBytesPerSec())
+        .key("bucket_limit_bytes")
+        .value(throttler->getBucketLimitBytes())
+        .endObject();
+  } else {
+    json.nullValue();
+  }
+  json.key("report");
+  report.writeJson(json);
+  json.endObject();
+  return json.str();
+}
+
+void WdtBase::writeReportJson(const TransferReport& report,
+                              const std::string& role) {
+  const std::string& fileName = options_.report_json_file;
+  if (fileName.empty()) {
+    return;
+  }
+  std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc);
+  if (!out) {
+    PLOG(ERROR) << "Unable to open report file " << fileName;
+    return;
+  }
+  out << getReportJson(report, role) << std::endl;
+  out.close();
+  if (!out) {
+    PLOG(ERROR) << "Failed writing report file " << fileName;
+    return;
+  }
+  LOG(INFO) << "Wrote " << role << " report to " << fileName;
+}
+
+void WdtBase::exportMetrics(OpenMetricsSerializer& serializer,
+                            const MetricLabels& labels) {
+  std::shared_ptr<Throttler> throttler = getThrottler();
+  if (throttler) {
+    serializer.addThrottler(*throttler, labels);
+  }
+}
+
 void WdtBase::setTransferId(const std::string& transferId) {
   transferRequest_.transferId = transferId;
   LOG(INFO) << "Setting transfer id " << transferId;
@@ -147,7 +240,8 @@ void WdtBase::setTransferStatus(TransferStatus transferStatus) {
   std::lock_guard<std::mutex> lock(mutex_);
   transferStatus_ = transferStatus;
   if (transferStatus_ == THREADS_JOINED) {
-    conditionFinished_.notify_one();
+    // progress reporter and other periodic threads wait on it
+    conditionFinished_.notify_all();
   }
 }
 
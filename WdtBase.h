@@ -17,6 +17,7 @@
 #include <wdt/WdtThread.h>
 #include <wdt/util/DirectorySourceQueue.h>
 #include <wdt/util/EncryptionUtils.h>
+#include <wdt/util/OpenMetricsSerializer.h>
 #include <wdt/util/ThreadsController.h>
 #include <memory>
 #include <string>
@@ -113,6 +114,29 @@ class WdtBase {
   /// Get the throttler
   std::shared_ptr<Throttler> getThrottler() const;
 
+  /**
+   * Adds the live metrics of this object to the serializer. Safe to call from
+   * any thread at any point of the object's life (for instance from a metrics
+   * scraping thread), the base version only exports the throttler
+   *
+   * @param serializer    serializer to add the metrics to
+   * @param labels        labels identifying this object, added to every sample
+   */
+  virtual void exportMetrics(OpenMetricsSerializer& serializer,
+                             const MetricLabels& labels);
+
+  /**
+   * Serializes a transfer report as versioned JSON, along with the settings
+   * needed to interpret it (role, transfer id, protocol, throttler)
+   *
+   * @param report    report to serialize
+   * @param role      "sender" or "receiver"
+   *
+   * @return          JSON document, see kReportJsonVersion
+   */
+  std::string getReportJson(const TransferReport& report,
+                            const std::string& role);
+
   /// @param      whether the object is stale. If all the transferring threads
   ///             have finished, the object will marked as stale
   bool isStale();
@@ -151,6 +175,24 @@ class WdtBase {
   /// @param transferStatus   current transfer status
   void setTransferStatus(TransferStatus transferStatus);
 
+  /**
+   * Writes the timeline events of the threads as a Chrome trace if tracing is
+   * enabled. Must be called after the threads have been joined.
+   *
+   * @param threads   transfer threads
+   * @param role      "sender" or "receiver", used in the file name
+   */
+  void writeTrace(const std::vector<std::unique_ptr<WdtThread>>& threads,
+                  const std::string& role);
+
+  /// Adds a sample of the current progress report to the throughput series,
+  /// called by the progress reporting thread
+  void recordThroughputSample(const TransferReport& report);
+
+  /// Writes the final report as JSON to report_json_file if that option is
+  /// set. Errors are logged, they do not affect the transfer status
+  void writeReportJson(const TransferReport& report, const std::string& role);
+
   /// Input/output transfer request
   WdtTransferRequest transferRequest_;
 
@@ -187,6 +229,9 @@ class WdtBase {
   /// Options/config used by this object
   WdtOptions options_;
 
+  /// Throughput time series, reset at start and moved to the final report
+  ThroughputSeries throughputSeries_;
+
  private:
   folly::RWSpinLock abortCodeLock_;
   /// Internal and default abort code
@@ -10,10 +10,10 @@
 #include <fcntl.h>
 
 #define WDT_VERSION_MAJOR 1
-#define WDT_VERSION_MINOR 26
+#define WDT_VERSION_MINOR 31
 #define WDT_VERSION_BUILD 1602171
 // Add -fbcode to version str
-#define WDT_VERSION_STR "1.26.1602171-fbcode"
+#define WDT_VERSION_STR "1.31.1602171-fbcode"
 // Tie minor and proto version
 #define WDT_PROTOCOL_VERSION WDT_VERSION_MINOR
 
@@ -24,4 +24,5 @@
 
 #define WDT_SUPPORTS_ODIRECT 1
 #define WDT_HAS_SOCKIOS_H 1
+#define WDT_HAS_SDT_H 1
 // Again do not add new defines here without editing WdtConfig.h.in ...
@@ -187,6 +187,18 @@ class WdtOptions {
    */
   double block_size_mbytes{16};
 
+  /**
+   * Max number of blocks announced together by a single batch header, their
+   * payloads are then sent back to back. <= 1 disables batching
+   */
+  int32_t max_blocks_per_batch{32};
+
+  /**
+   * Only blocks fitting in a batch of at most this many bytes of data are
+   * batched, bigger blocks are sent with their own header
+   */
+  int64_t max_batch_bytes{1024 * 1024};
+
   /**
    * timeout in accept call at the server
    */
@@ -220,6 +232,62 @@ class WdtOptions {
    */
   int32_t connect_timeout_millis{1000};
 
+  /**
+   * If true, connections to a long running receiver are kept open at the end
+   * of a transfer and reused by the next transfer to the same host and port.
+   * Not used with a custom socket creator
+   */
+  bool reuse_connections{false};
+
+  /**
+   * If true, receiver listens on a single port and accepts all the
+   * connections of a transfer on it. num_ports is still the number of
+   * connections/threads
+   */
+  bool single_port{false};
+
+  /**
+   * If true, sender starts with a single connection and opens more of the
+   * num_ports connections while the aggregate throughput keeps improving.
+   * Connections which stop helping are retired once file discovery is over
+   */
+  bool dynamic_parallelism{false};
+
+  /**
+   * Interval in ms between throughput measurements of dynamic_parallelism
+   */
+  int parallelism_adjust_interval_millis{1000};
+
+  /**
+   * Minimum relative gain in aggregate throughput for dynamic_parallelism to
+   * keep a newly opened connection
+   */
+  double parallelism_min_gain{0.05};
+
+  /**
+   * Transfers of at most tiny_transfer_max_files files and
+   * tiny_transfer_max_bytes bytes use a single connection, whose writes are
+   * coalesced until the receiver replies. 0 disables it
+   */
+  int64_t tiny_transfer_max_bytes{256 * 1024};
+
+  /// @see tiny_transfer_max_bytes
+  int64_t tiny_transfer_max_files{32};
+
+  /**
+   * Memory in MB for the blocks read once and shared by all the destinations
+   * of a MultiSender. A destination lagging by more than that reads its
+   * blocks again instead of stalling the others
+   */
+  int64_t shared_read_buffer_mbytes{256};
+
+  /**
+   * Directory where the data of streams (@see Sender::addStream) is spooled
+   * as it is produced, so that blocks can be sent again after an error. The
+   * spool files are unlinked right away
+   */
+  std::string stream_spool_dir{"/tmp"};
+
   /**
    * interval in ms between abort checks
    */
@@ -236,6 +304,12 @@ class WdtOptions {
    */
   int throughput_update_interval_millis{500};
 
+  /**
+   * Max number of throughput samples (one per progress report interval) kept
+   * in the transfer report, oldest are dropped first. 0 disables the series
+   */
+  int throughput_series_size{3600};
+
   /**
    * Flag for turning on/off checksum. Redundant gcm in ENC_AES128_GCM.
    */
@@ -246,6 +320,25 @@ class WdtOptions {
    */
   bool enable_perf_stat_collection{false};
 
+  /**
+   * If not empty, per block timeline events are recorded and written at the
+   * end of the transfer as a Chrome trace to
+   * <prefix><sender|receiver>_<transfer id>.json
+   */
+  std::string trace_file_prefix{""};
+
+  /**
+   * Number of timeline events kept per thread when tracing, oldest events are
+   * dropped first
+   */
+  int trace_buffer_events{65536};
+
+  /**
+   * If not empty, the final transfer report (including the perf stats when
+   * collected) is written to this file as versioned JSON
+   */
+  std::string report_json_file{""};
+
   /**
    * Interval in milliseconds after which transfer log is written to disk
    */
@@ -339,6 +432,30 @@ class WdtOptions {
    */
   int receive_buffer_size{0};
 
+  /**
+   * If true, the socket buffers of every connection grow to twice the
+   * measured bandwidth-delay product (throughput and rtt from TCP_INFO)
+   */
+  bool auto_tune_buffers{false};
+
+  /**
+   * Interval in ms between measurements of auto_tune_buffers
+   */
+  int auto_tune_interval_millis{500};
+
+  /**
+   * Max socket buffer size set by auto_tune_buffers, the kernel limits
+   * (net.core.wmem_max/rmem_max) apply as well
+   */
+  int auto_tune_max_buffer_size{64 * 1024 * 1024};
+
+  /**
+   * If true and a throttler is set, the sender connections are also paced by
+   * the kernel (SO_MAX_PACING_RATE) at their share of the average rate, which
+   * mostly avoids the bursts and sleeps of the throttler
+   */
+  bool kernel_pacing{false};
+
   /**
    * If true, extra files on the receiver side is deleted during resumption
    */
@@ -264,6 +264,38 @@ vector<ReceiverPtr> WdtNamespaceController::getReceivers() const {
   return receivers;
 }
 
+void WdtNamespaceController::exportMetrics(
+    OpenMetricsSerializer &serializer) const {
+  vector<pair<string, SenderPtr>> senders;
+  vector<pair<string, ReceiverPtr>> receivers;
+  {
+    GuardLock lock(controllerMutex_);
+    senders.assign(sendersMap_.begin(), sendersMap_.end());
+    receivers.assign(receiversMap_.begin(), receiversMap_.end());
+  }
+  const MetricLabels labels = {{"namespace", controllerName_}};
+  serializer.addSample("wdt_senders", OpenMetricsSerializer::GAUGE,
+                       "Senders registered in the namespace", labels,
+                       senders.size());
+  serializer.addSample("wdt_receivers", OpenMetricsSerializer::GAUGE,
+                       "Receivers registered in the namespace", labels,
+                       receivers.size());
+  // objects are exported without holding the lock, the shared pointers keep
+  // them alive even if they get released meanwhile
+  for (const auto &senderPair : senders) {
+    MetricLabels senderLabels = labels;
+    senderLabels.emplace_back("role", "sender");
+    senderLabels.emplace_back("id", senderPair.first);
+    senderPair.second->exportMetrics(serializer, senderLabels);
+  }
+  for (const auto &receiverPair : receivers) {
+    MetricLabels receiverLabels = labels;
+    receiverLabels.emplace_back("role", "receiver");
+    receiverLabels.emplace_back("id", receiverPair.first);
+    receiverPair.second->exportMetrics(serializer, receiverLabels);
+  }
+}
+
 WdtNamespaceController::~WdtNamespaceController() {
   // release is done by parent shutdown
 }
@@ -312,6 +344,26 @@ ErrorCode WdtResourceController::getCounts(int32_t &numNamespaces,
   return OK;
 }
 
+void WdtResourceController::exportMetrics(
+    OpenMetricsSerializer &serializer) const {
+  vector<NamespaceControllerPtr> controllers;
+  {
+    GuardLock lock(controllerMutex_);
+    for (const auto &namespacePair : namespaceMap_) {
+      controllers.push_back(namespacePair.second);
+    }
+  }
+  for (const auto &controller : controllers) {
+    controller->exportMetrics(serializer);
+  }
+}
+
+string WdtResourceController::getMetrics() const {
+  OpenMetricsSerializer serializer;
+  exportMetrics(serializer);
+  return serializer.serialize();
+}
+
 ErrorCode WdtResourceController::createSender(
     const std::string &wdtNamespace, const std::string &identifier,
     const WdtTransferRequest &wdtOperationRequest, SenderPtr &sender) {
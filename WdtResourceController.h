@@ -122,6 +122,12 @@ class WdtNamespaceController : public WdtControllerBase {
   /// Clear the receivers that are not active anymore
   std::vector<std::string> releaseStaleReceivers();
 
+  /**
+   * Adds the number of senders/receivers of this namespace and the metrics of
+   * each of them (labeled by namespace, role and identifier) to the serializer
+   */
+  void exportMetrics(OpenMetricsSerializer &serializer) const;
+
   /// Destructor, clears the senders and receivers
   virtual ~WdtNamespaceController() override;
 
@@ -233,6 +239,15 @@ class WdtResourceController : public WdtControllerBase {
   ErrorCode getCounts(int32_t &numNamespaces, int32_t &numSenders,
                       int32_t &numReceivers);
 
+  /// Adds the metrics of every namespace to the serializer
+  void exportMetrics(OpenMetricsSerializer &serializer) const;
+
+  /**
+   * Snapshot of the live metrics of all the senders and receivers, in the
+   * OpenMetrics text format, ready to be served to a Prometheus scraper
+   */
+  std::string getMetrics() const;
+
  protected:
   typedef std::shared_ptr<WdtNamespaceController> NamespaceControllerPtr;
   /// Get the namespace controller
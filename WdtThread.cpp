@@ -21,6 +21,10 @@ const PerfStatReport &WdtThread::getPerfReport() const {
   return threadCtx_->getPerfReport();
 }
 
+const TraceBuffer *WdtThread::getTraceBuffer() const {
+  return threadCtx_->getTraceBuffer();
+}
+
 const TransferStats &WdtThread::getTransferStats() const {
   return threadStats_;
 }
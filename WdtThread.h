@@ -45,6 +45,9 @@ class WdtThread {
   /// Get the perf stats of the transfer for this thread
   const PerfStatReport &getPerfReport() const;
 
+  /// Get the timeline events of this thread, nullptr if tracing is disabled
+  const TraceBuffer *getTraceBuffer() const;
+
   /// Initializes the wdt thread before starting
   virtual ErrorCode init() = 0;
 
@@ -205,6 +205,7 @@ const string WdtTransferRequest::DIRECTORY_PARAM{"dir"};
 const string WdtTransferRequest::PORTS_PARAM{"ports"};
 const string WdtTransferRequest::START_PORT_PARAM{"start_port"};
 const string WdtTransferRequest::NUM_PORTS_PARAM{"num_ports"};
+const string WdtTransferRequest::SINGLE_PORT_PARAM{"single_port"};
 const string WdtTransferRequest::ENCRYPTION_PARAM{"enc"};
 
 WdtTransferRequest::WdtTransferRequest(int startPort, int numPorts,
@@ -247,6 +248,7 @@ WdtTransferRequest::WdtTransferRequest(const string& uriString) {
       errorCode = URI_PARSE_ERROR;
     }
   }
+  singlePort = (wdtUri.getQueryParam(SINGLE_PORT_PARAM) == "1");
   string portsStr(wdtUri.getQueryParam(PORTS_PARAM));
   StringPiece portsList(portsStr);  // pointers into portsStr
   do {
@@ -322,6 +324,9 @@ string WdtTransferRequest::generateUrlInternal(bool genFull,
   wdtUri.setQueryParam(RECEIVER_PROTOCOL_VERSION_PARAM,
                        folly::to<string>(protocolVersion));
   serializePorts(wdtUri);
+  if (singlePort) {
+    wdtUri.setQueryParam(SINGLE_PORT_PARAM, "1");
+  }
   if (genFull) {
     wdtUri.setQueryParam(DIRECTORY_PARAM, directory);
   }
@@ -377,6 +382,7 @@ bool WdtTransferRequest::operator==(const WdtTransferRequest& that) const {
   result &= (directory == that.directory);
   result &= (hostName == that.hostName);
   result &= (ports == that.ports);
+  result &= (singlePort == that.singlePort);
   result &= (encryptionData == that.encryptionData);
   // No need to check the file info, simply checking whether two objects
   // are same with respect to the wdt settings
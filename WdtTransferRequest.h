@@ -35,6 +35,13 @@ struct WdtFileInfo {
   /// Whether read should be done using o_direct. If fd is set, this flag will
   /// be set automatically to match the fd open mode
   bool directReads{false};
+  /// Files of higher priority are sent first
+  int32_t priority{0};
+  /// The file should be sent within this many milliseconds of the start of
+  /// the transfer, the report tells whether it was. Files with a deadline are
+  /// sent before the others of the same priority, earliest deadline first.
+  /// 0 for none
+  int64_t deadlineMillis{0};
   /// Constructor for file info with name, size and odirect request
   WdtFileInfo(const std::string& name, int64_t size, bool directReads);
   /**
@@ -153,6 +160,10 @@ struct WdtTransferRequest {
   /// Address on which receiver binded the ports / sender is sending data to
   std::string hostName;
 
+  /// If true, the receiver only listens on the first port and the ports are
+  /// the keys of the connections, @see WdtOptions::single_port
+  bool singlePort{false};
+
   /// Directory to write the data to / read the data from
   std::string directory;
 
@@ -205,6 +216,7 @@ struct WdtTransferRequest {
   const static std::string PORTS_PARAM;
   const static std::string START_PORT_PARAM;
   const static std::string NUM_PORTS_PARAM;
+  const static std::string SINGLE_PORT_PARAM;
   /// Encryption parameters (proto:key for now, certificate,... potentially)
   const static std::string ENCRYPTION_PARAM;
 
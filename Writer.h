@@ -10,8 +10,14 @@
 
 #include <wdt/ErrorCodes.h>
 
+#include <memory>
+
 namespace facebook {
 namespace wdt {
+
+struct BlockDetails;
+class ThreadCtx;
+
 /**
  * Interface to write received data
  */
@@ -43,5 +49,44 @@ class Writer {
   /// close the writer
   virtual void close() = 0;
 };
+
+/**
+ * Creates the writers of the received blocks, to receive into an application
+ * sink instead of files (@see Receiver::setWriterFactory). Blocks of the same
+ * file are written concurrently by several threads, each at its own offset.
+ * A block interrupted by a connection error is retried from the checkpoint
+ * offset: the bytes already written (lastBlockReceivedBytes of the
+ * checkpoint) are reported verified, and the retried block starts right
+ * after them. With checksums or encryption, which verify whole blocks, a
+ * block is instead written again from its start.
+ */
+class WriterFactory {
+ public:
+  virtual ~WriterFactory() {
+  }
+
+  /**
+   * Makes the writer of a block, called by the receiving thread
+   *
+   * @param threadCtx       context of the thread
+   * @param blockDetails    file name, file size, offset and size of the
+   *                        block, valid as long as the writer
+   *
+   * @return                writer of the block, opened by the caller
+   */
+  virtual std::unique_ptr<Writer> makeWriter(
+      ThreadCtx &threadCtx, const BlockDetails &blockDetails) = 0;
+
+  /**
+   * Called once a written block is verified (checksum or encryption tag),
+   * the block will not be written again. Also called with the part of an
+   * interrupted block kept by the checkpoint, its size is then the number of
+   * bytes written
+   *
+   * @param blockDetails    details of the block, or of its written part
+   */
+  virtual void onBlockVerified(const BlockDetails &blockDetails) {
+  }
+};
 }
 }
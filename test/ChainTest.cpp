@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include "FlakySocketCreator.h"
+#include "TestCommon.h"
+
+#include <wdt/Receiver.h>
+#include <wdt/Sender.h>
+#include <wdt/util/WdtFlags.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+namespace facebook {
+namespace wdt {
+
+static std::string readFile(const std::string &path) {
+  std::ifstream fin(path);
+  std::stringstream content;
+  content << fin.rdbuf();
+  return content.str();
+}
+
+/// sender -> first receiver forwarding -> last receiver
+class ChainTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto &opts = WdtOptions::getMutable();
+    opts.enable_download_resumption = false;
+    // checkpoints resume blocks only without footers
+    opts.encryption_type = "none";
+    opts.enable_checksum = false;
+    opts.num_ports = 1;
+    char dirTemplate[] = "/tmp/wdtChainXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    rootDir_ = dirTemplate;
+    srcDir_ = rootDir_ + "/src/";
+    ASSERT_EQ(0, mkdir(srcDir_.c_str(), 0755));
+  }
+
+  void TearDown() override {
+    const std::string cmd = "rm -rf " + rootDir_;
+    EXPECT_EQ(0, system(cmd.c_str()));
+    auto &opts = WdtOptions::getMutable();
+    opts.avg_mbytes_per_sec = -1;
+    opts.max_mbytes_per_sec = 0;
+  }
+
+  void makeFile(const std::string &fileName, int64_t size) {
+    std::string content;
+    for (int64_t i = 0; i < size; i++) {
+      content.push_back('a' + rand32() % 26);
+    }
+    std::ofstream(srcDir_ + fileName) << content;
+  }
+
+  void transfer(Sender::ISocketCreator *socketCreator) {
+    WdtTransferRequest lastReq(/* start port */ 0, /* num ports */ 1,
+                               rootDir_ + "/last");
+    Receiver last(lastReq);
+    lastReq = last.init();
+    ASSERT_EQ(OK, lastReq.errorCode);
+    ASSERT_EQ(OK, last.transferAsync());
+    WdtTransferRequest firstReq(/* start port */ 0, /* num ports */ 1,
+                                rootDir_ + "/first");
+    Receiver first(firstReq);
+    first.setDownstreamRequest(lastReq);
+    firstReq = first.init();
+    ASSERT_EQ(OK, firstReq.errorCode);
+    ASSERT_EQ(OK, first.transferAsync());
+    firstReq.directory = srcDir_;
+    Sender sender(firstReq);
+    if (socketCreator) {
+      sender.setSocketCreator(socketCreator);
+    }
+    EXPECT_EQ(OK, sender.transfer()->getSummary().getErrorCode());
+    EXPECT_EQ(OK, first.finish()->getSummary().getErrorCode());
+    EXPECT_EQ(OK, last.finish()->getSummary().getErrorCode());
+  }
+
+  void expectReceived(const std::string &fileName) {
+    const std::string content = readFile(srcDir_ + fileName);
+    EXPECT_TRUE(content == readFile(rootDir_ + "/first/" + fileName))
+        << fileName;
+    EXPECT_TRUE(content == readFile(rootDir_ + "/last/" + fileName))
+        << fileName;
+  }
+
+  std::string rootDir_;
+  std::string srcDir_;
+};
+
+TEST_F(ChainTest, ForwardsAllBlocks) {
+  WdtOptions::getMutable().block_size_mbytes = 1;
+  makeFile("a", 3 * 1024 * 1024 + 100);
+  makeFile("b", 1000);
+  transfer(nullptr);
+  expectReceived("a");
+  expectReceived("b");
+}
+
+TEST_F(ChainTest, ForwardsCheckpointedPartOfABlock) {
+  auto &opts = WdtOptions::getMutable();
+  opts.block_size_mbytes = 16;
+  // the connection breaks half way through the only block
+  opts.avg_mbytes_per_sec = 2;
+  opts.max_mbytes_per_sec = 2;
+  makeFile("a", 2 * 1024 * 1024);
+  FlakySocketCreator socketCreator;
+  transfer(&socketCreator);
+  EXPECT_TRUE(socketCreator.broken_);
+  // the resumed block only carries the bytes after the checkpoint, the first
+  // ones are forwarded from the interrupted one
+  expectReceived("a");
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  facebook::wdt::WdtFlags::initializeFromFlags();
+  return RUN_ALL_TESTS();
+}
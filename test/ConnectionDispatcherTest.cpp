@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ConnectionDispatcher.h>
+#include <wdt/Protocol.h>
+
+#include <folly/Memory.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <future>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+/// connects to the dispatcher like a sender, -1 on failure
+static int connectTo(int port) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *infoList;
+  if (getaddrinfo("localhost", std::to_string(port).c_str(), &hints,
+                  &infoList) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo *info = infoList; info; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, info->ai_addr, info->ai_addrlen) == 0) {
+      break;
+    }
+    ::close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(infoList);
+  return fd;
+}
+
+/// sends the connection cmd with the key, then a byte identifying the peer
+static void sendKey(int fd, int32_t key, char id) {
+  char buf[Protocol::kConnectionCmdLen + 1];
+  int64_t off = 0;
+  Protocol::encodeConnectionCmd(buf, off, key);
+  buf[off++] = id;
+  ASSERT_EQ(off, ::write(fd, buf, off));
+}
+
+/// @return   the byte identifying the peer of an accepted connection
+static char readId(int fd) {
+  char id = 0;
+  EXPECT_EQ(1, ::read(fd, &id, 1));
+  return id;
+}
+
+class ConnectionDispatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    options_.read_timeout_millis = 3000;
+    dispatcher_ = folly::make_unique<ConnectionDispatcher>(options_, 0, 16,
+                                                           &abortChecker_);
+    ASSERT_EQ(OK, dispatcher_->listen());
+  }
+
+  WdtOptions options_;
+  std::atomic<bool> abort_{false};
+  WdtAbortChecker abortChecker_{abort_};
+  std::unique_ptr<ConnectionDispatcher> dispatcher_;
+  std::string peerIp_;
+  std::string peerPort_;
+};
+
+TEST_F(ConnectionDispatcherTest, RoutesByKey) {
+  const int port = dispatcher_->getPort();
+  int client1 = connectTo(port);
+  int client2 = connectTo(port);
+  ASSERT_GE(client1, 0);
+  ASSERT_GE(client2, 0);
+  sendKey(client1, 22356, 'a');
+  sendKey(client2, 22357, 'b');
+  // the connection of the other key is kept for its receiver thread
+  int fd2 = dispatcher_->accept(22357, 2000, peerIp_, peerPort_);
+  ASSERT_GE(fd2, 0);
+  EXPECT_EQ('b', readId(fd2));
+  int fd1 = dispatcher_->accept(22356, 2000, peerIp_, peerPort_);
+  ASSERT_GE(fd1, 0);
+  EXPECT_EQ('a', readId(fd1));
+  EXPECT_FALSE(peerIp_.empty());
+  // nothing left
+  EXPECT_EQ(-1, dispatcher_->accept(22356, 100, peerIp_, peerPort_));
+  for (int closeFd : {client1, client2, fd1, fd2}) {
+    ::close(closeFd);
+  }
+}
+
+TEST_F(ConnectionDispatcherTest, ReconnectReplacesUnclaimed) {
+  const int port = dispatcher_->getPort();
+  int client1 = connectTo(port);
+  ASSERT_GE(client1, 0);
+  sendKey(client1, 22356, 'a');
+  int client2 = connectTo(port);
+  ASSERT_GE(client2, 0);
+  sendKey(client2, 22357, 'b');
+  // accepts both connections
+  int fd2 = dispatcher_->accept(22357, 2000, peerIp_, peerPort_);
+  ASSERT_GE(fd2, 0);
+  int client3 = connectTo(port);
+  ASSERT_GE(client3, 0);
+  sendKey(client3, 22356, 'c');
+  EXPECT_EQ(-1, dispatcher_->accept(22358, 500, peerIp_, peerPort_));
+  int fd1 = dispatcher_->accept(22356, 2000, peerIp_, peerPort_);
+  ASSERT_GE(fd1, 0);
+  EXPECT_EQ('c', readId(fd1));
+  for (int closeFd : {client1, client2, client3, fd1, fd2}) {
+    ::close(closeFd);
+  }
+}
+
+TEST_F(ConnectionDispatcherTest, SlowPeerDoesNotBlockAccepts) {
+  const int port = dispatcher_->getPort();
+  // connects now but only sends its key later
+  int slowClient = connectTo(port);
+  ASSERT_GE(slowClient, 0);
+  auto slowAccept = std::async(std::launch::async, [&] {
+    std::string peerIp, peerPort;
+    return dispatcher_->accept(22356, 5000, peerIp, peerPort);
+  });
+  // let the first thread accept the slow connection
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  int client = connectTo(port);
+  ASSERT_GE(client, 0);
+  sendKey(client, 22357, 'b');
+  const auto startTime = Clock::now();
+  int fd = dispatcher_->accept(22357, 2000, peerIp_, peerPort_);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ('b', readId(fd));
+  EXPECT_LT(durationMillis(Clock::now() - startTime),
+            options_.read_timeout_millis);
+  // the slow peer finally sends its key
+  sendKey(slowClient, 22356, 'a');
+  int slowFd = slowAccept.get();
+  ASSERT_GE(slowFd, 0);
+  EXPECT_EQ('a', readId(slowFd));
+  for (int closeFd : {slowClient, client, fd, slowFd}) {
+    ::close(closeFd);
+  }
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
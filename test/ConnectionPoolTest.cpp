@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ConnectionPool.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace facebook {
+namespace wdt {
+
+/// connected pair of fds, the first one is the pooled (sender) side
+static void makeConnection(int fds[2]) {
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+}
+
+TEST(ConnectionPool, AcquireRelease) {
+  ConnectionPool pool;
+  std::string peerIp;
+  EXPECT_EQ(-1, pool.acquire("host", 22356, peerIp));
+
+  int fds[2];
+  makeConnection(fds);
+  pool.release("host", 22356, "::1", fds[0]);
+  EXPECT_EQ(1, pool.size());
+  // different port or host
+  EXPECT_EQ(-1, pool.acquire("host", 22357, peerIp));
+  EXPECT_EQ(-1, pool.acquire("otherhost", 22356, peerIp));
+  EXPECT_EQ(0, pool.getNumAcquired());
+  EXPECT_EQ(fds[0], pool.acquire("host", 22356, peerIp));
+  EXPECT_EQ("::1", peerIp);
+  EXPECT_EQ(1, pool.getNumAcquired());
+  // owned by the caller now
+  EXPECT_EQ(0, pool.size());
+  EXPECT_EQ(-1, pool.acquire("host", 22356, peerIp));
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(ConnectionPool, ClosedByPeer) {
+  ConnectionPool pool;
+  std::string peerIp;
+  int fds[2];
+  makeConnection(fds);
+  pool.release("host", 22356, "::1", fds[0]);
+  ::close(fds[1]);
+  EXPECT_EQ(-1, pool.acquire("host", 22356, peerIp));
+  EXPECT_EQ(0, pool.size());
+  EXPECT_EQ(0, pool.getNumAcquired());
+
+  // unexpected data on an idle connection
+  makeConnection(fds);
+  pool.release("host", 22356, "::1", fds[0]);
+  ASSERT_EQ(1, ::write(fds[1], "x", 1));
+  EXPECT_EQ(-1, pool.acquire("host", 22356, peerIp));
+  ::close(fds[1]);
+}
+
+TEST(ConnectionPool, OnePerDestination) {
+  ConnectionPool pool;
+  std::string peerIp;
+  int fds1[2];
+  int fds2[2];
+  makeConnection(fds1);
+  makeConnection(fds2);
+  pool.release("host", 22356, "::1", fds1[0]);
+  pool.release("host", 22356, "::1", fds2[0]);
+  EXPECT_EQ(1, pool.size());
+  // the replaced connection got closed
+  char c;
+  EXPECT_EQ(0, ::read(fds1[1], &c, 1));
+  EXPECT_EQ(fds2[0], pool.acquire("host", 22356, peerIp));
+  ::close(fds2[0]);
+
+  makeConnection(fds1);
+  pool.release("host", 22356, "::1", fds1[0]);
+  pool.clear();
+  EXPECT_EQ(0, pool.size());
+  EXPECT_EQ(0, ::read(fds1[1], &c, 1));
+  ::close(fds1[1]);
+  ::close(fds2[1]);
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
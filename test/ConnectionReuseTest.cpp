@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include "TestCommon.h"
+
+#include <wdt/Receiver.h>
+#include <wdt/Sender.h>
+#include <wdt/util/ConnectionPool.h>
+#include <wdt/util/WdtFlags.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace facebook {
+namespace wdt {
+
+static std::string readFile(const std::string &path) {
+  std::ifstream fin(path);
+  std::stringstream content;
+  content << fin.rdbuf();
+  return content.str();
+}
+
+static const int kNumPorts = 2;
+
+/// transfers to a long running receiver, keeping the connections in between
+class ConnectionReuseTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto &opts = WdtOptions::getMutable();
+    opts.enable_download_resumption = false;
+    opts.reuse_connections = true;
+    opts.num_ports = kNumPorts;
+    // tiny transfers only use one of the ports
+    opts.tiny_transfer_max_files = 0;
+    char dirTemplate[] = "/tmp/wdtReuseXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    rootDir_ = dirTemplate;
+    ConnectionPool::get().clear();
+  }
+
+  void TearDown() override {
+    ConnectionPool::get().clear();
+    const std::string cmd = "rm -rf " + rootDir_;
+    EXPECT_EQ(0, system(cmd.c_str()));
+    auto &opts = WdtOptions::getMutable();
+    opts.reuse_connections = false;
+    opts.tiny_transfer_max_files = 32;
+    opts.encryption_type = encryptionTypeToStr(ENC_AES128_GCM);
+  }
+
+  /**
+   * Starts a long running receiver. It never returns, so it is left running
+   * until the end of the process (see main).
+   *
+   * @return    request to send to the receiver
+   */
+  WdtTransferRequest startReceiver() {
+    WdtTransferRequest req(/* start port */ 0, kNumPorts, rootDir_ + "/dst");
+    Receiver *receiver = new Receiver(req);
+    req = receiver->init();
+    EXPECT_EQ(OK, req.errorCode);
+    std::thread([receiver]() { receiver->runForever(); }).detach();
+    return req;
+  }
+
+  /// sends a directory with a single random file
+  void send(WdtTransferRequest req, const std::string &fileName) {
+    const std::string srcDir = rootDir_ + "/" + fileName + "/";
+    ASSERT_EQ(0, mkdir(srcDir.c_str(), 0755));
+    std::string content;
+    for (int i = 0; i < 100 * 1000; i++) {
+      content.push_back('a' + rand32() % 26);
+    }
+    std::ofstream(srcDir + fileName) << content;
+    req.directory = srcDir;
+    Sender sender(req);
+    EXPECT_EQ(OK, sender.transfer()->getSummary().getErrorCode());
+    EXPECT_TRUE(content == readFile(rootDir_ + "/dst/" + fileName))
+        << fileName;
+  }
+
+  void transferTwice() {
+    WdtTransferRequest req = startReceiver();
+    ASSERT_EQ(OK, req.errorCode);
+    auto &pool = ConnectionPool::get();
+    const int64_t numAcquired = pool.getNumAcquired();
+    send(req, "first");
+    // the receiver kept every connection at DONE
+    EXPECT_EQ(kNumPorts, pool.size());
+    EXPECT_EQ(numAcquired, pool.getNumAcquired());
+    send(req, "second");
+    // no new connection: every thread took its connection from the pool, and
+    // the receiver accepted the new session on it
+    EXPECT_EQ(numAcquired + kNumPorts, pool.getNumAcquired());
+    EXPECT_EQ(kNumPorts, pool.size());
+  }
+
+  std::string rootDir_;
+};
+
+TEST_F(ConnectionReuseTest, Unencrypted) {
+  WdtOptions::getMutable().encryption_type = "none";
+  transferTwice();
+}
+
+TEST_F(ConnectionReuseTest, Encrypted) {
+  WdtOptions::getMutable().encryption_type =
+      encryptionTypeToStr(ENC_AES128_GCM);
+  transferTwice();
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  facebook::wdt::WdtFlags::initializeFromFlags();
+  int ret = RUN_ALL_TESTS();
+  // the long running receivers are still running, skip the static destructors
+  // they depend on
+  fflush(nullptr);
+  _exit(ret);
+}
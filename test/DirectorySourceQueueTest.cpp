@@ -0,0 +1,417 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include "TestCommon.h"
+
+#include <wdt/util/DirectorySourceQueue.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace facebook {
+namespace wdt {
+
+const int64_t kMb = 1024 * 1024;
+
+class DirectorySourceQueueTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    threadCtx_.setAbortChecker(&abortChecker_);
+    char dirTemplate[] = "/tmp/wdtSourceQueueXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    rootDir_ = std::string(dirTemplate) + "/";
+  }
+
+  void TearDown() override {
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+    queue_.reset();
+    const std::string cmd = "rm -rf " + rootDir_;
+    EXPECT_EQ(0, system(cmd.c_str()));
+  }
+
+  std::unique_ptr<DirectorySourceQueue> makeQueue() {
+    auto queue = std::unique_ptr<DirectorySourceQueue>(
+        new DirectorySourceQueue(options_, rootDir_, &abortChecker_));
+    queue->setBlockSizeMbytes(options_.block_size_mbytes);
+    return queue;
+  }
+
+  /// @return   reader of a pipe, written with content by another thread
+  std::shared_ptr<StreamReader> makeStream(const std::string &content) {
+    int fds[2];
+    EXPECT_EQ(0, pipe(fds));
+    writer_ = std::thread([fds, content] {
+      int64_t written = 0;
+      while (written < content.size()) {
+        int64_t ret =
+            ::write(fds[1], content.data() + written, content.size() - written);
+        if (ret <= 0) {
+          break;
+        }
+        written += ret;
+      }
+      ::close(fds[1]);
+    });
+    return std::make_shared<FdStreamReader>(fds[0], true);
+  }
+
+  /// adds a stream and @return its blocks in order
+  std::vector<std::unique_ptr<ByteSource>> sendStream(
+      const std::string &content) {
+    auto queue = makeQueue();
+    queue->enableExternalBlocks();
+    EXPECT_TRUE(queue->buildQueueSynchronously());
+    EXPECT_EQ(OK, queue->addStream("stream", makeStream(content)));
+    queue->finishAddingBlocks();
+    std::vector<std::unique_ptr<ByteSource>> sources;
+    ErrorCode status;
+    while (auto source = queue->getNextSource(&threadCtx_, status)) {
+      sources.emplace_back(std::move(source));
+    }
+    EXPECT_TRUE(queue->getFailedSourceStats().empty());
+    std::sort(sources.begin(), sources.end(),
+              [](const std::unique_ptr<ByteSource> &source1,
+                 const std::unique_ptr<ByteSource> &source2) {
+                return source1->getOffset() < source2->getOffset();
+              });
+    // the sources outlive the queue, which only owns the metadata
+    queue_ = std::move(queue);
+    return sources;
+  }
+
+  /// @return   content of a source
+  std::string readSource(ByteSource &source) {
+    std::string content;
+    while (!source.finished()) {
+      int64_t size;
+      char *data = source.read(size);
+      if (data == nullptr || size == 0) {
+        ADD_FAILURE() << "read failed at " << content.size();
+        break;
+      }
+      content.append(data, size);
+    }
+    return content;
+  }
+
+  /// creates a file of the list which can be sent before the others
+  WdtFileInfo makeFileInfo(const std::string &fileName, int64_t size,
+                           int32_t priority, int64_t deadlineMillis) {
+    std::ofstream(rootDir_ + fileName) << std::string(size, 'a');
+    WdtFileInfo fileInfo(fileName, size, false);
+    fileInfo.priority = priority;
+    fileInfo.deadlineMillis = deadlineMillis;
+    return fileInfo;
+  }
+
+  /// @return   names of the files of the next sources, in order
+  std::vector<std::string> dequeueNames(DirectorySourceQueue &queue,
+                                        int numSources) {
+    std::vector<std::string> names;
+    ErrorCode status;
+    for (int i = 0; i < numSources; i++) {
+      auto source = queue.getNextSource(&threadCtx_, status);
+      if (!source) {
+        break;
+      }
+      names.push_back(source->getMetaData().relPath);
+    }
+    return names;
+  }
+
+  std::string randomContent(int64_t size) {
+    std::string content;
+    for (int64_t i = 0; i < size; i++) {
+      content.push_back('a' + rand32() % 26);
+    }
+    return content;
+  }
+
+  std::string rootDir_;
+  WdtOptions options_;
+  std::atomic<bool> abort_{false};
+  WdtAbortChecker abortChecker_{abort_};
+  ThreadCtx threadCtx_{options_, /* allocate buffer */ true};
+  std::thread writer_;
+  std::unique_ptr<DirectorySourceQueue> queue_;
+};
+
+TEST_F(DirectorySourceQueueTest, TinyTransfer) {
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.emplace_back("a", 100, false);
+  fileInfo.emplace_back("b", 200, false);
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  EXPECT_TRUE(queue->waitForDiscovery(2, 300, 1000, &abortChecker_));
+  // one file or one byte too many
+  EXPECT_FALSE(queue->waitForDiscovery(1, 300, 1000, &abortChecker_));
+  EXPECT_FALSE(queue->waitForDiscovery(2, 299, 1000, &abortChecker_));
+}
+
+TEST_F(DirectorySourceQueueTest, DiscoveryWaitIsBounded) {
+  // the discovery never starts
+  auto queue = makeQueue();
+  const auto startTime = Clock::now();
+  EXPECT_FALSE(queue->waitForDiscovery(1, 1000, 200, &abortChecker_));
+  const int64_t waitedMillis = durationMillis(Clock::now() - startTime);
+  EXPECT_GE(waitedMillis, 200);
+  EXPECT_LT(waitedMillis, 2000);
+}
+
+TEST_F(DirectorySourceQueueTest, DiscoveryWaitIsAborted) {
+  auto queue = makeQueue();
+  auto tiny = std::async(std::launch::async, [&] {
+    return queue->waitForDiscovery(1, 1000, 60000, &abortChecker_);
+  });
+  EXPECT_EQ(std::future_status::timeout,
+            tiny.wait_for(std::chrono::milliseconds(100)));
+  abort_ = true;
+  EXPECT_EQ(std::future_status::ready,
+            tiny.wait_for(std::chrono::milliseconds(2000)));
+  EXPECT_FALSE(tiny.get());
+}
+
+TEST_F(DirectorySourceQueueTest, ExternalBlocksAreNotTiny) {
+  auto queue = makeQueue();
+  queue->enableExternalBlocks();
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  queue->addBlock("a", 500, 0, 500);
+  // does not wait for finishAddingBlocks()
+  EXPECT_FALSE(queue->waitForDiscovery(1, 1000, 60000, &abortChecker_));
+  queue->finishAddingBlocks();
+}
+
+TEST_F(DirectorySourceQueueTest, StreamSplitInBlocks) {
+  options_.block_size_mbytes = 1;
+  const std::string content = randomContent(2 * kMb + kMb / 2);
+  auto sources = sendStream(content);
+  ASSERT_EQ(3, sources.size());
+  std::string received;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(i * kMb, sources[i]->getOffset());
+    received += readSource(*sources[i]);
+  }
+  EXPECT_EQ(kMb, sources[0]->getSize());
+  EXPECT_EQ(kMb / 2, sources[2]->getSize());
+  // only the last block knows the size of the stream
+  EXPECT_EQ(0, sources[0]->getMetaData().size);
+  EXPECT_EQ(content.size(), sources[2]->getMetaData().size);
+  EXPECT_TRUE(received == content);
+}
+
+TEST_F(DirectorySourceQueueTest, StreamEndingOnABlock) {
+  options_.block_size_mbytes = 1;
+  const std::string content = randomContent(2 * kMb);
+  auto sources = sendStream(content);
+  ASSERT_EQ(3, sources.size());
+  EXPECT_EQ(kMb, sources[1]->getSize());
+  EXPECT_EQ(0, sources[1]->getMetaData().size);
+  // an empty last block carries the final size
+  EXPECT_EQ(2 * kMb, sources[2]->getOffset());
+  EXPECT_EQ(0, sources[2]->getSize());
+  EXPECT_EQ(2 * kMb, sources[2]->getMetaData().size);
+}
+
+TEST_F(DirectorySourceQueueTest, EmptyStream) {
+  auto sources = sendStream("");
+  ASSERT_EQ(1, sources.size());
+  EXPECT_EQ(0, sources[0]->getOffset());
+  EXPECT_EQ(0, sources[0]->getSize());
+  EXPECT_EQ(0, sources[0]->getMetaData().size);
+}
+
+TEST_F(DirectorySourceQueueTest, AbortDuringStreamRead) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  auto queue = makeQueue();
+  queue->enableExternalBlocks();
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  // nothing is ever written
+  ASSERT_EQ(OK, queue->addStream(
+                    "stream", std::make_shared<FdStreamReader>(fds[0], true)));
+  queue->finishAddingBlocks();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(queue->fileDiscoveryFinished());
+  abort_ = true;
+  ErrorCode status;
+  EXPECT_EQ(nullptr, queue->getNextSource(&threadCtx_, status));
+  EXPECT_TRUE(queue->fileDiscoveryFinished());
+  auto &failedStats = queue->getFailedSourceStats();
+  ASSERT_EQ(1, failedStats.size());
+  EXPECT_EQ(ABORT, failedStats[0].getLocalErrorCode());
+  ::close(fds[1]);
+}
+
+TEST_F(DirectorySourceQueueTest, DestroyedDuringStreamRead) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  {
+    auto queue = makeQueue();
+    queue->enableExternalBlocks();
+    ASSERT_TRUE(queue->buildQueueSynchronously());
+    ASSERT_EQ(OK,
+              queue->addStream(
+                  "stream", std::make_shared<FdStreamReader>(fds[0], true)));
+    // the transfer ends without the stream, the queue must not wait for it
+  }
+  ::close(fds[1]);
+}
+
+TEST_F(DirectorySourceQueueTest, PriorityThenDeadline) {
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.push_back(makeFileInfo("big", 300, 0, 0));
+  fileInfo.push_back(makeFileInfo("small", 100, 0, 0));
+  fileInfo.push_back(makeFileInfo("late", 100, 0, 2000));
+  fileInfo.push_back(makeFileInfo("early", 50, 0, 1000));
+  fileInfo.push_back(makeFileInfo("urgent", 10, 1, 0));
+  fileInfo.push_back(makeFileInfo("urgentLate", 20, 1, 5000));
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  // files without a deadline come last, largest first
+  EXPECT_EQ(std::vector<std::string>({"urgentLate", "urgent", "early", "late",
+                                      "big", "small"}),
+            dequeueNames(*queue, 6));
+}
+
+TEST_F(DirectorySourceQueueTest, TiesKeepRetryAndSizeOrder) {
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.push_back(makeFileInfo("a", 100, 2, 1000));
+  fileInfo.push_back(makeFileInfo("b", 200, 2, 1000));
+  fileInfo.push_back(makeFileInfo("c", 300, 2, 1000));
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  ErrorCode status;
+  auto source = queue->getNextSource(&threadCtx_, status);
+  ASSERT_NE(nullptr, source);
+  EXPECT_EQ("c", source->getMetaData().relPath);
+  // a retried source goes after the ones never tried
+  source->getTransferStats().incrFailedAttempts();
+  queue->returnToQueue(source);
+  EXPECT_EQ(std::vector<std::string>({"b", "a", "c"}),
+            dequeueNames(*queue, 3));
+}
+
+TEST_F(DirectorySourceQueueTest, ResentBlocksAreMerged) {
+  options_.block_size_mbytes = 1;
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.push_back(makeFileInfo("d", 2 * kMb + kMb / 2, 0, 60000));
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  const auto startTime = Clock::now();
+  std::vector<std::unique_ptr<ByteSource>> sources;
+  ErrorCode status;
+  while (auto source = queue->getNextSource(&threadCtx_, status)) {
+    sources.emplace_back(std::move(source));
+  }
+  ASSERT_EQ(3, sources.size());
+  // the first block sent twice counts once
+  queue->markSourceSent(*sources[0]);
+  queue->markSourceSent(*sources[0]);
+  // the second one breaks after its first bytes, then is resumed
+  queue->markSourcePartSent(*sources[1], 1000);
+  sources[1]->advanceOffset(1000);
+  queue->markSourceSent(*sources[1]);
+  auto reports = queue->getDeadlineReports(startTime);
+  ASSERT_EQ(1, reports.size());
+  EXPECT_EQ(-1, reports[0].sentMillis);
+  EXPECT_FALSE(reports[0].met());
+  queue->markSourceSent(*sources[2]);
+  reports = queue->getDeadlineReports(startTime);
+  EXPECT_GE(reports[0].sentMillis, 0);
+  EXPECT_TRUE(reports[0].met());
+}
+
+TEST_F(DirectorySourceQueueTest, PreviouslyReceivedChunksAreSent) {
+  options_.block_size_mbytes = 1;
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.push_back(makeFileInfo("partial", 2 * kMb, 0, 60000));
+  fileInfo.push_back(makeFileInfo("done", 1000, 0, 30000));
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  const auto startTime = Clock::now();
+  std::vector<FileChunksInfo> previousChunks;
+  std::string partial("partial"), done("done");
+  previousChunks.emplace_back(0, partial, 2 * kMb);
+  previousChunks.back().addChunk(Interval(0, kMb + 10));
+  previousChunks.emplace_back(1, done, 1000);
+  previousChunks.back().addChunk(Interval(0, 1000));
+  queue->setPreviouslyReceivedChunks(previousChunks);
+  ErrorCode status;
+  auto source = queue->getNextSource(&threadCtx_, status);
+  ASSERT_NE(nullptr, source);
+  EXPECT_EQ(kMb + 10, source->getOffset());
+  EXPECT_EQ(nullptr, queue->getNextSource(&threadCtx_, status));
+  queue->markSourceSent(*source);
+  auto reports = queue->getDeadlineReports(startTime);
+  ASSERT_EQ(2, reports.size());
+  EXPECT_EQ("done", reports[0].fileName);
+  EXPECT_TRUE(reports[0].met());
+  EXPECT_EQ("partial", reports[1].fileName);
+  EXPECT_TRUE(reports[1].met());
+}
+
+TEST_F(DirectorySourceQueueTest, MissedDeadlineReported) {
+  auto queue = makeQueue();
+  std::vector<WdtFileInfo> fileInfo;
+  fileInfo.push_back(makeFileInfo("fast", 100, 0, 60000));
+  fileInfo.push_back(makeFileInfo("slow", 100, 0, 1));
+  fileInfo.push_back(makeFileInfo("never", 100, 0, 30000));
+  queue->setFileInfo(fileInfo);
+  ASSERT_TRUE(queue->buildQueueSynchronously());
+  const auto startTime = Clock::now();
+  ErrorCode status;
+  auto slow = queue->getNextSource(&threadCtx_, status);
+  auto never = queue->getNextSource(&threadCtx_, status);
+  auto fast = queue->getNextSource(&threadCtx_, status);
+  ASSERT_NE(nullptr, fast);
+  EXPECT_EQ("slow", slow->getMetaData().relPath);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue->markSourceSent(*slow);
+  queue->markSourceSent(*fast);
+
+  TransferReport report(TransferStats(), 1, 300);
+  report.setDeadlineReports(queue->getDeadlineReports(startTime));
+  const auto &reports = report.getDeadlineReports();
+  ASSERT_EQ(3, reports.size());
+  EXPECT_EQ("slow", reports[0].fileName);
+  EXPECT_FALSE(reports[0].met());
+  EXPECT_EQ("never", reports[1].fileName);
+  EXPECT_EQ(-1, reports[1].sentMillis);
+  EXPECT_TRUE(reports[2].met());
+  std::ostringstream output;
+  output << report;
+  const std::string summary = output.str();
+  EXPECT_NE(std::string::npos, summary.find("Missed deadlines 2 of 3"))
+      << summary;
+  EXPECT_NE(std::string::npos, summary.find("slow deadline 1 ms")) << summary;
+  EXPECT_NE(std::string::npos, summary.find("never deadline 30000 ms sent -1"))
+      << summary;
+  EXPECT_EQ(std::string::npos, summary.find("fast")) << summary;
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/FileCompletionTracker.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace wdt {
+
+class RecordingListener : public FileCompletionListener {
+ public:
+  void onFileComplete(const std::string &fileName, int64_t seqId,
+                      int64_t fileSize) override {
+    completed.push_back(fileName);
+    sizes.push_back(fileSize);
+  }
+
+  std::vector<std::string> completed;
+  std::vector<int64_t> sizes;
+};
+
+BlockDetails makeBlock(const std::string &fileName, int64_t seqId,
+                       int64_t fileSize, int64_t offset, int64_t dataSize) {
+  BlockDetails blockDetails;
+  blockDetails.fileName = fileName;
+  blockDetails.seqId = seqId;
+  blockDetails.fileSize = fileSize;
+  blockDetails.offset = offset;
+  blockDetails.dataSize = dataSize;
+  blockDetails.allocationStatus = NOT_EXISTS;
+  return blockDetails;
+}
+
+TEST(FileCompletionTracker, BlocksInAnyOrder) {
+  auto listener = std::make_shared<RecordingListener>();
+  FileCompletionTracker tracker(listener);
+  tracker.reset({});
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 20, 10), 10);
+  tracker.addVerifiedBytes(makeBlock("empty", 1, 0, 0, 0), 0);
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 0, 10), 10);
+  EXPECT_EQ(std::vector<std::string>{"empty"}, listener->completed);
+  // part of a block acknowledged by a checkpoint, then the rest
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 10, 10), 4);
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 14, 6), 6);
+  EXPECT_EQ(std::vector<std::string>({"empty", "a"}), listener->completed);
+}
+
+TEST(FileCompletionTracker, StreamSizeKnownAtTheEnd) {
+  auto listener = std::make_shared<RecordingListener>();
+  FileCompletionTracker tracker(listener);
+  tracker.reset({});
+  tracker.addVerifiedBytes(makeBlock("stream", 2, 0, 0, 16), 16);
+  tracker.addVerifiedBytes(makeBlock("stream", 2, 40, 32, 8), 8);
+  EXPECT_TRUE(listener->completed.empty());
+  tracker.addVerifiedBytes(makeBlock("stream", 2, 0, 16, 16), 16);
+  EXPECT_EQ(std::vector<std::string>{"stream"}, listener->completed);
+  EXPECT_EQ(40, listener->sizes[0]);
+}
+
+TEST(FileCompletionTracker, ResentRange) {
+  auto listener = std::make_shared<RecordingListener>();
+  FileCompletionTracker tracker(listener);
+  tracker.reset({});
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 0, 10), 10);
+  // the same block sent again after a connection broke
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 0, 10), 10);
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 10, 10), 10);
+  EXPECT_TRUE(listener->completed.empty());
+  // overlaps the bytes verified before
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 15, 15), 15);
+  EXPECT_EQ(std::vector<std::string>{"a"}, listener->completed);
+  tracker.addVerifiedBytes(makeBlock("a", 0, 30, 20, 10), 10);
+  EXPECT_EQ(1, listener->completed.size());
+}
+
+TEST(FileCompletionTracker, ResumedFiles) {
+  auto listener = std::make_shared<RecordingListener>();
+  FileCompletionTracker tracker(listener);
+  std::vector<FileChunksInfo> previousChunks;
+  std::string done("done"), partial("partial");
+  previousChunks.emplace_back(3, done, 10);
+  previousChunks.back().addChunk(Interval(0, 10));
+  previousChunks.emplace_back(4, partial, 10);
+  previousChunks.back().addChunk(Interval(0, 6));
+  tracker.reset(previousChunks);
+  tracker.addVerifiedBytes(makeBlock("partial", 4, 10, 6, 4), 4);
+  EXPECT_EQ(std::vector<std::string>{"partial"}, listener->completed);
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
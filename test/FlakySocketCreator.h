@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/Sender.h>
+#include <wdt/util/ClientSocket.h>
+
+#include <folly/Memory.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+/// Breaks the first connection it makes while a block is being sent
+class FlakySocketCreator : public Sender::ISocketCreator {
+ public:
+  class FlakySocket : public ClientSocket {
+   public:
+    FlakySocket(FlakySocketCreator &creator, ThreadCtx &threadCtx,
+                const std::string &dest, int port,
+                const EncryptionParams &encryptionParams)
+        : ClientSocket(threadCtx, dest, port, encryptionParams),
+          creator_(creator) {
+    }
+
+    ErrorCode connect() override {
+      ErrorCode code = ClientSocket::connect();
+      if (code == OK && !creator_.broken_) {
+        creator_.broken_ = true;
+        const int fd = getFd();
+        creator_.breaker_ = std::thread([fd] {
+          std::this_thread::sleep_for(std::chrono::milliseconds(500));
+          LOG(INFO) << "Breaking the connection";
+          ::shutdown(fd, SHUT_RDWR);
+        });
+      }
+      return code;
+    }
+
+   private:
+    FlakySocketCreator &creator_;
+  };
+
+  std::unique_ptr<ClientSocket> makeSocket(
+      ThreadCtx &threadCtx, const std::string &dest, const int port,
+      const EncryptionParams &encryptionParams) override {
+    return folly::make_unique<FlakySocket>(*this, threadCtx, dest, port,
+                                           encryptionParams);
+  }
+
+  ~FlakySocketCreator() {
+    if (breaker_.joinable()) {
+      breaker_.join();
+    }
+  }
+
+  bool broken_{false};
+  std::thread breaker_;
+};
+}
+}
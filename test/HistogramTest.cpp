@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/Histogram.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace wdt {
+
+TEST(Histogram, BucketBoundaries) {
+  for (int i = 0; i < Histogram::kNumBuckets; i++) {
+    int64_t start = Histogram::getBucketStart(i);
+    EXPECT_EQ(i, Histogram::getBucketIndex(start));
+    if (i < Histogram::kNumBuckets - 1) {
+      int64_t end = Histogram::getBucketEnd(i);
+      EXPECT_EQ(i, Histogram::getBucketIndex(end - 1));
+      EXPECT_EQ(i + 1, Histogram::getBucketIndex(end));
+      // relative error bound
+      EXPECT_LE((end - start) * Histogram::kSubBucketCount, std::max<int64_t>(
+                                                                 start, 16));
+    }
+  }
+  EXPECT_EQ(Histogram::kNumBuckets - 1,
+            Histogram::getBucketIndex(std::numeric_limits<int64_t>::max()));
+}
+
+TEST(Histogram, Percentiles) {
+  Histogram histogram;
+  EXPECT_EQ(0, histogram.getPercentile(50));
+  for (int64_t i = 1; i <= 10000; i++) {
+    histogram.record(i);
+  }
+  EXPECT_EQ(10000, histogram.getCount());
+  EXPECT_EQ(1, histogram.getMin());
+  EXPECT_EQ(10000, histogram.getMax());
+  EXPECT_EQ(10000 * 10001 / 2, histogram.getSum());
+  const double percentiles[] = {50, 90, 99, 99.9};
+  for (double p : percentiles) {
+    double expected = p * 100;
+    double actual = histogram.getPercentile(p);
+    EXPECT_NEAR(expected, actual, expected / Histogram::kSubBucketCount);
+  }
+  EXPECT_EQ(10000, histogram.getPercentile(100));
+  EXPECT_EQ(1, histogram.getPercentile(0));
+}
+
+TEST(Histogram, Merge) {
+  Histogram h1, h2, all;
+  for (int64_t i = 0; i < 1000; i++) {
+    h1.record(i * 3);
+    all.record(i * 3);
+    h2.record(i * 1000 + 7);
+    all.record(i * 1000 + 7);
+  }
+  h1 += h2;
+  EXPECT_EQ(all.getCount(), h1.getCount());
+  EXPECT_EQ(all.getSum(), h1.getSum());
+  EXPECT_EQ(all.getMin(), h1.getMin());
+  EXPECT_EQ(all.getMax(), h1.getMax());
+  for (int i = 0; i < Histogram::kNumBuckets; i++) {
+    EXPECT_EQ(all.getBucketCount(i), h1.getBucketCount(i));
+  }
+  h1.clear();
+  EXPECT_EQ(0, h1.getCount());
+  EXPECT_EQ(0, h1.getMax());
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/JsonWriter.h>
+#include <wdt/Reporting.h>
+#include <wdt/WdtOptions.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+
+namespace facebook {
+namespace wdt {
+
+TEST(JsonWriter, Nesting) {
+  JsonWriter json;
+  json.beginObject()
+      .key("name")
+      .value("a\"b\\c\n")
+      .key("list")
+      .beginArray()
+      .value((int64_t)1)
+      .value(2.5)
+      .beginObject()
+      .endObject()
+      .value(true)
+      .endArray()
+      .key("empty")
+      .beginArray()
+      .endArray()
+      .key("nan")
+      .value(std::numeric_limits<double>::quiet_NaN())
+      .endObject();
+  EXPECT_EQ(
+      "{\"name\":\"a\\\"b\\\\c\\n\",\"list\":[1,2.5,{},true],\"empty\":[],"
+      "\"nan\":null}",
+      json.str());
+}
+
+TEST(JsonWriter, PerfStatReport) {
+  WdtOptions options;
+  PerfStatReport report(options);
+  report.addPerfStat(PerfStatReport::FILE_WRITE, 10);
+  report.addPerfStat(PerfStatReport::FILE_WRITE, 10);
+  JsonWriter json;
+  report.writeJson(json);
+  EXPECT_EQ(
+      "[{\"stat\":\"file_write\",\"count\":2,\"sum_usec\":20,"
+      "\"min_usec\":10,\"max_usec\":10,\"avg_usec\":10,\"p50_usec\":10,"
+      "\"p90_usec\":10,\"p99_usec\":10,\"p999_usec\":10,"
+      "\"buckets\":[[10,11,2]]}]",
+      json.str());
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+/**
+ * In-process loopback benchmark: runs a Receiver and a Sender in the same
+ * process over localhost, reading synthetic files from memory and discarding
+ * the data on the receiving side (skip_writes). This measures the protocol /
+ * cpu ceiling of wdt without disk or page cache effects.
+ *
+ * All the wdt options (num_ports, block_size_mbytes, encryption_type,
+ * enable_checksum, avg_mbytes_per_sec, ...) are available as flags. Results
+ * are logged and printed on stdout as a JSON object.
+ */
+#include <wdt/Receiver.h>
+#include <wdt/Sender.h>
+#include <wdt/Wdt.h>
+#include <wdt/util/JsonWriter.h>
+
+#include <folly/Conv.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+DEFINE_int32(num_files, 1000, "Number of synthetic files per iteration");
+DEFINE_string(file_size_distribution, "fixed",
+              "Distribution of the file sizes: fixed, uniform (between 0 and "
+              "twice file_size_bytes) or lognormal (median file_size_bytes)");
+DEFINE_int64(file_size_bytes, 1024 * 1024, "Mean/median file size");
+DEFINE_double(file_size_sigma, 1.0,
+              "Standard deviation of the log of the sizes for lognormal");
+DEFINE_int64(max_file_size_bytes, 256 * 1024 * 1024,
+             "Sizes are capped to this, it is also the memory used for the "
+             "synthetic data");
+DEFINE_int32(seed, 1, "Seed of the file size generator");
+DEFINE_int32(iterations, 3, "Number of transfers to run");
+DEFINE_string(data_dir, "",
+              "Directory of the (unlinked) synthetic data file, defaults to "
+              "/dev/shm when available, /tmp otherwise");
+
+namespace facebook {
+namespace wdt {
+
+/// @return   sizes of the synthetic files according to the flags
+static std::vector<int64_t> generateFileSizes() {
+  std::mt19937_64 generator(FLAGS_seed);
+  std::vector<int64_t> sizes;
+  const double meanSize = FLAGS_file_size_bytes;
+  for (int i = 0; i < FLAGS_num_files; i++) {
+    double size = meanSize;
+    if (FLAGS_file_size_distribution == "uniform") {
+      size = std::uniform_real_distribution<double>(0, 2 * meanSize)(generator);
+    } else if (FLAGS_file_size_distribution == "lognormal") {
+      size = std::lognormal_distribution<double>(std::log(meanSize),
+                                                 FLAGS_file_size_sigma)(
+          generator);
+    } else {
+      WDT_CHECK_EQ("fixed", FLAGS_file_size_distribution)
+          << "Unknown file size distribution";
+    }
+    sizes.push_back(std::min<int64_t>(size, FLAGS_max_file_size_bytes));
+  }
+  return sizes;
+}
+
+/**
+ * Creates an unlinked file filled with a pseudo random pattern, living in
+ * memory when data_dir is a tmpfs. All the synthetic files are ranges of it.
+ *
+ * @return    fd of the file, -1 on error
+ */
+static int createDataFile(int64_t size) {
+  std::string dir = FLAGS_data_dir;
+  if (dir.empty()) {
+    dir = (access("/dev/shm", W_OK) == 0) ? "/dev/shm" : "/tmp";
+  }
+  std::string path = dir + "/wdt_loopback_benchmark.XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    PLOG(ERROR) << "Unable to create data file in " << dir;
+    return -1;
+  }
+  unlink(path.c_str());
+  std::vector<char> buffer(1024 * 1024);
+  std::mt19937 generator(FLAGS_seed);
+  for (char &c : buffer) {
+    c = generator();
+  }
+  for (int64_t written = 0; written < size;) {
+    int64_t toWrite = std::min<int64_t>(buffer.size(), size - written);
+    int64_t ret = ::write(fd, buffer.data(), toWrite);
+    if (ret <= 0) {
+      PLOG(ERROR) << "Unable to write data file";
+      ::close(fd);
+      return -1;
+    }
+    written += ret;
+  }
+  return fd;
+}
+
+struct IterationResult {
+  ErrorCode errCode{OK};
+  double seconds{0};
+  double mbytesPerSec{0};
+  int64_t totalBytes{0};
+};
+
+/// runs one transfer of the given files over loopback
+static IterationResult runIteration(const std::vector<WdtFileInfo> &files,
+                                    const std::string &receiverDir) {
+  const WdtOptions &options = WdtOptions::get();
+  IterationResult result;
+  WdtTransferRequest receiverReq(options.start_port, options.num_ports,
+                                 receiverDir);
+  Receiver receiver(receiverReq);
+  WdtTransferRequest senderReq = receiver.init();
+  if (senderReq.errorCode != OK && senderReq.errorCode != FEWER_PORTS) {
+    LOG(ERROR) << "Error setting up receiver "
+               << errorCodeToStr(senderReq.errorCode);
+    result.errCode = senderReq.errorCode;
+    return result;
+  }
+  result.errCode = receiver.transferAsync();
+  if (result.errCode != OK) {
+    return result;
+  }
+  senderReq.hostName = "localhost";
+  senderReq.directory = "/";
+  senderReq.fileInfo = files;
+  Sender sender(senderReq);
+  std::unique_ptr<TransferReport> senderReport = sender.transfer();
+  std::unique_ptr<TransferReport> receiverReport = receiver.finish();
+  result.errCode = getMoreInterestingError(
+      senderReport->getSummary().getErrorCode(),
+      receiverReport->getSummary().getErrorCode());
+  result.seconds = senderReport->getTotalTime();
+  result.mbytesPerSec = senderReport->getThroughputMBps();
+  result.totalBytes = senderReport->getSummary().getEffectiveTotalBytes();
+  return result;
+}
+
+static int runBenchmark() {
+  WdtOptions &options = WdtOptions::getMutable();
+  // discard sink
+  options.skip_writes = true;
+  options.enable_download_resumption = false;
+
+  const std::vector<int64_t> sizes = generateFileSizes();
+  int64_t totalSize = 0;
+  int64_t maxSize = 0;
+  for (int64_t size : sizes) {
+    totalSize += size;
+    maxSize = std::max(maxSize, size);
+  }
+  int fd = createDataFile(maxSize);
+  if (fd < 0) {
+    return ERROR;
+  }
+  std::vector<WdtFileInfo> files;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    files.emplace_back(fd, sizes[i], folly::to<std::string>("file_", i));
+  }
+  const std::string receiverDir =
+      FLAGS_data_dir.empty() ? "/tmp/wdt_loopback_benchmark" : FLAGS_data_dir;
+  LOG(INFO) << "Benchmarking " << files.size() << " files, "
+            << totalSize / kMbToB << " Mbytes per iteration";
+
+  std::vector<IterationResult> results;
+  ErrorCode errCode = OK;
+  for (int i = 0; i < FLAGS_iterations; i++) {
+    IterationResult result = runIteration(files, receiverDir);
+    LOG(INFO) << "Iteration " << i << " " << errorCodeToStr(result.errCode)
+              << " " << result.seconds << " sec " << result.mbytesPerSec
+              << " Mbytes/sec";
+    errCode = getMoreInterestingError(errCode, result.errCode);
+    results.push_back(result);
+  }
+  ::close(fd);
+
+  std::vector<double> throughputs;
+  for (const auto &result : results) {
+    throughputs.push_back(result.mbytesPerSec);
+  }
+  std::sort(throughputs.begin(), throughputs.end());
+  JsonWriter json;
+  json.beginObject()
+      .key("benchmark")
+      .value("loopback")
+      .key("version")
+      .value(Protocol::getFullVersion())
+      .key("num_files")
+      .value((int64_t)files.size())
+      .key("total_file_size")
+      .value(totalSize)
+      .key("file_size_distribution")
+      .value(FLAGS_file_size_distribution)
+      .key("num_ports")
+      .value(options.num_ports)
+      .key("block_size_mbytes")
+      .value(options.block_size_mbytes)
+      .key("encryption_type")
+      .value(options.encryption_type)
+      .key("enable_checksum")
+      .value(options.enable_checksum)
+      .key("avg_mbytes_per_sec")
+      .value(options.avg_mbytes_per_sec);
+  json.key("iterations").beginArray();
+  for (const auto &result : results) {
+    json.beginObject()
+        .key("error_code")
+        .value(errorCodeToStr(result.errCode))
+        .key("seconds")
+        .value(result.seconds)
+        .key("effective_bytes")
+        .value(result.totalBytes)
+        .key("mbytes_per_sec")
+        .value(result.mbytesPerSec)
+        .endObject();
+  }
+  json.endArray();
+  if (!throughputs.empty()) {
+    json.key("median_mbytes_per_sec")
+        .value(throughputs[throughputs.size() / 2])
+        .key("best_mbytes_per_sec")
+        .value(throughputs.back());
+  }
+  json.key("error_code").value(errorCodeToStr(errCode)).endObject();
+  std::cout << json.str() << std::endl;
+  return errCode;
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  signal(SIGPIPE, SIG_IGN);
+  facebook::wdt::Wdt::initializeWdt("wdt_loopback_benchmark");
+  return facebook::wdt::runBenchmark();
+}
@@ -0,0 +1,365 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+/**
+ * Microbenchmarks of the building blocks of a transfer: protocol codecs,
+ * throttler, source queue, checksum and encryption. Each benchmark is run
+ * until it lasts at least --min_time_ms, the best of --repetitions runs is
+ * kept. Results are printed on stdout as JSON so they can be tracked for
+ * regressions.
+ */
+#include <wdt/Protocol.h>
+#include <wdt/Throttler.h>
+#include <wdt/WdtOptions.h>
+#include <wdt/util/DirectorySourceQueue.h>
+#include <wdt/util/EncryptionUtils.h>
+#include <wdt/util/JsonWriter.h>
+
+#include <folly/Checksum.h>
+#include <folly/Conv.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+DEFINE_int32(min_time_ms, 200, "Minimum duration of a benchmark run");
+DEFINE_int32(repetitions, 3, "Number of runs per benchmark, best is kept");
+DEFINE_int32(num_threads, 8, "Number of threads of the contention benchmarks");
+DEFINE_string(filter, "", "Only run the benchmarks containing this string");
+
+namespace facebook {
+namespace wdt {
+
+/// prevents the compiler from optimizing away a computed value
+template <typename T>
+static void doNotOptimizeAway(const T &value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+/// runs the given number of iterations of a benchmark
+typedef std::function<void(int64_t iterations)> BenchmarkFunc;
+
+class MicroBenchmarks {
+ public:
+  /**
+   * Runs a benchmark (if it matches the filter) and records its result
+   *
+   * @param name        name of the benchmark
+   * @param numThreads  number of threads running func concurrently
+   * @param bytes       bytes processed per iteration, 0 if not relevant
+   * @param func        benchmark body, called by each thread
+   */
+  void run(const std::string &name, int numThreads, int64_t bytes,
+           const BenchmarkFunc &func) {
+    if (name.find(FLAGS_filter) == std::string::npos) {
+      return;
+    }
+    const int64_t minNanos = FLAGS_min_time_ms * 1000 * 1000LL;
+    int64_t iterations = 1;
+    int64_t nanos = timeRun(numThreads, iterations, func);
+    while (nanos < minNanos) {
+      // aim a bit above the minimum to converge in few steps
+      int64_t next = nanos > 0 ? iterations * 1.2 * minNanos / nanos
+                               : iterations * 100;
+      iterations = std::max(iterations * 2, std::min(next, iterations * 100));
+      nanos = timeRun(numThreads, iterations, func);
+    }
+    for (int i = 1; i < FLAGS_repetitions; i++) {
+      nanos = std::min(nanos, timeRun(numThreads, iterations, func));
+    }
+    const double nanosPerIteration = (double)nanos / iterations;
+    LOG(INFO) << name << " threads " << numThreads << " : "
+              << nanosPerIteration << " ns/iteration";
+    json_.beginObject()
+        .key("name")
+        .value(name)
+        .key("threads")
+        .value(numThreads)
+        .key("iterations")
+        .value(iterations)
+        .key("ns_per_iteration")
+        .value(nanosPerIteration)
+        .key("iterations_per_sec")
+        .value(1e9 * numThreads / nanosPerIteration);
+    if (bytes > 0) {
+      json_.key("mbytes_per_sec")
+          .value(1e9 * numThreads * bytes / nanosPerIteration / kMbToB);
+    }
+    json_.endObject();
+  }
+
+  void begin() {
+    json_.beginObject()
+        .key("version")
+        .value(Protocol::getFullVersion())
+        .key("benchmarks")
+        .beginArray();
+  }
+
+  /// @return   the results as a JSON object
+  const std::string &end() {
+    json_.endArray().endObject();
+    return json_.str();
+  }
+
+ private:
+  /// @return   wall time in nanoseconds of one run on all the threads
+  static int64_t timeRun(int numThreads, int64_t iterations,
+                         const BenchmarkFunc &func) {
+    const Clock::time_point start = Clock::now();
+    if (numThreads == 1) {
+      func(iterations);
+    } else {
+      std::vector<std::thread> threads;
+      for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(func, iterations);
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                start)
+        .count();
+  }
+
+  JsonWriter json_;
+};
+
+static BlockDetails makeBlockDetails() {
+  BlockDetails blockDetails;
+  blockDetails.fileName = "some/directory/path/file_name_12345.dat";
+  blockDetails.seqId = 123456;
+  blockDetails.fileSize = 1LL << 34;
+  blockDetails.offset = 1LL << 30;
+  blockDetails.dataSize = 16 * 1024 * 1024;
+  blockDetails.allocationStatus = EXISTS_TOO_SMALL;
+  blockDetails.prevSeqId = 123;
+  return blockDetails;
+}
+
+static void protocolBenchmarks(MicroBenchmarks &benchmarks) {
+  const int protocolVersion = Protocol::protocol_version;
+  const BlockDetails blockDetails = makeBlockDetails();
+  char buf[Protocol::kMaxHeader];
+  // first blocks of consecutive files, the names are sent front coded
+  BlockDetails newFiles[2] = {blockDetails, blockDetails};
+  newFiles[1].fileName = "some/directory/path/file_name_12346.dat";
+  FileNameDictionary encodeDictionary;
+  benchmarks.run("Protocol::encodeHeader new file", 1, 0,
+                 [&](int64_t iterations) {
+                   for (int64_t i = 0; i < iterations; i++) {
+                     BlockDetails &newFile = newFiles[i & 1];
+                     newFile.seqId = i;
+                     int64_t off = 0;
+                     Protocol::encodeHeader(protocolVersion, buf, off,
+                                            sizeof(buf), newFile,
+                                            &encodeDictionary);
+                     doNotOptimizeAway(buf);
+                   }
+                 });
+  // later blocks of the same file, only the seq-id is sent
+  encodeDictionary.reset();
+  int64_t firstBlockLen = 0;
+  Protocol::encodeHeader(protocolVersion, buf, firstBlockLen, sizeof(buf),
+                         blockDetails, &encodeDictionary);
+  benchmarks.run("Protocol::encodeHeader", 1, 0, [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations; i++) {
+      int64_t off = 0;
+      Protocol::encodeHeader(protocolVersion, buf, off, sizeof(buf),
+                             blockDetails, &encodeDictionary);
+      doNotOptimizeAway(buf);
+    }
+  });
+
+  encodeDictionary.reset();
+  char firstBlockBuf[Protocol::kMaxHeader];
+  firstBlockLen = 0;
+  Protocol::encodeHeader(protocolVersion, firstBlockBuf, firstBlockLen,
+                         sizeof(firstBlockBuf), blockDetails,
+                         &encodeDictionary);
+  int64_t encodedLen = 0;
+  Protocol::encodeHeader(protocolVersion, buf, encodedLen, sizeof(buf),
+                         blockDetails, &encodeDictionary);
+  FileNameDictionary decodeDictionary;
+  BlockDetails decoded;
+  benchmarks.run("Protocol::decodeHeader new file", 1, 0,
+                 [&](int64_t iterations) {
+                   for (int64_t i = 0; i < iterations; i++) {
+                     int64_t off = 0;
+                     WDT_CHECK(Protocol::decodeHeader(
+                         protocolVersion, firstBlockBuf, off, firstBlockLen,
+                         decoded, &decodeDictionary));
+                     doNotOptimizeAway(decoded);
+                   }
+                 });
+  benchmarks.run("Protocol::decodeHeader", 1, 0, [&](int64_t iterations) {
+    for (int64_t i = 0; i < iterations; i++) {
+      int64_t off = 0;
+      WDT_CHECK(Protocol::decodeHeader(protocolVersion, buf, off, encodedLen,
+                                       decoded, &decodeDictionary));
+      doNotOptimizeAway(decoded);
+    }
+  });
+
+  // 100 files with 10 chunks each
+  std::vector<FileChunksInfo> chunksInfoList;
+  for (int64_t f = 0; f < 100; f++) {
+    std::string fileName = folly::to<std::string>("dir/file_", f);
+    FileChunksInfo chunksInfo(f, fileName, 1LL << 32);
+    for (int64_t c = 0; c < 10; c++) {
+      chunksInfo.addChunk(Interval(c << 24, (c << 24) + (1 << 23)));
+    }
+    chunksInfoList.emplace_back(std::move(chunksInfo));
+  }
+  std::vector<char> listBuf(1024 * 1024);
+  benchmarks.run("Protocol::encodeFileChunksInfoList(100x10)", 1, 0,
+                 [&](int64_t iterations) {
+                   for (int64_t i = 0; i < iterations; i++) {
+                     int64_t off = 0;
+                     int64_t numEncoded = Protocol::encodeFileChunksInfoList(
+                         listBuf.data(), off, listBuf.size(), 0,
+                         chunksInfoList);
+                     WDT_CHECK_EQ((int64_t)chunksInfoList.size(), numEncoded);
+                   }
+                 });
+  int64_t listLen = 0;
+  Protocol::encodeFileChunksInfoList(listBuf.data(), listLen, listBuf.size(), 0,
+                                     chunksInfoList);
+  benchmarks.run("Protocol::decodeFileChunksInfoList(100x10)", 1, 0,
+                 [&](int64_t iterations) {
+                   for (int64_t i = 0; i < iterations; i++) {
+                     int64_t off = 0;
+                     std::vector<FileChunksInfo> decoded;
+                     WDT_CHECK(Protocol::decodeFileChunksInfoList(
+                         listBuf.data(), off, listLen, decoded));
+                     doNotOptimizeAway(decoded);
+                   }
+                 });
+}
+
+static void throttlerBenchmarks(MicroBenchmarks &benchmarks,
+                                const WdtOptions &options) {
+  // rates high enough to never sleep: this measures the bookkeeping and the
+  // lock contention
+  std::shared_ptr<Throttler> throttler =
+      Throttler::makeThrottler(1e15, 1e15, 1e15, 0);
+  throttler->registerTransfer();
+  for (int numThreads : {1, FLAGS_num_threads}) {
+    benchmarks.run("Throttler::limit", numThreads, 0, [&](int64_t iterations) {
+      ThreadCtx threadCtx(options, false, 0);
+      for (int64_t i = 0; i < iterations; i++) {
+        throttler->limit(threadCtx, 1024 * 1024);
+      }
+    });
+  }
+  throttler->deRegisterTransfer();
+}
+
+static void queueBenchmarks(MicroBenchmarks &benchmarks,
+                            const WdtOptions &options) {
+  // fd based sources so that dequeuing does not open files
+  char path[] = "/tmp/wdt_micro_benchmark.XXXXXX";
+  int fd = mkstemp(path);
+  WDT_CHECK_GE(fd, 0);
+  unlink(path);
+  std::vector<WdtFileInfo> fileInfo;
+  for (int i = 0; i < 10000; i++) {
+    fileInfo.emplace_back(fd, 1024, folly::to<std::string>("file_", i));
+  }
+  std::atomic<bool> abort{false};
+  WdtAbortChecker abortChecker(abort);
+  DirectorySourceQueue queue(options, "/", &abortChecker);
+  queue.setFileInfo(fileInfo);
+  WDT_CHECK(queue.buildQueueSynchronously());
+  for (int numThreads : {1, FLAGS_num_threads}) {
+    benchmarks.run("DirectorySourceQueue::getNextSource+returnToQueue",
+                   numThreads, 0, [&](int64_t iterations) {
+                     ThreadCtx threadCtx(options, false, 0);
+                     threadCtx.setAbortChecker(&abortChecker);
+                     for (int64_t i = 0; i < iterations; i++) {
+                       ErrorCode status;
+                       std::unique_ptr<ByteSource> source =
+                           queue.getNextSource(&threadCtx, status);
+                       WDT_CHECK(source);
+                       queue.returnToQueue(source);
+                     }
+                   });
+  }
+  ::close(fd);
+}
+
+static void checksumAndCryptoBenchmarks(MicroBenchmarks &benchmarks) {
+  for (int64_t size : {4 * 1024, 64 * 1024, 1024 * 1024}) {
+    std::vector<char> in(size, 'a');
+    std::vector<char> out(size);
+    const std::string sizeStr = folly::to<std::string>("(", size, ")");
+    benchmarks.run("crc32c" + sizeStr, 1, size, [&](int64_t iterations) {
+      uint32_t checksum = 0;
+      for (int64_t i = 0; i < iterations; i++) {
+        checksum =
+            folly::crc32c((const uint8_t *)in.data(), in.size(), checksum);
+      }
+      doNotOptimizeAway(checksum);
+    });
+    for (EncryptionType type : {ENC_AES128_CTR, ENC_AES128_GCM}) {
+      const EncryptionParams params =
+          EncryptionParams::generateEncryptionParams(type);
+      const std::string typeStr = encryptionTypeToStr(type);
+      std::string iv;
+      {
+        AESEncryptor encryptor;
+        WDT_CHECK(encryptor.start(params, iv));
+      }
+      benchmarks.run("AESEncryptor::encrypt/" + typeStr + sizeStr, 1, size,
+                     [&](int64_t iterations) {
+                       AESEncryptor encryptor;
+                       WDT_CHECK(encryptor.start(params, iv));
+                       for (int64_t i = 0; i < iterations; i++) {
+                         WDT_CHECK(encryptor.encrypt(in.data(), size,
+                                                     out.data()));
+                       }
+                       std::string tag;
+                       WDT_CHECK(encryptor.finish(tag));
+                     });
+      benchmarks.run("AESDecryptor::decrypt/" + typeStr + sizeStr, 1, size,
+                     [&](int64_t iterations) {
+                       AESDecryptor decryptor;
+                       WDT_CHECK(decryptor.start(params, iv));
+                       for (int64_t i = 0; i < iterations; i++) {
+                         WDT_CHECK(decryptor.decrypt(out.data(), size,
+                                                     in.data()));
+                       }
+                       // the stream is not a real ciphertext, so the gcm tag
+                       // check at destruction fails (and logs), by design
+                     });
+    }
+  }
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  using namespace facebook::wdt;
+  const WdtOptions &options = WdtOptions::get();
+  MicroBenchmarks benchmarks;
+  benchmarks.begin();
+  protocolBenchmarks(benchmarks);
+  throttlerBenchmarks(benchmarks, options);
+  queueBenchmarks(benchmarks, options);
+  checksumAndCryptoBenchmarks(benchmarks);
+  std::cout << benchmarks.end() << std::endl;
+  return 0;
+}
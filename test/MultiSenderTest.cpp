@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include "TestCommon.h"
+
+#include <wdt/MultiSender.h>
+#include <wdt/Receiver.h>
+#include <wdt/util/WdtFlags.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+namespace facebook {
+namespace wdt {
+
+const int kNumFiles = 5;
+
+static std::string fileName(int index) {
+  return "file" + std::to_string(index);
+}
+
+static std::string readFile(const std::string &path) {
+  std::ifstream fin(path);
+  std::stringstream content;
+  content << fin.rdbuf();
+  return content.str();
+}
+
+class MultiSenderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto &opts = WdtOptions::getMutable();
+    opts.enable_download_resumption = false;
+    opts.block_size_mbytes = 1;
+    // blocks are dropped from the shared buffer as well
+    opts.shared_read_buffer_mbytes = 2;
+    opts.max_retries = 3;
+    opts.sleep_millis = 10;
+    char dirTemplate[] = "/tmp/wdtMultiSenderXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    rootDir_ = dirTemplate;
+    srcDir_ = rootDir_ + "/src/";
+    ASSERT_EQ(0, mkdir(srcDir_.c_str(), 0755));
+    for (int i = 0; i < kNumFiles; i++) {
+      std::string content;
+      const int64_t size = (i + 1) * 700 * 1024 + i;
+      for (int64_t j = 0; j < size; j++) {
+        content.push_back('a' + rand32() % 26);
+      }
+      std::ofstream(srcDir_ + fileName(i)) << content;
+    }
+  }
+
+  void TearDown() override {
+    const std::string cmd = "rm -rf " + rootDir_;
+    EXPECT_EQ(0, system(cmd.c_str()));
+  }
+
+  /// starts a receiver, @return the request to send the source to it
+  WdtTransferRequest startReceiver(const std::string &name) {
+    WdtTransferRequest req(/* start port */ 0, /* num ports */ 2,
+                           rootDir_ + "/" + name);
+    receivers_.emplace_back(new Receiver(req));
+    req = receivers_.back()->init();
+    EXPECT_EQ(OK, req.errorCode);
+    EXPECT_EQ(OK, receivers_.back()->transferAsync());
+    req.directory = srcDir_;
+    return req;
+  }
+
+  void expectReceived(const std::string &name) {
+    for (int i = 0; i < kNumFiles; i++) {
+      EXPECT_EQ(readFile(srcDir_ + fileName(i)),
+                readFile(rootDir_ + "/" + name + "/" + fileName(i)))
+          << name << " " << fileName(i);
+    }
+  }
+
+  std::string rootDir_;
+  std::string srcDir_;
+  std::vector<std::unique_ptr<Receiver>> receivers_;
+};
+
+TEST_F(MultiSenderTest, AllDestinations) {
+  std::vector<WdtTransferRequest> requests;
+  requests.push_back(startReceiver("dst1"));
+  requests.push_back(startReceiver("dst2"));
+  MultiSender multiSender(requests);
+  EXPECT_EQ(OK, multiSender.transferAsync());
+  auto reports = multiSender.finish();
+  ASSERT_EQ(2, reports.size());
+  for (auto &report : reports) {
+    EXPECT_EQ(OK, report->getSummary().getErrorCode());
+  }
+  for (auto &receiver : receivers_) {
+    EXPECT_EQ(OK, receiver->finish()->getSummary().getErrorCode());
+  }
+  expectReceived("dst1");
+  expectReceived("dst2");
+}
+
+TEST_F(MultiSenderTest, FailedDestination) {
+  std::vector<WdtTransferRequest> requests;
+  requests.push_back(startReceiver("dst1"));
+  {
+    // nobody listens on the ports of this one anymore
+    WdtTransferRequest req(/* start port */ 0, /* num ports */ 2,
+                           rootDir_ + "/gone");
+    Receiver receiver(req);
+    req = receiver.init();
+    ASSERT_EQ(OK, req.errorCode);
+    req.directory = srcDir_;
+    requests.push_back(req);
+  }
+  requests.push_back(startReceiver("dst3"));
+  MultiSender multiSender(requests);
+  multiSender.transferAsync();
+  auto reports = multiSender.finish();
+  ASSERT_EQ(3, reports.size());
+  EXPECT_EQ(OK, reports[0]->getSummary().getErrorCode());
+  EXPECT_NE(OK, reports[1]->getSummary().getErrorCode());
+  EXPECT_EQ(OK, reports[2]->getSummary().getErrorCode());
+  for (auto &receiver : receivers_) {
+    EXPECT_EQ(OK, receiver->finish()->getSummary().getErrorCode());
+  }
+  // the others got every block although the failed one never read them
+  expectReceived("dst1");
+  expectReceived("dst3");
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  facebook::wdt::WdtFlags::initializeFromFlags();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/OpenMetricsSerializer.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace wdt {
+
+TEST(OpenMetricsSerializer, Samples) {
+  OpenMetricsSerializer serializer;
+  MetricLabels labels = {{"id", "a\"b\\c"}};
+  serializer.addSample("wdt_blocks", OpenMetricsSerializer::COUNTER,
+                       "Blocks", labels, 12);
+  serializer.addSample("wdt_rate", OpenMetricsSerializer::GAUGE, "Rate", {},
+                       1.5);
+  serializer.addSample("wdt_blocks", OpenMetricsSerializer::COUNTER,
+                       "Blocks", {{"id", "d"}}, 3);
+  EXPECT_EQ(
+      "# HELP wdt_blocks Blocks\n"
+      "# TYPE wdt_blocks counter\n"
+      "wdt_blocks_total{id=\"a\\\"b\\\\c\"} 12\n"
+      "wdt_blocks_total{id=\"d\"} 3\n"
+      "# HELP wdt_rate Rate\n"
+      "# TYPE wdt_rate gauge\n"
+      "wdt_rate 1.5\n"
+      "# EOF\n",
+      serializer.serialize());
+}
+
+TEST(OpenMetricsSerializer, Histogram) {
+  Histogram histogram;
+  histogram.record(5);         // 5us
+  histogram.record(500);       // 0.5ms
+  histogram.record(50000);     // 50ms
+  histogram.record(2000000);   // 2s
+  histogram.record(50000000);  // 50s
+  OpenMetricsSerializer serializer;
+  serializer.addHistogram("wdt_perf_seconds", "Perf", {{"stat", "fsync"}},
+                          histogram);
+  EXPECT_EQ(
+      "# HELP wdt_perf_seconds Perf\n"
+      "# TYPE wdt_perf_seconds histogram\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"1e-05\"} 1\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"0.0001\"} 1\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"0.001\"} 2\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"0.01\"} 2\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"0.1\"} 3\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"1\"} 3\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"10\"} 4\n"
+      "wdt_perf_seconds_bucket{stat=\"fsync\",le=\"+Inf\"} 5\n"
+      "wdt_perf_seconds_sum{stat=\"fsync\"} 52.050505\n"
+      "wdt_perf_seconds_count{stat=\"fsync\"} 5\n"
+      "# EOF\n",
+      serializer.serialize());
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
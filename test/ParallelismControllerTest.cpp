@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ParallelismController.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+TEST(ParallelismController, GrowsWhileImproving) {
+  ParallelismController controller(4, 0.05);
+  EXPECT_EQ(1, controller.getNumActive());
+  EXPECT_TRUE(controller.waitForActivation(0, nullptr));
+  EXPECT_TRUE(controller.wasActivated(0));
+  EXPECT_FALSE(controller.wasActivated(1));
+
+  controller.update({100, 0, 0, 0}, true, false);
+  EXPECT_EQ(2, controller.getNumActive());
+  EXPECT_TRUE(controller.waitForActivation(1, nullptr));
+  controller.update({100, 100, 0, 0}, true, false);
+  EXPECT_EQ(3, controller.getNumActive());
+  // third connection did not help, can not retire during discovery
+  controller.update({70, 70, 62, 0}, true, false);
+  EXPECT_EQ(3, controller.getNumActive());
+  EXPECT_FALSE(controller.wasActivated(3));
+  // slowest one is retired once allowed
+  controller.update({70, 70, 62, 0}, true, true);
+  EXPECT_EQ(2, controller.getNumActive());
+  EXPECT_TRUE(controller.isRetired(2));
+  EXPECT_FALSE(controller.isRetired(0));
+  EXPECT_FALSE(controller.isRetired(1));
+}
+
+TEST(ParallelismController, NoGrowthWithoutWork) {
+  ParallelismController controller(2, 0.05);
+  controller.update({100, 0}, false, false);
+  EXPECT_EQ(1, controller.getNumActive());
+  for (int i = 0; i < 20; i++) {
+    controller.update({100, 0}, false, true);
+  }
+  EXPECT_EQ(1, controller.getNumActive());
+  // never retires the last connection
+  EXPECT_FALSE(controller.isRetired(0));
+}
+
+TEST(ParallelismController, Reprobe) {
+  ParallelismController controller(3, 0.05);
+  controller.update({100, 0, 0}, true, true);
+  EXPECT_EQ(2, controller.getNumActive());
+  controller.update({50, 50, 0}, true, true);
+  // second connection did not help and got retired
+  EXPECT_EQ(1, controller.getNumActive());
+  int numUpdates = 0;
+  while (controller.getNumActive() == 1 && numUpdates < 100) {
+    controller.update({100, 0, 0}, true, true);
+    numUpdates++;
+  }
+  // tries again after a while, with a connection not used yet
+  EXPECT_EQ(2, controller.getNumActive());
+  EXPECT_GT(numUpdates, 1);
+  EXPECT_TRUE(controller.wasActivated(2));
+}
+
+TEST(ParallelismController, StandbyRelease) {
+  ParallelismController controller(3, 0.05);
+  bool activated = false;
+  std::thread standby(
+      [&] { activated = controller.waitForActivation(1, nullptr); });
+  controller.update({100, 0, 0}, true, false);
+  standby.join();
+  EXPECT_TRUE(activated);
+
+  // remaining standby connection is released once the others are done
+  controller.markEnded(0);
+  std::thread last(
+      [&] { activated = controller.waitForActivation(2, nullptr); });
+  controller.markEnded(1);
+  last.join();
+  EXPECT_FALSE(activated);
+  EXPECT_FALSE(controller.wasActivated(2));
+}
+
+TEST(ParallelismController, ActivateAll) {
+  ParallelismController controller(3, 0.05);
+  controller.markEnded(2);
+  controller.activateAll();
+  EXPECT_EQ(2, controller.getNumActive());
+  EXPECT_TRUE(controller.waitForActivation(1, nullptr));
+  // ended before getting used
+  EXPECT_FALSE(controller.wasActivated(2));
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -95,6 +95,129 @@ void testHeader() {
   EXPECT_FALSE(success);
 }
 
+void testHeaderWithDictionary() {
+  const int version = Protocol::FILE_NAME_DICTIONARY_VERSION;
+  FileNameDictionary senderDictionary;
+  FileNameDictionary receiverDictionary;
+  BlockDetails bd;
+  bd.fileName = "dir/abcdef";
+  bd.seqId = 3;
+  bd.dataSize = 3;
+  bd.offset = 0;
+  bd.fileSize = 10;
+  bd.allocationStatus = EXISTS_CORRECT_SIZE;
+
+  // first block of a file carries the name and the file size
+  char buf[128];
+  int64_t off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd,
+                         &senderDictionary);
+  // 1 byte variant for seqId, size, offset, flags, prefix, suffix length and
+  // file size
+  EXPECT_EQ(off, bd.fileName.size() + 7);
+  BlockDetails nbd;
+  int64_t noff = 0;
+  LOG(INFO) << "error tests, expect errors";
+  EXPECT_FALSE(Protocol::decodeHeader(version, buf, noff, off - 1, nbd,
+                                      &receiverDictionary));
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(noff, off);
+  EXPECT_EQ(nbd.fileName, bd.fileName);
+  EXPECT_EQ(nbd.seqId, bd.seqId);
+  EXPECT_EQ(nbd.fileSize, bd.fileSize);
+  EXPECT_EQ(nbd.allocationStatus, bd.allocationStatus);
+
+  // next block of the same file only has the seq-id
+  bd.offset = 3;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd,
+                         &senderDictionary);
+  EXPECT_EQ(off, 4);
+  noff = 0;
+  nbd = BlockDetails();
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(noff, off);
+  EXPECT_EQ(nbd.fileName, bd.fileName);
+  EXPECT_EQ(nbd.fileSize, bd.fileSize);
+  EXPECT_EQ(nbd.offset, bd.offset);
+
+  // a header without name can not be decoded on a new connection
+  FileNameDictionary newDictionary;
+  noff = 0;
+  EXPECT_FALSE(
+      Protocol::decodeHeader(version, buf, noff, off, nbd, &newDictionary));
+
+  // new file, front coded against the previous name
+  BlockDetails bd2 = bd;
+  bd2.fileName = "dir/abcxyz";
+  bd2.seqId = 4;
+  bd2.offset = 0;
+  bd2.fileSize = 100;
+  bd2.allocationStatus = EXISTS_TOO_SMALL;
+  bd2.prevSeqId = 10;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd2,
+                         &senderDictionary);
+  EXPECT_EQ(off, 3 + 7 + 1);  // "xyz", 7 single byte fields, prev seq-id
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(noff, off);
+  EXPECT_EQ(nbd.fileName, bd2.fileName);
+  EXPECT_EQ(nbd.seqId, bd2.seqId);
+  EXPECT_EQ(nbd.fileSize, bd2.fileSize);
+  EXPECT_EQ(nbd.allocationStatus, bd2.allocationStatus);
+  EXPECT_EQ(nbd.prevSeqId, bd2.prevSeqId);
+
+  // previous file is still known
+  bd.offset = 6;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd,
+                         &senderDictionary);
+  EXPECT_EQ(off, 4);
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(nbd.fileName, bd.fileName);
+  EXPECT_EQ(nbd.seqId, bd.seqId);
+  EXPECT_EQ(nbd.prevSeqId, 0);
+
+  // evicted by a colliding seq-id, the name is sent again
+  bd2.seqId = bd.seqId + FileNameDictionary::kNumSlots;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd2,
+                         &senderDictionary);
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  bd.offset = 9;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd,
+                         &senderDictionary);
+  EXPECT_EQ(off, 3 + 7);  // prefix "dir/abc", suffix "def"
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(nbd.fileName, bd.fileName);
+  EXPECT_EQ(nbd.fileSize, bd.fileSize);
+
+  // size known at the end of a stream, the name and size are sent again
+  bd.offset = 12;
+  bd.fileSize = 14;
+  off = 0;
+  Protocol::encodeHeader(version, buf, off, sizeof(buf), bd,
+                         &senderDictionary);
+  EXPECT_EQ(off, 7);  // whole name in common with the last one
+  noff = 0;
+  EXPECT_TRUE(Protocol::decodeHeader(version, buf, noff, off, nbd,
+                                     &receiverDictionary));
+  EXPECT_EQ(nbd.fileName, bd.fileName);
+  EXPECT_EQ(nbd.fileSize, bd.fileSize);
+}
+
 void testFileChunksInfo() {
   FileChunksInfo fileChunksInfo;
   fileChunksInfo.setSeqId(10);
@@ -152,11 +275,54 @@ void testSettings() {
   EXPECT_EQ(nsettings.enableChecksum, settings.enableChecksum);
   EXPECT_EQ(nsettings.sendFileChunks, settings.sendFileChunks);
   EXPECT_EQ(nsettings.blockModeDisabled, settings.blockModeDisabled);
+  EXPECT_FALSE(nsettings.keepConnection);
+
+  // keep connection flag is only sent from CONNECTION_REUSE_VERSION onwards,
+  // dynamic parallelism from DYNAMIC_PARALLELISM_VERSION
+  settings.keepConnection = settings.dynamicParallelism = true;
+  for (int version : {Protocol::CONNECTION_REUSE_VERSION - 1,
+                      Protocol::CONNECTION_REUSE_VERSION,
+                      Protocol::DYNAMIC_PARALLELISM_VERSION}) {
+    off = 0;
+    Protocol::encodeSettings(version, buf, off, sizeof(buf), settings);
+    noff = 0;
+    EXPECT_TRUE(
+        Protocol::decodeVersion(buf, noff, off, nsenderProtocolVersion));
+    EXPECT_EQ(version, nsenderProtocolVersion);
+    EXPECT_TRUE(Protocol::decodeSettings(version, buf, noff, off, nsettings));
+    EXPECT_EQ(noff, off);
+    EXPECT_EQ(version >= Protocol::CONNECTION_REUSE_VERSION,
+              nsettings.keepConnection);
+    EXPECT_EQ(version >= Protocol::DYNAMIC_PARALLELISM_VERSION,
+              nsettings.dynamicParallelism);
+    EXPECT_TRUE(nsettings.blockModeDisabled);
+  }
+}
+
+void testConnectionCmd() {
+  char buf[Protocol::kConnectionCmdLen];
+  int64_t off = 0;
+  Protocol::encodeConnectionCmd(buf, off, 22357);
+  const int64_t expectedLen = Protocol::kConnectionCmdLen;
+  EXPECT_EQ(expectedLen, off);
+  int64_t noff = 0;
+  int32_t key = 0;
+  EXPECT_TRUE(Protocol::decodeConnectionCmd(buf, noff, key));
+  EXPECT_EQ(off, noff);
+  EXPECT_EQ(22357, key);
+
+  // anything else than a connection cmd is rejected
+  buf[0] = Protocol::SETTINGS_CMD;
+  noff = 0;
+  EXPECT_FALSE(Protocol::decodeConnectionCmd(buf, noff, key));
+  EXPECT_EQ(0, noff);
 }
 
 TEST(Protocol, Simple) {
   testHeader();
+  testHeaderWithDictionary();
   testSettings();
+  testConnectionCmd();
   testFileChunksInfo();
 }
 }
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ReaderByteSource.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace wdt {
+
+TEST(MemorySourceReader, ReadsAcrossSegments) {
+  std::string first("hello "), second("wdt"), third(" world");
+  std::vector<struct iovec> segments(3);
+  segments[0].iov_base = &first[0];
+  segments[0].iov_len = first.size();
+  segments[1].iov_base = &second[0];
+  segments[1].iov_len = second.size();
+  segments[2].iov_base = &third[0];
+  segments[2].iov_len = third.size();
+  MemorySourceReader reader(segments);
+  EXPECT_EQ(15, reader.getSize());
+  char buf[16];
+  EXPECT_EQ(5, reader.read(4, buf, 5));
+  EXPECT_EQ("o wdt", std::string(buf, 5));
+  EXPECT_EQ(15, reader.read(0, buf, 15));
+  EXPECT_EQ("hello wdt world", std::string(buf, 15));
+  EXPECT_GT(0, reader.read(10, buf, 6));
+}
+
+TEST(ReaderByteSource, ReadsBlockInBufferChunks) {
+  std::string content(1000, 'a');
+  for (size_t i = 0; i < content.size(); i++) {
+    content[i] = 'a' + i % 26;
+  }
+  auto reader = std::make_shared<MemorySourceReader>(
+      std::make_shared<const std::string>(content));
+  SourceMetaData metadata;
+  metadata.relPath = "snapshot";
+  metadata.size = content.size();
+  WdtOptions options;
+  options.buffer_size = 256;
+  ThreadCtx threadCtx(options, true);
+  ReaderByteSource source(&metadata, reader, 600, 300);
+  ASSERT_EQ(OK, source.open(&threadCtx));
+  std::string read;
+  int64_t size;
+  while (char *data = source.read(size)) {
+    EXPECT_LE(size, 256);
+    read.append(data, size);
+  }
+  EXPECT_TRUE(source.finished());
+  EXPECT_EQ(content.substr(300, 600), read);
+
+  // retried from a checkpoint
+  source.advanceOffset(100);
+  ASSERT_EQ(OK, source.open(&threadCtx));
+  read.clear();
+  while (char *data = source.read(size)) {
+    read.append(data, size);
+  }
+  EXPECT_EQ(content.substr(400, 500), read);
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/SharedBlockCache.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+TEST(SharedBlockCache, ReadOnceForAll) {
+  SharedBlockCache cache(3, 1000);
+  SharedBlockCache::BlockData data;
+  EXPECT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "a", 0, 100, data));
+  ASSERT_EQ(100, data->size());
+  (*data)[0] = 'x';
+  cache.loaded("a", 0, true);
+  EXPECT_EQ(100, cache.getNumBytes());
+  SharedBlockCache::BlockData other;
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", 0, 100, other));
+  EXPECT_EQ('x', (*other)[0]);
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(2, "a", 0, 100, other));
+  // every destination got it
+  EXPECT_EQ(0, cache.getNumBytes());
+  EXPECT_EQ(0, cache.getNumBlocks());
+}
+
+TEST(SharedBlockCache, SlowDestinationBypasses) {
+  SharedBlockCache cache(2, 250);
+  SharedBlockCache::BlockData data;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(SharedBlockCache::LOAD,
+              cache.acquire(0, "a", i * 100, 100, data));
+    cache.loaded("a", i * 100, true);
+  }
+  // first block was dropped to make room for the third
+  EXPECT_EQ(200, cache.getNumBytes());
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(1, "a", 0, 100, data));
+  EXPECT_EQ(0, cache.getNumDroppedBlocks());
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", 100, 100, data));
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", 200, 100, data));
+  EXPECT_EQ(0, cache.getNumBytes());
+  // too large to be shared
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(0, "b", 0, 300, data));
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(1, "b", 0, 300, data));
+}
+
+TEST(SharedBlockCache, FailedLoad) {
+  SharedBlockCache cache(2, 1000);
+  SharedBlockCache::BlockData data;
+  EXPECT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "a", 0, 100, data));
+  SharedBlockCache::LookupResult result = SharedBlockCache::HIT;
+  std::thread waiter([&] {
+    SharedBlockCache::BlockData other;
+    result = cache.acquire(1, "a", 0, 100, other);
+  });
+  cache.loaded("a", 0, false);
+  waiter.join();
+  // whether it waited or not, the other destination reads by itself
+  EXPECT_EQ(SharedBlockCache::BYPASS, result);
+  EXPECT_EQ(0, cache.getNumBytes());
+  EXPECT_EQ(0, cache.getNumBlocks());
+}
+
+TEST(SharedBlockCache, DroppedBlocksLeaveTheOrder) {
+  SharedBlockCache cache(2, 250);
+  SharedBlockCache::BlockData data;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "a", i, 100, data));
+    cache.loaded("a", i, true);
+    ASSERT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", i, 100, data));
+  }
+  EXPECT_EQ(0, cache.getNumBlocks());
+  // the same key loaded again is dropped on its own, not as an older block
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "b", 0, 100, data));
+    cache.loaded("b", 0, true);
+    ASSERT_EQ(SharedBlockCache::HIT, cache.acquire(1, "b", 0, 100, data));
+  }
+  EXPECT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "c", 0, 200, data));
+  cache.loaded("c", 0, true);
+  EXPECT_EQ(SharedBlockCache::LOAD, cache.acquire(0, "c", 200, 50, data));
+  cache.loaded("c", 200, true);
+  EXPECT_EQ(2, cache.getNumBlocks());
+  EXPECT_EQ(250, cache.getNumBytes());
+}
+
+TEST(SharedBlockCache, RemovedDestination) {
+  SharedBlockCache cache(3, 250);
+  SharedBlockCache::BlockData data;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(SharedBlockCache::LOAD,
+              cache.acquire(0, "a", i * 100, 100, data));
+    cache.loaded("a", i * 100, true);
+  }
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", 100, 100, data));
+  // destination 2 ends without reading anything
+  EXPECT_EQ(1, cache.getNumDroppedBlocks());
+  cache.removeConsumer(2);
+  EXPECT_EQ(1, cache.getNumDroppedBlocks());
+  EXPECT_EQ(100, cache.getNumBytes());
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(1, "a", 0, 100, data));
+  EXPECT_EQ(SharedBlockCache::HIT, cache.acquire(1, "a", 200, 100, data));
+  EXPECT_EQ(0, cache.getNumDroppedBlocks());
+  EXPECT_EQ(0, cache.getNumBytes());
+  // a block dropped for the removed destination only is forgotten
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(0, "b", 0, 300, data));
+  EXPECT_EQ(1, cache.getNumDroppedBlocks());
+  cache.removeConsumer(1);
+  EXPECT_EQ(0, cache.getNumDroppedBlocks());
+  // alone, the last destination reads by itself
+  EXPECT_EQ(SharedBlockCache::BYPASS, cache.acquire(0, "c", 0, 100, data));
+  EXPECT_EQ(0, cache.getNumBytes());
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
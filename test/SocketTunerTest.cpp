@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ClientSocket.h>
+#include <wdt/util/CommonImpl.h>
+#include <wdt/util/SocketTuner.h>
+
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+TEST(SocketTuner, BufferSize) {
+  const int64_t maxSize = 64 * 1024 * 1024;
+  // 100 Mbytes/sec with 50ms rtt: 5 Mbytes in flight
+  EXPECT_EQ(10 * 1000 * 1000,
+            SocketTuner::computeBufferSize(100 * 1000 * 1000, 50 * 1000,
+                                           maxSize));
+  // lan: never below the minimum
+  EXPECT_EQ(SocketTuner::kMinBufferSize,
+            SocketTuner::computeBufferSize(100 * 1000 * 1000, 100, maxSize));
+  // long fat pipe: capped
+  EXPECT_EQ(maxSize, SocketTuner::computeBufferSize(1e10, 200 * 1000,
+                                                    maxSize));
+}
+
+/// connects fds[0] to fds[1] over loopback tcp
+static void makeConnection(int fds[2]) {
+  int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listenFd, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLen = sizeof(addr);
+  ASSERT_EQ(0, bind(listenFd, (struct sockaddr *)&addr, addrLen));
+  ASSERT_EQ(0, listen(listenFd, 1));
+  ASSERT_EQ(0, getsockname(listenFd, (struct sockaddr *)&addr, &addrLen));
+  fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(0, connect(fds[0], (struct sockaddr *)&addr, addrLen));
+  fds[1] = accept(listenFd, nullptr, nullptr);
+  ASSERT_GE(fds[1], 0);
+  ::close(listenFd);
+}
+
+TEST(SocketTuner, RealSocket) {
+  const int64_t autotuneMaxSize = SocketTuner::getAutotuneMaxSize(true);
+  const int64_t settableMaxSize = SocketTuner::getSettableMaxSize(true);
+  LOG(INFO) << "Autotune max " << autotuneMaxSize << " settable max "
+            << settableMaxSize;
+  // below and (unless capped by the sysctl) above the autotuning max
+  for (int64_t maxSize : {SocketTuner::kMinBufferSize,
+                          std::max<int64_t>(autotuneMaxSize, 0) + 1024}) {
+    WdtOptions options;
+    options.auto_tune_buffers = true;
+    options.auto_tune_interval_millis = 0;
+    options.auto_tune_max_buffer_size = maxSize;
+    ThreadCtx threadCtx(options, /* allocate buffer */ false);
+    int fds[2];
+    makeConnection(fds);
+    ClientSocket socket(threadCtx, "localhost", 0, EncryptionParams());
+    socket.adoptConnection(fds[0], "127.0.0.1");
+    SocketTuner tuner(options, /* sender */ true);
+    tuner.start(socket, 0, 0);
+    // some acked data for the rtt
+    char buf[16 * 1024] = {0};
+    ASSERT_EQ(sizeof(buf), ::write(fds[0], buf, sizeof(buf)));
+    int64_t numRead = 0;
+    while (numRead < (int64_t)sizeof(buf)) {
+      const int64_t ret = ::read(fds[1], buf, sizeof(buf));
+      ASSERT_GT(ret, 0);
+      numRead += ret;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_GT(socket.getRttMicros(), 0);
+
+    const int64_t curSize = socket.getSendBufferSize();
+    // fast enough for any rtt to need the max size
+    tuner.onProgress(socket, 1LL << 40);
+    // the kernel reports twice the size set
+    const int64_t kernelSize =
+        2 * (settableMaxSize > 0 ? std::min(maxSize, settableMaxSize)
+                                 : maxSize);
+    if (kernelSize > std::max(curSize, autotuneMaxSize)) {
+      EXPECT_EQ(kernelSize, socket.getSendBufferSize()) << maxSize;
+    } else {
+      // left to the kernel autotuning
+      EXPECT_EQ(curSize, socket.getSendBufferSize()) << maxSize;
+    }
+    ::close(fds[1]);
+  }
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/TraceBuffer.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace facebook {
+namespace wdt {
+
+TEST(TraceBuffer, RingOverwritesOldest) {
+  TraceBuffer buffer(4);
+  EXPECT_EQ(0, buffer.getNumEvents());
+  Clock::time_point start = Clock::now();
+  for (int64_t i = 0; i < 10; i++) {
+    buffer.addEvent("block", start, start + std::chrono::microseconds(i), i);
+  }
+  EXPECT_EQ(4, buffer.getNumEvents());
+  EXPECT_EQ(6, buffer.getNumDropped());
+  for (int64_t i = 0; i < 4; i++) {
+    const TraceEvent &event = buffer.getEvent(i);
+    EXPECT_EQ(6 + i, event.arg);
+    EXPECT_EQ(6 + i, event.durationMicros);
+    EXPECT_STREQ("block", event.name);
+  }
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  return RUN_ALL_TESTS();
+}
@@ -131,6 +131,18 @@ TEST(RequestSerializationTest, UrlTests) {
       EXPECT_EQ(transferRequest.ports,
                 WdtTransferRequest::genPortsVector(24689, 3));
     }
+    {
+      uri = "wdt://[::1]:24689?num_ports=3&single_port=1";
+      WdtTransferRequest transferRequest(uri.generateUrl());
+      EXPECT_EQ(transferRequest.errorCode, OK);
+      EXPECT_TRUE(transferRequest.singlePort);
+      EXPECT_EQ(transferRequest.ports,
+                WdtTransferRequest::genPortsVector(24689, 3));
+      WdtTransferRequest dup(transferRequest.genWdtUrlWithSecret());
+      EXPECT_EQ(dup, transferRequest);
+      transferRequest.singlePort = false;
+      EXPECT_FALSE(dup == transferRequest);
+    }
     {
       uri = "wdt://[::1]?num_ports=10";  // missing port
       WdtTransferRequest transferRequest(uri.generateUrl());
@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include "FlakySocketCreator.h"
+#include "TestCommon.h"
+
+#include <wdt/Receiver.h>
+#include <wdt/Sender.h>
+#include <wdt/Writer.h>
+#include <wdt/util/WdtFlags.h>
+
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+
+namespace facebook {
+namespace wdt {
+
+/// Receives files in memory and records the verified ranges
+class MemorySink : public WriterFactory {
+ public:
+  class MemoryWriter : public Writer {
+   public:
+    MemoryWriter(MemorySink &sink, const BlockDetails &blockDetails)
+        : sink_(sink),
+          fileName_(blockDetails.fileName),
+          offset_(blockDetails.offset) {
+    }
+
+    ErrorCode open() override {
+      return OK;
+    }
+
+    ErrorCode write(char *buf, int64_t size) override {
+      sink_.write(fileName_, offset_ + totalWritten_, buf, size);
+      totalWritten_ += size;
+      return OK;
+    }
+
+    int64_t getTotalWritten() override {
+      return totalWritten_;
+    }
+
+    void close() override {
+    }
+
+   private:
+    MemorySink &sink_;
+    const std::string fileName_;
+    const int64_t offset_;
+    int64_t totalWritten_{0};
+  };
+
+  std::unique_ptr<Writer> makeWriter(
+      ThreadCtx & /* unused */, const BlockDetails &blockDetails) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    numWriters_++;
+    return folly::make_unique<MemoryWriter>(*this, blockDetails);
+  }
+
+  void onBlockVerified(const BlockDetails &blockDetails) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    verified_[blockDetails.fileName].emplace_back(blockDetails.offset,
+                                                  blockDetails.dataSize);
+  }
+
+  void write(const std::string &fileName, int64_t offset, const char *buf,
+             int64_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string &content = files_[fileName];
+    if (content.size() < offset + size) {
+      content.resize(offset + size);
+    }
+    content.replace(offset, size, buf, size);
+  }
+
+  /// expects the verified ranges to cover the file once
+  void expectVerifiedOnce(const std::string &fileName, int64_t fileSize) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto ranges = verified_[fileName];
+    std::sort(ranges.begin(), ranges.end());
+    int64_t end = 0;
+    for (const auto &range : ranges) {
+      EXPECT_EQ(end, range.first) << fileName;
+      end = range.first + range.second;
+    }
+    EXPECT_EQ(fileSize, end) << fileName;
+  }
+
+  std::mutex mutex_;
+  std::map<std::string, std::string> files_;
+  std::map<std::string, std::vector<std::pair<int64_t, int64_t>>> verified_;
+  int numWriters_{0};
+};
+
+class WriterFactoryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto &opts = WdtOptions::getMutable();
+    opts.enable_download_resumption = false;
+    // checkpoints resume blocks only without footers
+    opts.encryption_type = "none";
+    opts.enable_checksum = false;
+    opts.num_ports = 1;
+    char dirTemplate[] = "/tmp/wdtWriterFactoryXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dirTemplate));
+    rootDir_ = dirTemplate;
+    srcDir_ = rootDir_ + "/src/";
+    ASSERT_EQ(0, mkdir(srcDir_.c_str(), 0755));
+  }
+
+  void TearDown() override {
+    const std::string cmd = "rm -rf " + rootDir_;
+    EXPECT_EQ(0, system(cmd.c_str()));
+    auto &opts = WdtOptions::getMutable();
+    opts.avg_mbytes_per_sec = -1;
+    opts.max_mbytes_per_sec = 0;
+  }
+
+  void makeFile(const std::string &fileName, int64_t size) {
+    std::string content;
+    for (int64_t i = 0; i < size; i++) {
+      content.push_back('a' + rand32() % 26);
+    }
+    std::ofstream(srcDir_ + fileName) << content;
+    contents_[fileName] = content;
+  }
+
+  void transfer(Sender::ISocketCreator *socketCreator) {
+    // nothing is written there
+    WdtTransferRequest req(/* start port */ 0, /* num ports */ 1,
+                           rootDir_ + "/dst");
+    Receiver receiver(req);
+    receiver.setWriterFactory(sink_);
+    req = receiver.init();
+    ASSERT_EQ(OK, req.errorCode);
+    ASSERT_EQ(OK, receiver.transferAsync());
+    req.directory = srcDir_;
+    Sender sender(req);
+    if (socketCreator) {
+      sender.setSocketCreator(socketCreator);
+    }
+    EXPECT_EQ(OK, sender.transfer()->getSummary().getErrorCode());
+    EXPECT_EQ(OK, receiver.finish()->getSummary().getErrorCode());
+    for (const auto &pair : contents_) {
+      EXPECT_TRUE(sink_->files_[pair.first] == pair.second) << pair.first;
+      sink_->expectVerifiedOnce(pair.first, pair.second.size());
+    }
+  }
+
+  std::string rootDir_;
+  std::string srcDir_;
+  std::map<std::string, std::string> contents_;
+  std::shared_ptr<MemorySink> sink_{std::make_shared<MemorySink>()};
+};
+
+TEST_F(WriterFactoryTest, AllBlocksVerified) {
+  WdtOptions::getMutable().block_size_mbytes = 1;
+  makeFile("a", 3 * 1024 * 1024 + 100);
+  makeFile("b", 1000);
+  makeFile("empty", 0);
+  transfer(nullptr);
+  // 4 blocks, 1 block, 1 block
+  EXPECT_EQ(6, sink_->numWriters_);
+}
+
+TEST_F(WriterFactoryTest, RetriedBlockResumes) {
+  auto &opts = WdtOptions::getMutable();
+  opts.block_size_mbytes = 16;
+  // the connection breaks half way through the only block
+  opts.avg_mbytes_per_sec = 2;
+  opts.max_mbytes_per_sec = 2;
+  makeFile("a", 2 * 1024 * 1024);
+  FlakySocketCreator socketCreator;
+  transfer(&socketCreator);
+  EXPECT_TRUE(socketCreator.broken_);
+  // the retried block only carries the bytes after the checkpoint offset
+  EXPECT_EQ(2, sink_->numWriters_);
+  EXPECT_EQ(2, sink_->verified_["a"].size());
+}
+}
+}  // namespaces
+
+int main(int argc, char *argv[]) {
+  FLAGS_logtostderr = true;
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  facebook::wdt::WdtFlags::initializeFromFlags();
+  return RUN_ALL_TESTS();
+}
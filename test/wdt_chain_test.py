@@ -0,0 +1,83 @@
+#! /usr/bin/env python
+
+# Chain replication: sender -> receiver forwarding with -downstream_url ->
+# last receiver
+
+import os
+from common_utils import *
+
+def start_chain(test_name, first_extra_flags):
+    global wdtbin, test_count, root_dir
+    print("{0}. Testing {1}".format(test_count, test_name))
+    last_dir = "{0}/last{1}".format(root_dir, test_count)
+    (last_process, last_url) = start_receiver(
+        "{0} -directory {1} {2}".format(wdtbin, last_dir, receiver_flags),
+        root_dir, "{0}_last".format(test_count))
+    first_dir = "{0}/first{1}".format(root_dir, test_count)
+    first_cmd = "{0} -directory {1} {2} -downstream_url {3} {4}".format(
+        wdtbin, first_dir, receiver_flags, last_url, first_extra_flags)
+    (first_process, first_url) = start_receiver(first_cmd, root_dir,
+                                                test_count)
+    return (first_process, first_url, last_process)
+
+def run_chain(test_name, first_extra_flags, sender_extra_flags):
+    global wdtbin, test_count, root_dir, src_dir
+    (first_process, first_url, last_process) = start_chain(
+        test_name, first_extra_flags)
+    sender_cmd = "{0} -directory {1} -connection_url \'{2}\' {3}".format(
+        wdtbin, src_dir, first_url, sender_extra_flags)
+    sender_status = run_sender(sender_cmd, root_dir, test_count)
+    first_status = first_process.wait()
+    last_status = last_process.wait()
+    print("status for sender {0}, first receiver {1}, last receiver {2}".format(
+        sender_status, first_status, last_status))
+    test_count += 1
+    return (sender_status, first_status, last_status)
+
+def same_content(dir_name):
+    global root_dir, src_dir
+    src_md5 = "{0}/src.md5".format(root_dir)
+    dst_md5 = "{0}/{1}.md5".format(root_dir, dir_name)
+    create_md5_for_directory(src_dir, src_md5)
+    create_md5_for_directory("{0}/{1}".format(root_dir, dir_name), dst_md5)
+    return open(src_md5).read() == open(dst_md5).read()
+
+def error(what):
+    global broken
+    print("ERR {0}".format(what))
+    broken += 1
+
+wdtbin = os.getcwd() + "/_bin/wdt/wdt"
+receiver_flags = "-num_ports 2 -max_accept_retries 50"
+
+root_dir = create_test_directory("/tmp")
+src_dir = root_dir + "/src"
+generate_random_files(src_dir, 8 * 1024 * 1024)
+
+test_count = 1
+broken = 0
+
+statuses = run_chain("successful chain", "", "")
+if statuses != (0, 0, 0):
+    error("all the transfers should have worked")
+if not same_content("first1"):
+    error("first receiver should have all the files")
+if not same_content("last1"):
+    error("last receiver should have all the files")
+
+# the sender gives up half way, the rest of the chain must fail too rather
+# than complete with the blocks forwarded so far
+statuses = run_chain("failed upstream", "",
+                     "-avg_mbytes_per_sec 1 -abort_after_seconds 2")
+if statuses[0] == 0:
+    error("sender should have been aborted")
+if statuses[1] == 0:
+    error("first receiver should have failed")
+if statuses[2] == 0:
+    error("last receiver should have failed")
+
+print("Total issues {0}".format(broken))
+if not broken:
+    print("Good run, deleting logs in " + root_dir)
+    shutil.rmtree(root_dir)
+exit(broken)
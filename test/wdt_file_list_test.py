@@ -28,6 +28,9 @@ def run_test(name, sender_extra_flags, fail_transfer=False):
     else:
         check_transfer_status(transfer_status, root_dir, test_count)
     fail_errors = ["PROTOCOL_ERROR", "Bad file descriptor"]
+    if fail_transfer is not True:
+        # the deadlines of the manifest are long enough to be met
+        fail_errors.append("Missed deadlines")
     check_logs_for_errors(root_dir, test_count, fail_errors)
     test_count += 1
 
@@ -49,6 +52,14 @@ def main():
             if file == "file1":
                 # add a size for file1
                 file_list_in.write("{0}\t{1}".format(file, 1025))
+            elif file == "file2":
+                # add a priority for file2
+                file_list_in.write("{0}\t{1}\t{2}\t{3}".format(
+                    file, -1, 0, 5))
+            elif file == "file3":
+                # add a priority and a deadline in ms for file3
+                file_list_in.write("{0}\t{1}\t{2}\t{3}\t{4}".format(
+                    file, -1, 0, 1, 600000))
             else:
                 file_list_in.write(file)
             file_list_in.write('\n')
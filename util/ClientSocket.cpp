@@ -7,6 +7,7 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 #include <wdt/util/ClientSocket.h>
+#include <wdt/Protocol.h>
 #include <wdt/Reporting.h>
 
 #include <glog/logging.h>
@@ -168,6 +169,31 @@ ErrorCode ClientSocket::connect() {
   return OK;
 }
 
+void ClientSocket::adoptConnection(int fd, const std::string &peerIp) {
+  WDT_CHECK(fd_ < 0) << "Previous connection not closed " << fd_ << " "
+                     << port_;
+  WDT_CHECK(fd >= 0);
+  fd_ = fd;
+  peerIp_ = peerIp;
+  VLOG(1) << "Reusing connection " << fd_ << " for port " << port_;
+  setSendBufferSize();
+  setSocketTimeouts();
+}
+
+ErrorCode ClientSocket::writeConnectionCmd(int32_t key) {
+  char buf[Protocol::kConnectionCmdLen];
+  int64_t off = 0;
+  Protocol::encodeConnectionCmd(buf, off, key);
+  int written = writeInternal(
+      buf, off, threadCtx_.getOptions().write_timeout_millis, false);
+  if (written != off) {
+    LOG(ERROR) << "Unable to write connection cmd " << written << " " << off
+               << " port " << port_;
+    return SOCKET_WRITE_ERROR;
+  }
+  return OK;
+}
+
 const std::string &ClientSocket::getPeerIp() const {
   return peerIp_;
 }
@@ -20,6 +20,21 @@ class ClientSocket : public WdtSocket {
   ClientSocket(ThreadCtx &threadCtx, const std::string &dest, int port,
                const EncryptionParams &encryptionParams);
   virtual ErrorCode connect();
+  /**
+   * Uses a connection kept open by a previous transfer instead of connecting.
+   * The socket owns the connection after this call.
+   *
+   * @param fd        fd of the connection
+   * @param peerIp    peer-ip of the connection
+   */
+  void adoptConnection(int fd, const std::string &peerIp);
+  /**
+   * Writes the connection cmd identifying this connection to a single port
+   * receiver. Must be called right after connecting, it is not encrypted.
+   *
+   * @param key       connection key, the receiver port this connection is for
+   */
+  ErrorCode writeConnectionCmd(int32_t key);
   /// @return   peer-ip of the connected socket
   const std::string &getPeerIp() const;
   /// @return   current encryptor tag
@@ -56,8 +56,26 @@ Buffer::~Buffer() {
   }
 }
 
+void ActivityTracker::start(TransferStats* stats) {
+  stats_ = stats;
+  current_ = ACT_OTHER;
+  lastSwitchTime_ = Clock::now();
+}
+
+void ActivityTracker::stop() {
+  if (!isEnabled()) {
+    return;
+  }
+  switchTo(ACT_OTHER, Clock::now());
+  stats_ = nullptr;
+}
+
 ThreadCtx::ThreadCtx(const WdtOptions& options, bool allocateBuffer)
     : options_(options), perfReport_(options) {
+  if (!options_.trace_file_prefix.empty()) {
+    traceBuffer_ = folly::make_unique<TraceBuffer>(
+        std::max(1, options_.trace_buffer_events));
+  }
   if (!allocateBuffer) {
     return;
   }
@@ -94,5 +112,35 @@ void ThreadCtx::setAbortChecker(IAbortChecker const* abortChecker) {
 const IAbortChecker* ThreadCtx::getAbortChecker() const {
   return abortChecker_;
 }
+ThreadActivity PerfStatCollector::getActivity(
+    PerfStatReport::StatType statType) {
+  switch (statType) {
+    case PerfStatReport::SOCKET_READ:
+      return ACT_SOCKET_READ;
+    case PerfStatReport::SOCKET_WRITE:
+      return ACT_SOCKET_WRITE;
+    case PerfStatReport::FILE_READ:
+      return ACT_DISK_READ;
+    case PerfStatReport::FILE_WRITE:
+    case PerfStatReport::SYNC_FILE_RANGE:
+    case PerfStatReport::FSYNC:
+      return ACT_DISK_WRITE;
+    case PerfStatReport::FILE_OPEN:
+    case PerfStatReport::FILE_CLOSE:
+    case PerfStatReport::FILE_SEEK:
+    case PerfStatReport::DIRECTORY_CREATE:
+    case PerfStatReport::UNLINK:
+    case PerfStatReport::FADVISE:
+      return ACT_DISK_METADATA;
+    case PerfStatReport::THROTTLER_SLEEP:
+      return ACT_THROTTLED;
+    case PerfStatReport::RECEIVER_WAIT_SLEEP:
+      return ACT_RECEIVER_WAIT;
+    case PerfStatReport::IOCTL:
+    case PerfStatReport::END:
+      break;
+  }
+  return ACT_OTHER;
+}
 }
 }
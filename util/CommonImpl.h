@@ -9,6 +9,7 @@
 #pragma once
 
 #include <wdt/Reporting.h>
+#include <wdt/util/TraceBuffer.h>
 
 namespace facebook {
 namespace wdt {
@@ -44,6 +45,51 @@ class Buffer {
   bool isAligned_{false};
 };
 
+/**
+ * Attributes the wall time of a thread to exclusive activities, accumulated
+ * in the thread's TransferStats. Only the owner thread should use it. Does
+ * nothing until start() is called.
+ */
+class ActivityTracker {
+ public:
+  /**
+   * Starts attributing time, initially to ACT_OTHER
+   *
+   * @param stats     stats of the owner thread to add the times to
+   */
+  void start(TransferStats *stats);
+
+  /// attributes the time of the current activity and stops tracking
+  void stop();
+
+  /// @return   whether tracking is active
+  bool isEnabled() const {
+    return stats_ != nullptr;
+  }
+
+  /**
+   * Attributes the time since the last switch to the current activity and
+   * makes activity the current one. Must only be called when enabled.
+   *
+   * @param activity    new current activity
+   * @param now         current time
+   *
+   * @return            previous activity
+   */
+  ThreadActivity switchTo(ThreadActivity activity, Clock::time_point now) {
+    ThreadActivity previous = current_;
+    stats_->addActivityTime(current_, durationMicros(now - lastSwitchTime_));
+    current_ = activity;
+    lastSwitchTime_ = now;
+    return previous;
+  }
+
+ private:
+  TransferStats *stats_{nullptr};
+  ThreadActivity current_{ACT_OTHER};
+  Clock::time_point lastSwitchTime_;
+};
+
 /// class representing thread context
 class ThreadCtx {
  public:
@@ -68,6 +114,23 @@ class ThreadCtx {
   /// @return   perf stat reporter
   PerfStatReport &getPerfReport();
 
+  /// @return   activity tracker of the thread
+  ActivityTracker &getActivityTracker() {
+    return activityTracker_;
+  }
+
+  /// @return   timeline event buffer, nullptr if tracing is disabled
+  TraceBuffer *getTraceBuffer() const {
+    return traceBuffer_.get();
+  }
+
+  /// records an instant timeline event if tracing is enabled
+  void traceInstant(const char *name, int64_t arg = -1) {
+    if (traceBuffer_) {
+      traceBuffer_->addInstantEvent(name, arg);
+    }
+  }
+
   /// @param    abort checker to use
   void setAbortChecker(IAbortChecker const *abortChecker);
 
@@ -85,31 +148,117 @@ class ThreadCtx {
   int threadIndex_{-1};
   std::unique_ptr<Buffer> buffer_{nullptr};
   PerfStatReport perfReport_;
+  ActivityTracker activityTracker_;
+  std::unique_ptr<TraceBuffer> traceBuffer_{nullptr};
   IAbortChecker const *abortChecker_{nullptr};
 };
 
-/// util class to collect perf stat
+/**
+ * util class to collect perf stat. Also attributes the time spent in the
+ * scope to the matching ThreadActivity when activity tracking is on, and
+ * records it as a timeline event when tracing is on.
+ */
 class PerfStatCollector {
  public:
   PerfStatCollector(ThreadCtx &threadCtx,
                     const PerfStatReport::StatType statType)
       : threadCtx_(threadCtx), statType_(statType) {
-    if (threadCtx_.getOptions().enable_perf_stat_collection) {
+    collectPerfStat_ = threadCtx_.getOptions().enable_perf_stat_collection;
+    trackActivity_ = threadCtx_.getActivityTracker().isEnabled();
+    traceBuffer_ = threadCtx_.getTraceBuffer();
+    if (collectPerfStat_ || trackActivity_ || traceBuffer_) {
       startTime_ = Clock::now();
     }
+    if (trackActivity_) {
+      previousActivity_ = threadCtx_.getActivityTracker().switchTo(
+          getActivity(statType_), startTime_);
+    }
   }
 
   ~PerfStatCollector() {
-    if (threadCtx_.getOptions().enable_perf_stat_collection) {
-      int64_t duration = durationMicros(Clock::now() - startTime_);
+    if (!collectPerfStat_ && !trackActivity_ && !traceBuffer_) {
+      return;
+    }
+    Clock::time_point endTime = Clock::now();
+    if (collectPerfStat_) {
+      int64_t duration = durationMicros(endTime - startTime_);
       threadCtx_.getPerfReport().addPerfStat(statType_, duration);
     }
+    if (trackActivity_) {
+      threadCtx_.getActivityTracker().switchTo(previousActivity_, endTime);
+    }
+    if (traceBuffer_) {
+      traceBuffer_->addEvent(
+          PerfStatReport::getStatTypeDescription(statType_).c_str(),
+          startTime_, endTime);
+    }
   }
 
+  /// @return   activity the time of a stat type is attributed to
+  static ThreadActivity getActivity(PerfStatReport::StatType statType);
+
  private:
   ThreadCtx &threadCtx_;
   const PerfStatReport::StatType statType_;
   Clock::time_point startTime_;
+  bool collectPerfStat_{false};
+  bool trackActivity_{false};
+  TraceBuffer *traceBuffer_{nullptr};
+  ThreadActivity previousActivity_{ACT_OTHER};
+};
+
+/**
+ * RAII helper recording the scope as a timeline event of the thread when
+ * tracing is on. Typically used for the lifecycle steps of a block, with the
+ * block sequence id as argument.
+ */
+class TraceScope {
+ public:
+  /// @param name   name of the event, must point to static storage
+  TraceScope(ThreadCtx &threadCtx, const char *name, int64_t arg = -1)
+      : traceBuffer_(threadCtx.getTraceBuffer()), name_(name), arg_(arg) {
+    if (traceBuffer_) {
+      startTime_ = Clock::now();
+    }
+  }
+
+  /// sets the argument, for when it is only known inside the scope
+  void setArg(int64_t arg) {
+    arg_ = arg;
+  }
+
+  ~TraceScope() {
+    if (traceBuffer_) {
+      traceBuffer_->addEvent(name_, startTime_, Clock::now(), arg_);
+    }
+  }
+
+ private:
+  TraceBuffer *traceBuffer_;
+  const char *name_;
+  int64_t arg_;
+  Clock::time_point startTime_;
+};
+
+/// RAII helper attributing the time spent in a scope to an activity
+class ActivityScope {
+ public:
+  ActivityScope(ThreadCtx &threadCtx, ThreadActivity activity)
+      : tracker_(threadCtx.getActivityTracker()) {
+    if (tracker_.isEnabled()) {
+      previousActivity_ = tracker_.switchTo(activity, Clock::now());
+    }
+  }
+
+  ~ActivityScope() {
+    if (tracker_.isEnabled()) {
+      tracker_.switchTo(previousActivity_, Clock::now());
+    }
+  }
+
+ private:
+  ActivityTracker &tracker_;
+  ThreadActivity previousActivity_{ACT_OTHER};
 };
 }
 }
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ConnectionDispatcher.h>
+#include <wdt/Protocol.h>
+#include <wdt/util/ServerSocket.h>
+
+#include <folly/Memory.h>
+#include <errno.h>
+#include <glog/logging.h>
+#include <poll.h>
+#include <unistd.h>
+#include <chrono>
+
+namespace facebook {
+namespace wdt {
+
+ConnectionDispatcher::ConnectionDispatcher(const WdtOptions &options,
+                                           int port, int backlog,
+                                           IAbortChecker const *abortChecker)
+    : threadCtx_(options, /* do not allocate buffer */ false) {
+  threadCtx_.setAbortChecker(abortChecker);
+  // the connection cmd is sent before encryption starts
+  listener_ = folly::make_unique<ServerSocket>(threadCtx_, port, backlog,
+                                               EncryptionParams());
+}
+
+ErrorCode ConnectionDispatcher::listen() {
+  return listener_->listen();
+}
+
+int ConnectionDispatcher::getPort() const {
+  return listener_->getPort();
+}
+
+bool ConnectionDispatcher::acceptOne(int timeoutMillis,
+                                     Connection &connection) {
+  if (listener_->acceptNextConnection(timeoutMillis, false) != OK) {
+    return false;
+  }
+  connection.peerIp = listener_->getPeerIp();
+  connection.peerPort = listener_->getPeerPort();
+  connection.fd = listener_->releaseConnection();
+  return true;
+}
+
+bool ConnectionDispatcher::readKey(const Connection &connection,
+                                   int32_t &key) {
+  char buf[Protocol::kConnectionCmdLen];
+  int64_t numRead = 0;
+  const auto deadline =
+      Clock::now() +
+      std::chrono::milliseconds(threadCtx_.getOptions().read_timeout_millis);
+  while (numRead < Protocol::kConnectionCmdLen) {
+    const int remainingMillis = durationMillis(deadline - Clock::now());
+    if (remainingMillis <= 0) {
+      break;
+    }
+    struct pollfd pollFd = {connection.fd, POLLIN, 0};
+    int ret = ::poll(&pollFd, 1, remainingMillis);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    ret = ::read(connection.fd, buf + numRead,
+                 Protocol::kConnectionCmdLen - numRead);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    numRead += ret;
+  }
+  int64_t off = 0;
+  if (numRead != Protocol::kConnectionCmdLen ||
+      !Protocol::decodeConnectionCmd(buf, off, key)) {
+    LOG(ERROR) << "Unable to read connection key from " << connection.peerIp
+               << " " << connection.peerPort << " port " << getPort()
+               << " read " << numRead;
+    return false;
+  }
+  VLOG(1) << "Accepted connection " << connection.fd << " with key " << key
+          << " from " << connection.peerIp << " " << connection.peerPort;
+  return true;
+}
+
+int ConnectionDispatcher::accept(int32_t key, int timeoutMillis,
+                                 std::string &peerIp, std::string &peerPort) {
+  const auto deadline =
+      Clock::now() + std::chrono::milliseconds(timeoutMillis);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+      Connection connection = std::move(it->second);
+      pending_.erase(it);
+      peerIp = std::move(connection.peerIp);
+      peerPort = std::move(connection.peerPort);
+      return connection.fd;
+    }
+    const int remainingMillis = durationMillis(deadline - Clock::now());
+    if (remainingMillis <= 0) {
+      return -1;
+    }
+    if (accepting_) {
+      // some other thread is accepting, it will notify when done
+      cv_.wait_for(lock, std::chrono::milliseconds(remainingMillis));
+      continue;
+    }
+    accepting_ = true;
+    lock.unlock();
+    Connection connection;
+    const bool accepted = acceptOne(remainingMillis, connection);
+    lock.lock();
+    accepting_ = false;
+    // the next connection can be accepted while the key of this one is read
+    cv_.notify_all();
+    if (!accepted) {
+      continue;
+    }
+    lock.unlock();
+    int32_t connectionKey;
+    const bool keyRead = readKey(connection, connectionKey);
+    if (!keyRead) {
+      ::close(connection.fd);
+    }
+    lock.lock();
+    if (keyRead) {
+      Connection &pending = pending_[connectionKey];
+      if (pending.fd >= 0) {
+        // sender reconnected, previous connection is stale
+        LOG(INFO) << "Closing unclaimed connection " << pending.fd
+                  << " with key " << connectionKey;
+        ::close(pending.fd);
+      }
+      pending = std::move(connection);
+      cv_.notify_all();
+    }
+  }
+}
+
+void ConnectionDispatcher::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &it : pending_) {
+    ::close(it.second.fd);
+  }
+  pending_.clear();
+}
+
+ConnectionDispatcher::~ConnectionDispatcher() {
+  clear();
+}
+}
+}
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/AbortChecker.h>
+#include <wdt/ErrorCodes.h>
+#include <wdt/WdtOptions.h>
+#include <wdt/util/CommonImpl.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace facebook {
+namespace wdt {
+
+class ServerSocket;
+
+/**
+ * Accepts all the connections of a receiver on a single port (single_port
+ * option) and hands each of them to the receiver thread it is meant for.
+ * Receiver threads keep their own (logical) port as identity, it is also the
+ * key the sender writes in the CONNECTION_CMD starting every connection.
+ * There is no dedicated accept thread: the first receiver thread waiting for
+ * a connection accepts it, the others wait for it. The key is read after the
+ * accept is handed over, so the next connection can be accepted meanwhile.
+ */
+class ConnectionDispatcher {
+ public:
+  /**
+   * @param options         options to use
+   * @param port            port to listen on (0 or not static_ports for any)
+   * @param backlog         accept backlog
+   * @param abortChecker    abort checker of the receiver
+   */
+  ConnectionDispatcher(const WdtOptions &options, int port, int backlog,
+                       IAbortChecker const *abortChecker);
+
+  /// starts listening, can be called again after a failure
+  ErrorCode listen();
+
+  /// @return   port the dispatcher listens on
+  int getPort() const;
+
+  /**
+   * Waits for the next connection with the given key
+   *
+   * @param key             connection key of the caller
+   * @param timeoutMillis   timeout in millis
+   * @param peerIp          set to the peer ip of the connection
+   * @param peerPort        set to the peer port of the connection
+   *
+   * @return                fd of the connection, owned by the caller, -1 in
+   *                        case of timeout or error
+   */
+  int accept(int32_t key, int timeoutMillis, std::string &peerIp,
+             std::string &peerPort);
+
+  /// closes the connections which have not been claimed
+  void clear();
+
+  ~ConnectionDispatcher();
+
+ private:
+  struct Connection {
+    int fd{-1};
+    std::string peerIp;
+    std::string peerPort;
+  };
+
+  /**
+   * Accepts one connection, called without holding the mutex by a single
+   * thread at a time
+   *
+   * @return      whether a connection was accepted
+   */
+  bool acceptOne(int timeoutMillis, Connection &connection);
+
+  /**
+   * Reads the key of an accepted connection, called without holding the
+   * mutex so that a slow peer does not hold up the other accepts
+   *
+   * @return      whether the key was read
+   */
+  bool readKey(const Connection &connection, int32_t &key);
+
+  ThreadCtx threadCtx_;
+  /// listening socket, only used by the thread doing the accept
+  std::unique_ptr<ServerSocket> listener_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  /// whether a thread is currently accepting
+  bool accepting_{false};
+  /// accepted connections not yet claimed, latest per key
+  std::map<int32_t, Connection> pending_;
+};
+}
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ConnectionPool.h>
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace facebook {
+namespace wdt {
+
+ConnectionPool &ConnectionPool::get() {
+  static ConnectionPool pool;
+  return pool;
+}
+
+std::string ConnectionPool::getKey(const std::string &host, int port) {
+  return folly::to<std::string>(host, ":", port);
+}
+
+bool ConnectionPool::isAlive(int fd) {
+  // an idle connection has nothing to read, eof or any unexpected data means
+  // the receiver closed it or is out of sync
+  char c;
+  int ret = ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+int ConnectionPool::acquire(const std::string &host, int port,
+                            std::string &peerIp) {
+  Connection connection;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = connections_.find(getKey(host, port));
+    if (it == connections_.end()) {
+      return -1;
+    }
+    connection = std::move(it->second);
+    connections_.erase(it);
+  }
+  if (!isAlive(connection.fd)) {
+    VLOG(1) << "Discarding closed pooled connection " << connection.fd
+            << " to " << host << " " << port;
+    ::close(connection.fd);
+    return -1;
+  }
+  peerIp = std::move(connection.peerIp);
+  numAcquired_++;
+  return connection.fd;
+}
+
+void ConnectionPool::release(const std::string &host, int port,
+                             const std::string &peerIp, int fd) {
+  int oldFd = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Connection &connection = connections_[getKey(host, port)];
+    oldFd = connection.fd;
+    connection.fd = fd;
+    connection.peerIp = peerIp;
+  }
+  VLOG(1) << "Pooled connection " << fd << " to " << host << " " << port;
+  if (oldFd >= 0) {
+    ::close(oldFd);
+  }
+}
+
+void ConnectionPool::clear() {
+  std::map<std::string, Connection> connections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections.swap(connections_);
+  }
+  for (const auto &it : connections) {
+    ::close(it.second.fd);
+  }
+}
+
+int ConnectionPool::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connections_.size();
+}
+
+int64_t ConnectionPool::getNumAcquired() const {
+  return numAcquired_.load();
+}
+
+ConnectionPool::~ConnectionPool() {
+  clear();
+}
+}
+}
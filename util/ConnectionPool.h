@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Process wide pool of the connections kept open at the end of transfers to
+ * long running receivers (reuse_connections option), keyed by destination
+ * host and port. Next transfer to the same receiver takes the connections
+ * from the pool instead of connecting, so it skips the connect and starts
+ * with a warm tcp congestion window. Only idle connections are in the pool,
+ * a connection is owned by a single transfer while it is used. Every transfer
+ * still sends its own settings (transfer-id) and encryption settings (new iv)
+ * on the reused connection.
+ */
+class ConnectionPool {
+ public:
+  /// @return   the process wide pool
+  static ConnectionPool &get();
+
+  /**
+   * Takes an idle connection out of the pool. Connections which were closed
+   * by the receiver in the meantime are discarded.
+   *
+   * @param host      destination host
+   * @param port      destination port
+   * @param peerIp    set to the peer-ip of the returned connection
+   *
+   * @return          fd of the connection, -1 if there is none
+   */
+  int acquire(const std::string &host, int port, std::string &peerIp);
+
+  /**
+   * Adds an idle connection to the pool, the pool owns it after this call.
+   * A receiver port only keeps one connection, so this replaces (closes) any
+   * other connection to the same host and port.
+   *
+   * @param host      destination host
+   * @param port      destination port
+   * @param peerIp    peer-ip of the connection
+   * @param fd        fd of the connection
+   */
+  void release(const std::string &host, int port, const std::string &peerIp,
+               int fd);
+
+  /// closes all the idle connections
+  void clear();
+
+  /// @return   number of idle connections
+  int size();
+
+  /// @return   number of connections handed out by acquire, i.e. connects
+  ///           saved by the pool
+  int64_t getNumAcquired() const;
+
+  ~ConnectionPool();
+
+ private:
+  struct Connection {
+    int fd{-1};
+    std::string peerIp;
+  };
+
+  /// @return   whether an idle connection is still usable
+  static bool isAlive(int fd);
+
+  /// @return   key of the connections to the given destination
+  static std::string getKey(const std::string &host, int port);
+
+  std::mutex mutex_;
+  std::map<std::string, Connection> connections_;
+
+  std::atomic<int64_t> numAcquired_{0};
+};
+}
+}
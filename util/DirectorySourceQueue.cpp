@@ -142,8 +142,15 @@ void DirectorySourceQueue::setPreviouslyReceivedChunks(
     std::vector<FileChunksInfo> &previouslyTransferredChunks) {
   std::unique_lock<std::mutex> lock(mutex_);
   WDT_CHECK_EQ(0, numBlocksDequeued_);
+  if (externalBlocks_) {
+    // the queue only knows the blocks added so far, not the whole files
+    LOG(WARNING) << "Ignoring previously received chunks of "
+                 << previouslyTransferredChunks.size() << " files";
+    return;
+  }
   // reset all the queue variables
   nextSeqId_ = 0;
+  deadlines_.clear();
   totalFileSize_ = 0;
   numEntries_ = 0;
   numBlocks_ = 0;
@@ -163,6 +170,10 @@ void DirectorySourceQueue::setPreviouslyReceivedChunks(
 }
 
 DirectorySourceQueue::~DirectorySourceQueue() {
+  streamsAborted_.store(true);
+  for (auto &streamThread : streamThreads_) {
+    streamThread.join();
+  }
   // need to remove all the sources because they access metadata at the
   // destructor.
   clearSourceQueue();
@@ -191,6 +202,10 @@ bool DirectorySourceQueue::buildQueueSynchronously() {
       return false;
     }
     initCalled_ = true;
+    if (externalBlocks_) {
+      // discovery ends with finishAddingBlocks()
+      return true;
+    }
   }
   bool res = false;
   // either traverse directory or we already have a fixed set of candidate
@@ -206,10 +221,14 @@ bool DirectorySourceQueue::buildQueueSynchronously() {
     std::lock_guard<std::mutex> lock(mutex_);
     initFinished_ = true;
     enqueueFilesToBeDeleted();
+    if (blockListener_) {
+      blockListener_->onDiscoveryFinished();
+    }
     // TODO: comment why
     if (sourceQueue_.empty()) {
       conditionNotEmpty_.notify_all();
     }
+    conditionDiscovery_.notify_all();
   }
   directoryTime_ = durationSeconds(Clock::now() - startTime);
   VLOG(1) << "finished initialization of DirectorySourceQueue in "
@@ -439,6 +458,8 @@ void DirectorySourceQueue::createIntoQueue(const string &fullPath,
   metadata->fd = fileInfo.fd;
   metadata->directReads = fileInfo.directReads;
   metadata->size = fileInfo.fileSize;
+  metadata->priority = fileInfo.priority;
+  metadata->deadlineMillis = fileInfo.deadlineMillis;
   if ((openFilesDuringDiscovery_ != 0) && (metadata->fd < 0)) {
     metadata->fd =
         FileUtil::openForRead(*threadCtx_, fullPath, metadata->directReads);
@@ -502,6 +523,10 @@ void DirectorySourceQueue::createIntoQueueInternal(SourceMetaData *metadata) {
     remainingChunks = fileChunksInfo.getRemainingChunks(fileSize);
     if (remainingChunks.empty()) {
       LOG(INFO) << relPath << " completely sent in previous transfer";
+      if (metadata->deadlineMillis > 0) {
+        metadata->seqId = fileChunksInfo.getSeqId();
+        trackDeadlineLocked(*metadata, remainingChunks);
+      }
       return;
     }
     seqId = fileChunksInfo.getSeqId();
@@ -512,15 +537,22 @@ void DirectorySourceQueue::createIntoQueueInternal(SourceMetaData *metadata) {
   metadata->seqId = seqId;
   metadata->prevSeqId = prevSeqId;
   metadata->allocationStatus = allocationStatus;
+  if (metadata->deadlineMillis > 0) {
+    trackDeadlineLocked(*metadata, remainingChunks);
+  }
 
   for (const auto &chunk : remainingChunks) {
     int64_t offset = chunk.start_;
     int64_t remainingBytes = chunk.size();
     do {
       const int64_t size = std::min<int64_t>(remainingBytes, blockSize);
-      std::unique_ptr<ByteSource> source =
-          folly::make_unique<FileByteSource>(metadata, size, offset);
-      sourceQueue_.push(std::move(source));
+      if (blockListener_) {
+        blockListener_->onBlockDiscovered(*metadata, offset, size);
+      } else {
+        std::unique_ptr<ByteSource> source =
+            folly::make_unique<FileByteSource>(metadata, size, offset);
+        sourceQueue_.push(std::move(source));
+      }
       remainingBytes -= size;
       offset += size;
       blockCount++;
@@ -530,6 +562,292 @@ void DirectorySourceQueue::createIntoQueueInternal(SourceMetaData *metadata) {
   numEntries_++;
   numBlocks_ += blockCount;
   smartNotify(blockCount);
+  conditionDiscovery_.notify_all();
+}
+
+void DirectorySourceQueue::trackDeadlineLocked(
+    const SourceMetaData &metadata,
+    const std::vector<Interval> &remainingChunks) {
+  DeadlineProgress &progress = deadlines_[metadata.seqId];
+  progress.relPath = metadata.relPath;
+  progress.fileSize = metadata.size;
+  progress.deadlineMillis = metadata.deadlineMillis;
+  // the chunks received by a previous transfer are already sent
+  int64_t start = 0;
+  for (const auto &chunk : remainingChunks) {
+    if (chunk.start_ > start) {
+      progress.sentChunks.addChunk(Interval(start, chunk.start_));
+    }
+    start = chunk.end_;
+  }
+  if (start < metadata.size) {
+    progress.sentChunks.addChunk(Interval(start, metadata.size));
+  }
+  if (remainingChunks.empty()) {
+    progress.sent = true;
+    progress.sentTime = Clock::now();
+  }
+}
+
+void DirectorySourceQueue::markSourceSent(const ByteSource &source) {
+  markSourcePartSent(source, source.getSize());
+}
+
+void DirectorySourceQueue::markSourcePartSent(const ByteSource &source,
+                                              int64_t numBytes) {
+  if (source.getMetaData().deadlineMillis <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = deadlines_.find(source.getMetaData().seqId);
+  if (it == deadlines_.end() || it->second.sent) {
+    return;
+  }
+  DeadlineProgress &progress = it->second;
+  // blocks sent again after a failure are merged with their first send
+  progress.sentChunks.addChunk(
+      Interval(source.getOffset(), source.getOffset() + numBytes));
+  progress.sentChunks.mergeChunks();
+  if (progress.sentChunks.getRemainingChunks(progress.fileSize).empty()) {
+    progress.sent = true;
+    progress.sentTime = Clock::now();
+    VLOG(1) << "Sent " << progress.relPath << " with a deadline of "
+            << progress.deadlineMillis << " ms";
+  }
+}
+
+std::vector<FileDeadlineReport> DirectorySourceQueue::getDeadlineReports(
+    const Clock::time_point &startTime) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<FileDeadlineReport> reports;
+  for (const auto &pair : deadlines_) {
+    const DeadlineProgress &progress = pair.second;
+    FileDeadlineReport report;
+    report.fileName = progress.relPath;
+    report.deadlineMillis = progress.deadlineMillis;
+    if (progress.sent) {
+      report.sentMillis = durationMillis(progress.sentTime - startTime);
+    }
+    reports.emplace_back(std::move(report));
+  }
+  std::sort(reports.begin(), reports.end(),
+            [](const FileDeadlineReport &r1, const FileDeadlineReport &r2) {
+              return r1.deadlineMillis < r2.deadlineMillis;
+            });
+  return reports;
+}
+
+void DirectorySourceQueue::enableExternalBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(!initCalled_);
+  externalBlocks_ = true;
+}
+
+void DirectorySourceQueue::addBlock(const std::string &relPath,
+                                    int64_t fileSize, int64_t offset,
+                                    int64_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(externalBlocks_ && !addingFinished_);
+  SourceMetaData *&metadata = externalFiles_[relPath];
+  if (metadata == nullptr) {
+    metadata = newExternalFileLocked(relPath, rootDir_ + relPath, fileSize);
+  }
+  auto source = folly::make_unique<FileByteSource>(metadata, size, offset);
+  source->setBlockCache(blockCache_, blockCacheConsumer_);
+  sourceQueue_.push(std::move(source));
+  numBlocks_++;
+  smartNotify(1);
+  conditionDiscovery_.notify_all();
+}
+
+ErrorCode DirectorySourceQueue::addSource(
+    const std::string &relPath, int64_t size,
+    std::shared_ptr<SourceReader> reader) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(externalBlocks_ && !addingFinished_);
+  SourceMetaData *&metadata = externalFiles_[relPath];
+  if (metadata != nullptr) {
+    LOG(ERROR) << "Source " << relPath << " already added";
+    return ALREADY_EXISTS;
+  }
+  // not a file, the full path only shows in the logs
+  metadata = newExternalFileLocked(relPath, relPath, size);
+  const int64_t blockSizeBytes = blockSizeMbytes_ * 1024 * 1024;
+  const int64_t blockSize = blockSizeBytes > 0 ? blockSizeBytes : size;
+  int blockCount = 0;
+  int64_t offset = 0;
+  do {
+    const int64_t blockBytes = std::min<int64_t>(size - offset, blockSize);
+    sourceQueue_.push(folly::make_unique<ReaderByteSource>(
+        metadata, reader, blockBytes, offset));
+    offset += blockBytes;
+    blockCount++;
+  } while (offset < size);
+  numBlocks_ += blockCount;
+  smartNotify(blockCount);
+  conditionDiscovery_.notify_all();
+  return OK;
+}
+
+SourceMetaData *DirectorySourceQueue::newExternalFileLocked(
+    const std::string &relPath, const std::string &fullPath,
+    int64_t fileSize) {
+  SourceMetaData *metadata = new SourceMetaData();
+  metadata->fullPath = fullPath;
+  metadata->relPath = relPath;
+  metadata->size = fileSize;
+  metadata->seqId = nextSeqId_++;
+  sharedFileData_.emplace_back(metadata);
+  numEntries_++;
+  totalFileSize_ += fileSize;
+  return metadata;
+}
+
+void DirectorySourceQueue::setBlockListener(BlockListener *listener) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(!initCalled_);
+  blockListener_ = listener;
+}
+
+void DirectorySourceQueue::setBlockCache(SharedBlockCache *blockCache,
+                                         int consumer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  blockCache_ = blockCache;
+  blockCacheConsumer_ = consumer;
+}
+
+ErrorCode DirectorySourceQueue::addStream(
+    const std::string &relPath, std::shared_ptr<StreamReader> reader) {
+  const std::string &spoolDir = threadCtx_->getOptions().stream_spool_dir;
+  std::string spoolPath = spoolDir + "/wdt_stream_XXXXXX";
+  const int fd = mkstemp(&spoolPath[0]);
+  if (fd < 0) {
+    PLOG(ERROR) << "Unable to create the spool file of " << relPath << " in "
+                << spoolDir;
+    return ERROR;
+  }
+  // only the fd is needed, nothing is left behind
+  unlink(spoolPath.c_str());
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(externalBlocks_ && !addingFinished_);
+  SourceMetaData *&metadata = externalFiles_[relPath];
+  if (metadata != nullptr) {
+    LOG(ERROR) << "Source " << relPath << " already added";
+    ::close(fd);
+    return ALREADY_EXISTS;
+  }
+  // the size stays 0 (unknown) until the end of the stream
+  metadata = newExternalFileLocked(relPath, spoolPath, 0);
+  metadata->fd = fd;
+  metadata->needToClose = true;
+  numActiveStreams_++;
+  streamThreads_.emplace_back(&DirectorySourceQueue::produceStream, this,
+                              metadata, std::move(reader));
+  return OK;
+}
+
+void DirectorySourceQueue::produceStream(
+    SourceMetaData *metadata, std::shared_ptr<StreamReader> reader) {
+  const int64_t blockSize =
+      (blockSizeMbytes_ > 0 ? blockSizeMbytes_ : kDefaultStreamBlockMbytes) *
+      1024 * 1024;
+  std::vector<char> buf(blockSize);
+  int64_t offset = 0;
+  ErrorCode code = OK;
+  while (code == OK) {
+    // fills a whole block, a short one means the stream ended
+    int64_t numRead = 0;
+    while (numRead < blockSize) {
+      if (streamAbortChecker_.shouldAbort()) {
+        code = ABORT;
+        break;
+      }
+      const int64_t ret = reader->read(
+          buf.data() + numRead, blockSize - numRead, streamAbortChecker_);
+      if (ret < 0) {
+        code = streamAbortChecker_.shouldAbort() ? ABORT
+                                                 : BYTE_SOURCE_READ_ERROR;
+      }
+      if (ret <= 0) {
+        break;
+      }
+      numRead += ret;
+    }
+    if (code != OK) {
+      break;
+    }
+    int64_t written = 0;
+    while (written < numRead) {
+      const int64_t ret = ::pwrite(metadata->fd, buf.data() + written,
+                                   numRead - written, offset + written);
+      if (ret <= 0) {
+        PLOG(ERROR) << "Failed to spool " << metadata->relPath;
+        code = BYTE_SOURCE_READ_ERROR;
+        break;
+      }
+      written += ret;
+    }
+    if (code != OK) {
+      break;
+    }
+    const bool ended = numRead < blockSize;
+    std::lock_guard<std::mutex> lock(mutex_);
+    SourceMetaData *blockMetadata = metadata;
+    if (ended) {
+      // the final size goes in the header of the last block, possibly
+      // empty, which gets its own metadata as the others are being sent
+      blockMetadata = new SourceMetaData();
+      blockMetadata->fullPath = metadata->fullPath;
+      blockMetadata->relPath = metadata->relPath;
+      blockMetadata->seqId = metadata->seqId;
+      blockMetadata->fd = metadata->fd;
+      blockMetadata->size = offset + numRead;
+      sharedFileData_.emplace_back(blockMetadata);
+      LOG(INFO) << "Stream " << metadata->relPath << " ended with "
+                << blockMetadata->size << " bytes";
+    }
+    sourceQueue_.push(
+        folly::make_unique<FileByteSource>(blockMetadata, numRead, offset));
+    numBlocks_++;
+    totalFileSize_ += numRead;
+    offset += numRead;
+    smartNotify(1);
+    conditionDiscovery_.notify_all();
+    if (ended) {
+      break;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (code != OK) {
+    LOG(ERROR) << "Stream " << metadata->relPath << " failed after " << offset
+               << " bytes " << errorCodeToStr(code);
+    TransferStats stats(metadata->relPath);
+    stats.setLocalErrorCode(code);
+    failedSourceStats_.emplace_back(std::move(stats));
+  }
+  numActiveStreams_--;
+  endExternalDiscoveryLocked();
+}
+
+bool DirectorySourceQueue::StreamAbortChecker::shouldAbort() const {
+  return queue_->streamsAborted_.load() ||
+         queue_->threadCtx_->getAbortChecker()->shouldAbort();
+}
+
+void DirectorySourceQueue::finishAddingBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK(externalBlocks_);
+  addingFinished_ = true;
+  endExternalDiscoveryLocked();
+}
+
+void DirectorySourceQueue::endExternalDiscoveryLocked() {
+  if (!addingFinished_ || numActiveStreams_ > 0) {
+    return;
+  }
+  initFinished_ = true;
+  conditionNotEmpty_.notify_all();
+  conditionDiscovery_.notify_all();
 }
 
 std::vector<TransferStats> &DirectorySourceQueue::getFailedSourceStats() {
@@ -591,11 +909,42 @@ std::pair<int64_t, ErrorCode> DirectorySourceQueue::getNumBlocksAndStatus()
   return std::make_pair(numBlocks_, status);
 }
 
+int64_t DirectorySourceQueue::getNumPendingBlocks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sourceQueue_.size();
+}
+
 int64_t DirectorySourceQueue::getTotalSize() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return totalFileSize_;
 }
 
+bool DirectorySourceQueue::waitForDiscovery(
+    int64_t maxFiles, int64_t maxBytes, int64_t timeoutMillis,
+    const IAbortChecker *abortChecker) const {
+  const auto startTime = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (externalBlocks_ && !initFinished_) {
+    return false;
+  }
+  while (numEntries_ <= maxFiles && totalFileSize_ <= maxBytes) {
+    if (initFinished_) {
+      return true;
+    }
+    const int64_t remainingMillis =
+        timeoutMillis - durationMillis(Clock::now() - startTime);
+    if (remainingMillis <= 0 || abortChecker->shouldAbort()) {
+      return false;
+    }
+    int64_t waitMillis = kAbortCheckMillis;
+    if (remainingMillis < waitMillis) {
+      waitMillis = remainingMillis;
+    }
+    conditionDiscovery_.wait_for(lock, std::chrono::milliseconds(waitMillis));
+  }
+  return false;
+}
+
 bool DirectorySourceQueue::fileDiscoveryFinished() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return initFinished_;
@@ -644,11 +993,26 @@ void DirectorySourceQueue::enqueueFilesToBeDeleted() {
 
 std::unique_ptr<ByteSource> DirectorySourceQueue::getNextSource(
     ThreadCtx *callerThreadCtx, ErrorCode &status) {
+  return dequeueSource(callerThreadCtx, true, -1, status);
+}
+
+std::unique_ptr<ByteSource> DirectorySourceQueue::tryGetNextSource(
+    ThreadCtx *callerThreadCtx, int64_t maxSize) {
+  ErrorCode status;
+  return dequeueSource(callerThreadCtx, false, maxSize, status);
+}
+
+std::unique_ptr<ByteSource> DirectorySourceQueue::dequeueSource(
+    ThreadCtx *callerThreadCtx, bool waitForDiscovery, int64_t maxSize,
+    ErrorCode &status) {
   std::unique_ptr<ByteSource> source;
   while (true) {
     std::unique_lock<std::mutex> lock(mutex_);
-    while (sourceQueue_.empty() && !initFinished_) {
-      conditionNotEmpty_.wait(lock);
+    if (waitForDiscovery && sourceQueue_.empty() && !initFinished_) {
+      ActivityScope activityScope(*callerThreadCtx, ACT_QUEUE_WAIT);
+      while (sourceQueue_.empty() && !initFinished_) {
+        conditionNotEmpty_.wait(lock);
+      }
     }
     if (!failedSourceStats_.empty() || !failedDirectories_.empty()) {
       status = ERROR;
@@ -658,6 +1022,9 @@ std::unique_ptr<ByteSource> DirectorySourceQueue::getNextSource(
     if (sourceQueue_.empty()) {
       return nullptr;
     }
+    if (maxSize >= 0 && sourceQueue_.top()->getSize() > maxSize) {
+      return nullptr;
+    }
     // using const_cast since priority_queue returns a const reference
     source = std::move(
         const_cast<std::unique_ptr<ByteSource> &>(sourceQueue_.top()));
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <dirent.h>
 #include <glog/logging.h>
@@ -23,9 +24,32 @@
 #include <wdt/WdtTransferRequest.h>
 #include <wdt/SourceQueue.h>
 #include <wdt/util/FileByteSource.h>
+#include <wdt/util/ReaderByteSource.h>
+#include <wdt/util/StreamReader.h>
 
 namespace facebook {
 namespace wdt {
+
+/// Gets the blocks of a DirectorySourceQueue as they are discovered
+class BlockListener {
+ public:
+  /**
+   * Called for every block discovered, with the lock of the queue held
+   *
+   * @param metadata    metadata of the file
+   * @param offset      offset of the block in the file
+   * @param size        size of the block
+   */
+  virtual void onBlockDiscovered(const SourceMetaData &metadata,
+                                 int64_t offset, int64_t size) = 0;
+
+  /// called once the discovery is over
+  virtual void onDiscoveryFinished() = 0;
+
+  virtual ~BlockListener() {
+  }
+};
+
 /**
  * SourceQueue that returns all the regular files under a given directory
  * (recursively) as individual FileByteSource objects, sorted by decreasing
@@ -88,6 +112,19 @@ class DirectorySourceQueue : public SourceQueue {
   virtual std::unique_ptr<ByteSource> getNextSource(ThreadCtx *callerThreadCtx,
                                                     ErrorCode &status) override;
 
+  /**
+   * Like getNextSource, but never waits for discovery. Used to fill batches of
+   * small blocks.
+   *
+   * @param callerThreadCtx context of the calling thread
+   * @param maxSize         max size of the source to return
+   *
+   * @return next FileByteSource to consume, nullptr if the queue is empty or
+   *         the next source is bigger than maxSize
+   */
+  std::unique_ptr<ByteSource> tryGetNextSource(ThreadCtx *callerThreadCtx,
+                                               int64_t maxSize);
+
   /// @return         total number of files processed/enqueued
   virtual int64_t getCount() const override;
 
@@ -97,6 +134,26 @@ class DirectorySourceQueue : public SourceQueue {
   /// @return         total number of blocks and status of the transfer
   std::pair<int64_t, ErrorCode> getNumBlocksAndStatus() const;
 
+  /// @return         number of blocks currently waiting in the queue
+  int64_t getNumPendingBlocks() const;
+
+  /**
+   * Waits until file discovery is over or has found more than maxFiles files
+   * or maxBytes bytes. Blocks added from outside only end with
+   * finishAddingBlocks(), so this does not wait for them
+   *
+   * @param maxFiles        maximum number of files
+   * @param maxBytes        maximum number of bytes
+   * @param timeoutMillis   maximum time to wait
+   * @param abortChecker    stops the wait
+   *
+   * @return          true if discovery finished within the limits, false if
+   *                  it went beyond them, timed out or was aborted
+   */
+  bool waitForDiscovery(int64_t maxFiles, int64_t maxBytes,
+                        int64_t timeoutMillis,
+                        const IAbortChecker *abortChecker) const;
+
   /// @return         perf report
   const PerfStatReport &getPerfReport() const;
 
@@ -171,6 +228,76 @@ class DirectorySourceQueue : public SourceQueue {
    */
   void setFollowSymlinks(bool followSymlinks);
 
+  /**
+   * Blocks are added with addBlock() instead of being discovered, discovery
+   * ends with finishAddingBlocks(). Used by a receiver forwarding the blocks
+   * it receives to the next receiver of a chain. Must be called before
+   * building the queue
+   */
+  void enableExternalBlocks();
+
+  /**
+   * Adds a block of a file already written under the root directory
+   *
+   * @param relPath       relative path of the file
+   * @param fileSize      size of the whole file
+   * @param offset        offset of the block in the file
+   * @param size          size of the block
+   */
+  void addBlock(const std::string &relPath, int64_t fileSize, int64_t offset,
+                int64_t size);
+
+  /**
+   * Adds a source which is not a file under the root directory, e.g.
+   * application memory, split in blocks like files
+   *
+   * @param relPath       relative path of the source on the receiver
+   * @param size          size of the source
+   * @param reader        reader of the content of the source
+   *
+   * @return              ALREADY_EXISTS if the path was already added
+   */
+  ErrorCode addSource(const std::string &relPath, int64_t size,
+                      std::shared_ptr<SourceReader> reader);
+
+  /**
+   * Adds a source whose size is unknown until it ends. A thread reads the
+   * stream, spools it and queues every block as soon as it is read. Blocks
+   * carry a file size of 0 until the stream ends, the last block, possibly
+   * empty, carries the final size. Discovery lasts until all the streams
+   * ended
+   *
+   * @param relPath       relative path of the stream on the receiver
+   * @param reader        reader of the stream
+   *
+   * @return              ALREADY_EXISTS if the path was already added, ERROR
+   *                      if the spool file could not be created
+   */
+  ErrorCode addStream(const std::string &relPath,
+                      std::shared_ptr<StreamReader> reader);
+
+  /// ends the discovery of a queue with external blocks, once the streams
+  /// are over
+  void finishAddingBlocks();
+
+  /**
+   * Discovered blocks are handed to the listener instead of being queued.
+   * Used to discover once for several destinations. Must be called before
+   * building the queue
+   *
+   * @param listener    listener of the blocks
+   */
+  void setBlockListener(BlockListener *listener);
+
+  /**
+   * Blocks added with addBlock() share their read with the other
+   * destinations of the cache
+   *
+   * @param blockCache  cache of the blocks of all the destinations
+   * @param consumer    destination of this queue in the cache
+   */
+  void setBlockCache(SharedBlockCache *blockCache, int consumer);
+
   /**
    * sets chunks which were sent in some previous transfer
    *
@@ -180,16 +307,15 @@ class DirectorySourceQueue : public SourceQueue {
       std::vector<FileChunksInfo> &previouslyTransferredChunks);
 
   /**
-   * returns sources to the queue, checks for fail/retries, doesn't increment
-   * numentries
+   * returns sources to the queue, for them to be sent again. They are not
+   * counted as new entries, only as no longer dequeued
    *
    * @param sources               sources to be returned to the queue
    */
   void returnToQueue(std::vector<std::unique_ptr<ByteSource>> &sources);
 
   /**
-   * returns a source to the queue, checks for fail/retries, doesn't increment
-   * numentries
+   * returns a source to the queue, see above
    *
    * @param source                source to be returned to the queue
    */
@@ -207,6 +333,32 @@ class DirectorySourceQueue : public SourceQueue {
   /// @return   returns list of directories which could not be opened
   std::vector<std::string> &getFailedDirectories();
 
+  /**
+   * Accounts a source sent without error, to know when the files with a
+   * deadline were completely sent
+   *
+   * @param source                source sent
+   */
+  void markSourceSent(const ByteSource &source);
+
+  /**
+   * Accounts the beginning of a failed source that the receiver got anyway,
+   * before the source is resumed after it
+   *
+   * @param source                source which failed
+   * @param numBytes              number of bytes received from its offset
+   */
+  void markSourcePartSent(const ByteSource &source, int64_t numBytes);
+
+  /**
+   * @param startTime             start time of the transfer
+   *
+   * @return                      whether the files with a deadline were sent
+   *                              in time, earliest deadline first
+   */
+  std::vector<FileDeadlineReport> getDeadlineReports(
+      const Clock::time_point &startTime);
+
   virtual ~DirectorySourceQueue();
 
   /// @return   discovered files metadata
@@ -264,6 +416,33 @@ class DirectorySourceQueue : public SourceQueue {
    */
   void createIntoQueueInternal(SourceMetaData *metadata);
 
+  /**
+   * Dequeues and opens the next source, sources failing to open are added
+   * to the failed sources
+   *
+   * @param callerThreadCtx   context of the calling thread
+   * @param waitForDiscovery  whether to wait for discovery while the queue
+   *                          is empty
+   * @param maxSize           max size of the source to return, -1 for any
+   * @param status            set to the status of the transfer
+   *
+   * @return                  next source, nullptr if there is none
+   */
+  std::unique_ptr<ByteSource> dequeueSource(ThreadCtx *callerThreadCtx,
+                                            bool waitForDiscovery,
+                                            int64_t maxSize,
+                                            ErrorCode &status);
+
+  /**
+   * Starts tracking a file with a deadline. Lock must be held before calling
+   * this.
+   *
+   * @param metadata             file meta-data
+   * @param remainingChunks      chunks of the file to send
+   */
+  void trackDeadlineLocked(const SourceMetaData &metadata,
+                           const std::vector<Interval> &remainingChunks);
+
   /**
    * when adding multiple files, we have the option of using notify_one multiple
    * times or notify_all once. Depending on number of added sources, this
@@ -306,6 +485,9 @@ class DirectorySourceQueue : public SourceQueue {
   /// condition variable indicating sourceQueue_ is not empty
   mutable std::condition_variable conditionNotEmpty_;
 
+  /// notified on every discovered file and at the end of discovery
+  mutable std::condition_variable conditionDiscovery_;
+
   /// Indicates whether init() has been called to prevent multiple calls
   bool initCalled_{false};
 
@@ -323,6 +505,18 @@ class DirectorySourceQueue : public SourceQueue {
         // always send files to be deleted first
         return toBeDeleted2;
       }
+      const SourceMetaData &metadata1 = source1->getMetaData();
+      const SourceMetaData &metadata2 = source2->getMetaData();
+      if (metadata1.priority != metadata2.priority) {
+        return metadata1.priority < metadata2.priority;
+      }
+      if (metadata1.deadlineMillis != metadata2.deadlineMillis) {
+        // files without deadline (0) come last
+        if (metadata1.deadlineMillis == 0 || metadata2.deadlineMillis == 0) {
+          return metadata1.deadlineMillis == 0;
+        }
+        return metadata1.deadlineMillis > metadata2.deadlineMillis;
+      }
 
       auto retryCount1 = source1->getTransferStats().getFailedAttempts();
       auto retryCount2 = source2->getTransferStats().getFailedAttempts();
@@ -340,11 +534,11 @@ class DirectorySourceQueue : public SourceQueue {
   };
 
   /**
-   * priority queue of sources. Sources are first ordered by increasing
-   * failedAttempts, then by decreasing size. If sizes are equal(always for
-   * blocks), sources are ordered by offset. This way, we ensure that all the
-   * threads in the receiver side are not writing to the same file at the same
-   * time.
+   * priority queue of sources. Sources are first ordered by decreasing
+   * priority and increasing deadline, then by increasing failedAttempts, then
+   * by decreasing size. If sizes are equal(always for blocks), sources are
+   * ordered by offset. This way, we ensure that all the threads in the
+   * receiver side are not writing to the same file at the same time.
    */
   std::priority_queue<std::unique_ptr<ByteSource>,
                       std::vector<std::unique_ptr<ByteSource>>,
@@ -356,6 +550,20 @@ class DirectorySourceQueue : public SourceQueue {
   /// directories which could not be opened
   std::vector<std::string> failedDirectories_;
 
+  /// Sending progress of a file with a deadline
+  struct DeadlineProgress {
+    std::string relPath;
+    int64_t fileSize{0};
+    int64_t deadlineMillis{0};
+    /// chunks sent so far, including the ones of a previous transfer
+    FileChunksInfo sentChunks;
+    bool sent{false};
+    Clock::time_point sentTime;
+  };
+
+  /// files with a deadline by seq-id
+  std::unordered_map<int64_t, DeadlineProgress> deadlines_;
+
   /// Total number of files that have passed through the queue
   int64_t numEntries_{0};
 
@@ -383,6 +591,67 @@ class DirectorySourceQueue : public SourceQueue {
   /// A map from relative file name to previously received chunks
   std::unordered_map<std::string, FileChunksInfo> previouslyTransferredChunks_;
 
+  /// whether blocks are added with addBlock() instead of discovered
+  bool externalBlocks_{false};
+
+  /// reads a stream added with addStream(), runs in its own thread
+  void produceStream(SourceMetaData *metadata,
+                     std::shared_ptr<StreamReader> reader);
+
+  /// ends the discovery if all the external blocks and streams were added
+  void endExternalDiscoveryLocked();
+
+  /// creates the metadata of a file of external blocks or sources
+  SourceMetaData *newExternalFileLocked(const std::string &relPath,
+                                        const std::string &fullPath,
+                                        int64_t fileSize);
+
+  /// metadata of the external blocks and sources, by relative path
+  std::unordered_map<std::string, SourceMetaData *> externalFiles_;
+
+  /// whether finishAddingBlocks() was called
+  bool addingFinished_{false};
+
+  /// streams still being read
+  int numActiveStreams_{0};
+
+  /// threads reading the streams
+  std::vector<std::thread> streamThreads_;
+
+  /// set by the destructor, so that the streams stop waiting for data
+  std::atomic<bool> streamsAborted_{false};
+
+  /// Abort checker of the stream reads, also aborts them when the queue is
+  /// destroyed before the streams ended
+  class StreamAbortChecker : public IAbortChecker {
+   public:
+    explicit StreamAbortChecker(const DirectorySourceQueue *queue)
+        : queue_(queue) {
+    }
+
+    bool shouldAbort() const override;
+
+   private:
+    const DirectorySourceQueue *queue_;
+  };
+
+  StreamAbortChecker streamAbortChecker_{this};
+
+  /// block size of the streams when block transfer is disabled
+  static const int64_t kDefaultStreamBlockMbytes = 16;
+
+  /// interval of the abort checks while waiting for the discovery
+  static const int64_t kAbortCheckMillis = 100;
+
+  /// gets the discovered blocks instead of the queue, if set
+  BlockListener *blockListener_{nullptr};
+
+  /// cache shared with other destinations for the external blocks
+  SharedBlockCache *blockCache_{nullptr};
+
+  /// destination of this queue in blockCache_
+  int blockCacheConsumer_{0};
+
   /// Stores the time difference between the start and the end of the
   /// traversal of directory
   double directoryTime_{0};
@@ -7,8 +7,10 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 #include <wdt/util/FileByteSource.h>
+#include <wdt/util/Tracepoints.h>
 
 #include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <glog/logging.h>
 #include <sys/types.h>
@@ -26,10 +28,12 @@ int FileUtil::openForRead(ThreadCtx &threadCtx, const std::string &filename,
 #endif
   }
   int fd;
+  WDT_TRACEPOINT1(file__open__start, filename.c_str());
   {
     PerfStatCollector statCollector(threadCtx, PerfStatReport::FILE_OPEN);
     fd = ::open(filename.c_str(), openFlags);
   }
+  WDT_TRACEPOINT2(file__open__done, filename.c_str(), fd);
   if (fd >= 0) {
     if (isDirectReads) {
 #ifndef O_DIRECT
@@ -90,13 +94,56 @@ ErrorCode FileByteSource::open(ThreadCtx *threadCtx) {
     }
   }
 
+  if (errCode == OK && blockCache_ != nullptr && !cacheTried_ &&
+      !alignedReadNeeded_) {
+    acquireCachedBlock();
+  }
   transferStats_.setLocalErrorCode(errCode);
   return errCode;
 }
 
+void FileByteSource::acquireCachedBlock() {
+  cacheTried_ = true;
+  SharedBlockCache::BlockData data;
+  auto result = blockCache_->acquire(blockCacheConsumer_, metadata_->fullPath,
+                                    offset_, size_, data);
+  if (result == SharedBlockCache::LOAD) {
+    const bool success = readFully(data->data(), size_, offset_);
+    blockCache_->loaded(metadata_->fullPath, offset_, success);
+    if (!success) {
+      return;
+    }
+  } else if (result == SharedBlockCache::BYPASS) {
+    return;
+  }
+  cachedBlock_ = std::move(data);
+}
+
+bool FileByteSource::readFully(char *data, int64_t size, int64_t offset) {
+  int64_t totalRead = 0;
+  while (totalRead < size) {
+    int64_t numRead;
+    {
+      PerfStatCollector statCollector(*threadCtx_, PerfStatReport::FILE_READ);
+      numRead = ::pread(fd_, data + totalRead, size - totalRead,
+                        offset + totalRead);
+    }
+    if (numRead <= 0) {
+      PLOG(ERROR) << "Failure while reading block of " << metadata_->fullPath
+                  << " offset " << offset << " size " << size << " read "
+                  << totalRead;
+      return false;
+    }
+    totalRead += numRead;
+  }
+  return true;
+}
+
 void FileByteSource::advanceOffset(int64_t numBytes) {
   offset_ += numBytes;
   size_ -= numBytes;
+  // the cached data starts at the original offset
+  cachedBlock_.reset();
 }
 
 char *FileByteSource::read(int64_t &size) {
@@ -105,6 +152,13 @@ char *FileByteSource::read(int64_t &size) {
     return nullptr;
   }
   const Buffer *buffer = threadCtx_->getBuffer();
+  if (cachedBlock_) {
+    // copied since the socket encrypts the data in place
+    size = std::min<int64_t>(buffer->getSize(), size_ - bytesRead_);
+    memcpy(buffer->getData(), cachedBlock_->data() + bytesRead_, size);
+    bytesRead_ += size;
+    return buffer->getData();
+  }
   int64_t offsetRemainder = 0;
   if (alignedReadNeeded_) {
     offsetRemainder = (offset_ + bytesRead_) % kDiskBlockSize;
@@ -119,10 +173,12 @@ char *FileByteSource::read(int64_t &size) {
   }
   const int64_t seekPos = (offset_ + bytesRead_) - offsetRemainder;
   int numRead;
+  WDT_TRACEPOINT3(file__read__start, fd_, seekPos, physicalRead);
   {
     PerfStatCollector statCollector(*threadCtx_, PerfStatReport::FILE_READ);
     numRead = ::pread(fd_, buffer->getData(), physicalRead, seekPos);
   }
+  WDT_TRACEPOINT4(file__read__done, fd_, seekPos, physicalRead, numRead);
   if (numRead < 0) {
     PLOG(ERROR) << "Failure while reading file " << metadata_->fullPath
                 << " need align " << alignedReadNeeded_ << " physicalRead "
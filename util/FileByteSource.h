@@ -12,6 +12,7 @@
 
 #include <wdt/ByteSource.h>
 #include <wdt/util/CommonImpl.h>
+#include <wdt/util/SharedBlockCache.h>
 
 namespace facebook {
 namespace wdt {
@@ -54,6 +55,18 @@ class FileByteSource : public ByteSource {
     this->close();
   }
 
+  /**
+   * Shares the read of the block with the sources of other destinations,
+   * only used the first time the source is opened
+   *
+   * @param blockCache    cache of the blocks of all the destinations
+   * @param consumer      destination of this source in the cache
+   */
+  void setBlockCache(SharedBlockCache *blockCache, int consumer) {
+    blockCache_ = blockCache;
+    blockCacheConsumer_ = consumer;
+  }
+
   /// @return filepath
   virtual const std::string &getIdentifier() const override {
     return metadata_->relPath;
@@ -105,6 +118,7 @@ class FileByteSource : public ByteSource {
     }
     fd_ = -1;
     threadCtx_ = nullptr;
+    cachedBlock_.reset();
   }
 
   /**
@@ -121,8 +135,26 @@ class FileByteSource : public ByteSource {
   }
 
  private:
+  /// gets the whole block from blockCache_, reading it if needed
+  void acquireCachedBlock();
+
+  /// reads size bytes at offset into data, @return success
+  bool readFully(char *data, int64_t size, int64_t offset);
+
   ThreadCtx *threadCtx_{nullptr};
 
+  /// cache shared with other destinations, null if not shared
+  SharedBlockCache *blockCache_{nullptr};
+
+  /// destination of this source in blockCache_
+  int blockCacheConsumer_{0};
+
+  /// whether the block was already looked up in blockCache_
+  bool cacheTried_{false};
+
+  /// data of the whole block if it came from blockCache_
+  SharedBlockCache::BlockData cachedBlock_;
+
   /// shared file information
   SourceMetaData *metadata_;
 
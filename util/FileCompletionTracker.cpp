@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/FileCompletionTracker.h>
+
+#include <glog/logging.h>
+#include <algorithm>
+
+namespace facebook {
+namespace wdt {
+
+FileCompletionTracker::FileCompletionTracker(
+    std::shared_ptr<FileCompletionListener> listener)
+    : listener_(std::move(listener)) {
+}
+
+bool FileCompletionTracker::isComplete(FileChunksInfo &chunksInfo) {
+  const int64_t fileSize = chunksInfo.getFileSize();
+  const auto &chunks = chunksInfo.getChunks();
+  // until the last block of a stream, the ranges go beyond the known size
+  if (!chunks.empty() && chunks.back().end_ > fileSize) {
+    return false;
+  }
+  return chunksInfo.getRemainingChunks(fileSize).empty();
+}
+
+void FileCompletionTracker::reset(
+    const std::vector<FileChunksInfo> &previousChunks) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  files_.clear();
+  for (const FileChunksInfo &previous : previousChunks) {
+    FileProgress &progress = files_[previous.getSeqId()];
+    progress.chunksInfo.setSeqId(previous.getSeqId());
+    progress.chunksInfo.setFileName(previous.getFileName());
+    progress.chunksInfo.setFileSize(previous.getFileSize());
+    for (const Interval &chunk : previous.getChunks()) {
+      progress.chunksInfo.addChunk(chunk);
+    }
+    progress.chunksInfo.mergeChunks();
+    progress.completed = isComplete(progress.chunksInfo);
+  }
+}
+
+void FileCompletionTracker::addVerifiedBytes(const BlockDetails &blockDetails,
+                                             int64_t numBytes) {
+  if (blockDetails.allocationStatus == TO_BE_DELETED) {
+    return;
+  }
+  int64_t fileSize;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FileProgress &progress = files_[blockDetails.seqId];
+    FileChunksInfo &chunksInfo = progress.chunksInfo;
+    chunksInfo.setSeqId(blockDetails.seqId);
+    chunksInfo.setFileName(blockDetails.fileName);
+    chunksInfo.setFileSize(
+        std::max(chunksInfo.getFileSize(), blockDetails.fileSize));
+    if (numBytes > 0) {
+      chunksInfo.addChunk(
+          Interval(blockDetails.offset, blockDetails.offset + numBytes));
+      chunksInfo.mergeChunks();
+    }
+    if (progress.completed || !isComplete(chunksInfo)) {
+      return;
+    }
+    progress.completed = true;
+    fileSize = chunksInfo.getFileSize();
+  }
+  VLOG(1) << "Completed " << blockDetails.fileName << " seq-id "
+          << blockDetails.seqId << " size " << fileSize;
+  listener_->onFileComplete(blockDetails.fileName, blockDetails.seqId,
+                            fileSize);
+}
+}
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/Protocol.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/// Gets the files of a receiver as soon as they are complete
+/// (@see Receiver::setFileCompletionListener)
+class FileCompletionListener {
+ public:
+  /**
+   * Called once all the blocks of a file are written and verified, and
+   * fsynced when log based resumption is enabled. Called from the receiver
+   * thread which verified the last block, so it should hand the file over
+   * to another thread rather than process it
+   *
+   * @param fileName    path of the file relative to the destination directory
+   * @param seqId       seq-id of the file in the transfer
+   * @param fileSize    size of the file
+   */
+  virtual void onFileComplete(const std::string &fileName, int64_t seqId,
+                              int64_t fileSize) = 0;
+
+  virtual ~FileCompletionListener() {
+  }
+};
+
+/**
+ * Keeps the verified ranges of every file of a transfer and notifies the
+ * listener when they cover the whole file. Blocks of a file are verified by
+ * several threads in any order, and a resent block may cover bytes verified
+ * before, so the ranges are merged rather than counted. The size of a stream
+ * is only known with its last block (@see Sender::addStream), so the largest
+ * size seen is used.
+ */
+class FileCompletionTracker {
+ public:
+  /// @param listener   listener of the completed files
+  explicit FileCompletionTracker(
+      std::shared_ptr<FileCompletionListener> listener);
+
+  /**
+   * Starts a new transfer session
+   *
+   * @param previousChunks    chunks received by an earlier transfer, with
+   *                          download resumption. Files they already
+   *                          complete are not reported again
+   */
+  void reset(const std::vector<FileChunksInfo> &previousChunks);
+
+  /**
+   * Accounts bytes of a file which can not be received again, notifies the
+   * listener if they complete the file
+   *
+   * @param blockDetails    details of the block the bytes belong to
+   * @param numBytes        number of bytes verified
+   */
+  void addVerifiedBytes(const BlockDetails &blockDetails, int64_t numBytes);
+
+ private:
+  struct FileProgress {
+    /// merged verified ranges, with the largest file size seen
+    FileChunksInfo chunksInfo;
+    bool completed{false};
+  };
+
+  /// @return   whether the merged ranges cover the whole file
+  static bool isComplete(FileChunksInfo &chunksInfo);
+
+  std::shared_ptr<FileCompletionListener> listener_;
+  /// progress of the files by seq-id
+  std::unordered_map<int64_t, FileProgress> files_;
+  std::mutex mutex_;
+};
+}
+}
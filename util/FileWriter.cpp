@@ -8,6 +8,7 @@
  */
 #include <wdt/util/FileWriter.h>
 #include <wdt/util/CommonImpl.h>
+#include <wdt/util/Tracepoints.h>
 
 #include <fcntl.h>
 #include <gflags/gflags.h>
@@ -23,7 +24,9 @@ ErrorCode FileWriter::open() {
     return OK;
   }
   // TODO: consider a working optimization for small files
+  WDT_TRACEPOINT1(file__open__start, blockDetails_->fileName.c_str());
   fd_ = fileCreator_->openForBlocks(threadCtx_, blockDetails_);
+  WDT_TRACEPOINT2(file__open__done, blockDetails_->fileName.c_str(), fd_);
   if (blockDetails_->allocationStatus == TO_BE_DELETED) {
     WDT_CHECK_EQ(-1, fd_);
     return OK;
@@ -64,10 +67,12 @@ ErrorCode FileWriter::write(char *buf, int64_t size) {
     int64_t count = 0;
     while (count < size) {
       int64_t written;
+      WDT_TRACEPOINT2(file__write__start, fd_, size - count);
       {
         PerfStatCollector statCollector(threadCtx_, PerfStatReport::FILE_WRITE);
         written = ::write(fd_, buf + count, size - count);
       }
+      WDT_TRACEPOINT3(file__write__done, fd_, size - count, written);
       if (written == -1) {
         if (errno == EINTR) {
           VLOG(1) << "Disk write interrupted, retrying "
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/Histogram.h>
+
+#include <cmath>
+
+namespace facebook {
+namespace wdt {
+
+Histogram &Histogram::operator+=(const Histogram &other) {
+  for (int i = 0; i < kNumBuckets; i++) {
+    increment(counts_[i], load(other.counts_[i]));
+  }
+  increment(count_, load(other.count_));
+  increment(sum_, load(other.sum_));
+  const int64_t minValue = std::min(load(min_), load(other.min_));
+  const int64_t maxValue = std::max(load(max_), load(other.max_));
+  min_.store(minValue, std::memory_order_relaxed);
+  max_.store(maxValue, std::memory_order_relaxed);
+  return *this;
+}
+
+void Histogram::clear() {
+  for (auto &count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  min_.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+}
+
+int64_t Histogram::getBucketStart(int bucketIndex) {
+  if (bucketIndex < kSubBucketCount) {
+    return bucketIndex;
+  }
+  const int shift = bucketIndex / kSubBucketCount - 1;
+  const int64_t subBucket = bucketIndex % kSubBucketCount;
+  return (kSubBucketCount + subBucket) << shift;
+}
+
+int64_t Histogram::getBucketEnd(int bucketIndex) {
+  if (bucketIndex == kNumBuckets - 1) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return getBucketStart(bucketIndex + 1);
+}
+
+int64_t Histogram::getPercentile(double percentile) const {
+  const int64_t count = getCount();
+  if (count == 0) {
+    return 0;
+  }
+  const int64_t minValue = getMin();
+  const int64_t maxValue = getMax();
+  percentile = std::max(0.0, std::min(100.0, percentile));
+  int64_t targetCount = std::ceil(count * percentile / 100);
+  targetCount = std::max<int64_t>(1, targetCount);
+  int64_t runningCount = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    runningCount += getBucketCount(i);
+    if (runningCount >= targetCount) {
+      int64_t value = (i == kNumBuckets - 1) ? maxValue : getBucketEnd(i) - 1;
+      return std::max(minValue, std::min(maxValue, value));
+    }
+  }
+  return maxValue;
+}
+}
+}
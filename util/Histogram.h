@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Fixed memory log-linear (HDR style) histogram of non negative integer
+ * values (WDT uses it for durations in microseconds).
+ *
+ * Values below kSubBucketCount are recorded exactly. Above that, every power
+ * of 2 range is split in kSubBucketCount equal sub buckets, so the relative
+ * error of any reported value is at most 1/kSubBucketCount (6.25%). Values
+ * of 2^kMaxValueBits and above are clamped into the last bucket (min/max/sum
+ * stay exact).
+ *
+ * Recording is O(1) (a count leading zeros and an increment) and merging two
+ * histograms is a plain array addition. Only one thread (the owner) may
+ * record values, but any thread can read or merge from it concurrently
+ * without locking (all the fields are relaxed atomics, which compile to plain
+ * loads and stores), getting a slightly stale snapshot.
+ */
+class Histogram {
+ public:
+  Histogram() {
+    clear();
+  }
+
+  /// copies a snapshot of other
+  Histogram(const Histogram &other) {
+    clear();
+    *this += other;
+  }
+
+  Histogram &operator=(const Histogram &other) {
+    if (this != &other) {
+      clear();
+      *this += other;
+    }
+    return *this;
+  }
+
+  /// log2 of number of sub buckets per power of 2
+  static const int kSubBucketBits = 4;
+  /// number of sub buckets per power of 2
+  static const int kSubBucketCount = 1 << kSubBucketBits;
+  /// values >= 2^kMaxValueBits go in the last bucket (~12 days in micros)
+  static const int kMaxValueBits = 40;
+  /// total number of buckets
+  static const int kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+  /// @param value    value to record, negative values are recorded as 0
+  void record(int64_t value) {
+    if (value < 0) {
+      value = 0;
+    }
+    increment(counts_[getBucketIndex(value)], 1);
+    increment(count_, 1);
+    increment(sum_, value);
+    if (value < load(min_)) {
+      min_.store(value, std::memory_order_relaxed);
+    }
+    if (value > load(max_)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  /// adds all the values recorded in other to this histogram
+  Histogram &operator+=(const Histogram &other);
+
+  /// resets the histogram to its empty state
+  void clear();
+
+  /// @return   number of recorded values
+  int64_t getCount() const {
+    return load(count_);
+  }
+
+  /// @return   sum of all recorded values
+  int64_t getSum() const {
+    return load(sum_);
+  }
+
+  /// @return   smallest recorded value, 0 if empty
+  int64_t getMin() const {
+    return load(count_) == 0 ? 0 : load(min_);
+  }
+
+  /// @return   largest recorded value, 0 if empty
+  int64_t getMax() const {
+    return load(max_);
+  }
+
+  /// @return   average of the recorded values, 0 if empty
+  double getAverage() const {
+    const int64_t count = load(count_);
+    return count == 0 ? 0 : (double)load(sum_) / count;
+  }
+
+  /**
+   * @param percentile    percentile to compute, in [0, 100]
+   *
+   * @return              value at that percentile, i.e the highest value
+   *                      equivalent to the bucket containing it (clamped to
+   *                      the recorded min/max), 0 if empty
+   */
+  int64_t getPercentile(double percentile) const;
+
+  /// @return   number of values recorded in the given bucket
+  int64_t getBucketCount(int bucketIndex) const {
+    return load(counts_[bucketIndex]);
+  }
+
+  /// @return   index of the bucket the (non negative) value belongs to
+  static int getBucketIndex(int64_t value) {
+    const int64_t kMaxValue = (1LL << kMaxValueBits) - 1;
+    if (value < kSubBucketCount) {
+      return value;
+    }
+    value = std::min(value, kMaxValue);
+    const int msb = 63 - __builtin_clzll(value);
+    const int shift = msb - kSubBucketBits;
+    const int subBucket = (value >> shift) - kSubBucketCount;
+    return (shift + 1) * kSubBucketCount + subBucket;
+  }
+
+  /// @return   smallest value going into the given bucket
+  static int64_t getBucketStart(int bucketIndex);
+
+  /// @return   smallest value going into the next bucket (exclusive end)
+  static int64_t getBucketEnd(int bucketIndex);
+
+ private:
+  static int64_t load(const std::atomic<int64_t> &value) {
+    return value.load(std::memory_order_relaxed);
+  }
+
+  /// single writer increment, no need for an atomic read-modify-write
+  static void increment(std::atomic<int64_t> &value, int64_t delta) {
+    value.store(load(value) + delta, std::memory_order_relaxed);
+  }
+
+  /// number of values per bucket
+  std::atomic<int64_t> counts_[kNumBuckets];
+  /// total number of values
+  std::atomic<int64_t> count_;
+  /// sum of all values
+  std::atomic<int64_t> sum_;
+  /// smallest value
+  std::atomic<int64_t> min_;
+  /// largest value
+  std::atomic<int64_t> max_;
+};
+}
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/JsonWriter.h>
+
+#include <folly/Conv.h>
+#include <cmath>
+#include <cstdio>
+
+namespace facebook {
+namespace wdt {
+
+JsonWriter &JsonWriter::beginObject() {
+  beforeElement();
+  out_.push_back('{');
+  hasElement_.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+  hasElement_.pop_back();
+  out_.push_back('}');
+  return *this;
+}
+
+JsonWriter &JsonWriter::beginArray() {
+  beforeElement();
+  out_.push_back('[');
+  hasElement_.push_back(false);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+  hasElement_.pop_back();
+  out_.push_back(']');
+  return *this;
+}
+
+JsonWriter &JsonWriter::key(const std::string &name) {
+  beforeElement();
+  appendString(name);
+  out_.push_back(':');
+  afterKey_ = true;
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(int64_t v) {
+  beforeElement();
+  folly::toAppend(v, &out_);
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(double v) {
+  if (!std::isfinite(v)) {
+    return nullValue();
+  }
+  beforeElement();
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.15g", v);
+  out_.append(buf);
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(bool v) {
+  beforeElement();
+  out_.append(v ? "true" : "false");
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(const std::string &v) {
+  beforeElement();
+  appendString(v);
+  return *this;
+}
+
+JsonWriter &JsonWriter::nullValue() {
+  beforeElement();
+  out_.append("null");
+  return *this;
+}
+
+void JsonWriter::beforeElement() {
+  if (afterKey_) {
+    afterKey_ = false;
+    return;
+  }
+  if (hasElement_.empty()) {
+    return;
+  }
+  if (hasElement_.back()) {
+    out_.push_back(',');
+  }
+  hasElement_.back() = true;
+}
+
+void JsonWriter::appendString(const std::string &str) {
+  out_.push_back('"');
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        out_.append("\\\"");
+        break;
+      case '\\':
+        out_.append("\\\\");
+        break;
+      case '\n':
+        out_.append("\\n");
+        break;
+      case '\t':
+        out_.append("\\t");
+        break;
+      case '\r':
+        out_.append("\\r");
+        break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out_.append(buf);
+        } else {
+          out_.push_back(c);
+        }
+    }
+  }
+  out_.push_back('"');
+}
+}
+}
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Minimal streaming JSON writer used to produce machine readable reports.
+ * Commas are inserted automatically, callers only have to balance the
+ * begin/end calls and call key() before every value of an object:
+ *
+ *   JsonWriter json;
+ *   json.beginObject().key("bytes").value(bytes).endObject();
+ *   std::string text = json.str();
+ */
+class JsonWriter {
+ public:
+  JsonWriter &beginObject();
+  JsonWriter &endObject();
+  JsonWriter &beginArray();
+  JsonWriter &endArray();
+
+  /// @param name   name of the next member of the current object
+  JsonWriter &key(const std::string &name);
+
+  JsonWriter &value(int64_t v);
+  JsonWriter &value(int32_t v) {
+    return value((int64_t)v);
+  }
+  /// non finite numbers are written as null
+  JsonWriter &value(double v);
+  JsonWriter &value(bool v);
+  JsonWriter &value(const std::string &v);
+  JsonWriter &value(const char *v) {
+    return value(std::string(v));
+  }
+  JsonWriter &nullValue();
+
+  /// @return   the JSON text written so far
+  const std::string &str() const {
+    return out_;
+  }
+
+ private:
+  /// adds the separator needed before a new element
+  void beforeElement();
+
+  /// appends str as a quoted, escaped JSON string
+  void appendString(const std::string &str);
+
+  std::string out_;
+  /// for each open object/array, whether it already has an element
+  std::vector<bool> hasElement_;
+  /// whether a key was just written (the value needs no separator)
+  bool afterKey_{false};
+};
+}
+}
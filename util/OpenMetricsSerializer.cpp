@@ -0,0 +1,237 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/OpenMetricsSerializer.h>
+
+#include <wdt/ErrorCodes.h>
+#include <folly/Conv.h>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace facebook {
+namespace wdt {
+
+const double OpenMetricsSerializer::kHistogramBucketsSeconds[] = {
+    0.00001, 0.0001, 0.001, 0.01, 0.1, 1, 10};
+
+void OpenMetricsSerializer::addSample(const std::string &name, MetricType type,
+                                      const std::string &help,
+                                      const MetricLabels &labels,
+                                      double value) {
+  WDT_CHECK(type != HISTOGRAM) << "Use addHistogram for " << name;
+  MetricFamily &family = getFamily(name, type, help);
+  appendSample(family, type == COUNTER ? "_total" : "", labels, value);
+}
+
+void OpenMetricsSerializer::addHistogram(const std::string &name,
+                                         const std::string &help,
+                                         const MetricLabels &labels,
+                                         const Histogram &histogram) {
+  MetricFamily &family = getFamily(name, HISTOGRAM, help);
+  const int numBuckets =
+      sizeof(kHistogramBucketsSeconds) / sizeof(kHistogramBucketsSeconds[0]);
+  // fine buckets are walked once, each one is attributed to the first display
+  // bucket containing its (exclusive) end
+  int64_t cumulativeCount = 0;
+  int fineBucket = 0;
+  for (int i = 0; i < numBuckets; i++) {
+    const int64_t limitMicros =
+        std::llround(kHistogramBucketsSeconds[i] * 1000000);
+    while (fineBucket < Histogram::kNumBuckets &&
+           Histogram::getBucketEnd(fineBucket) <= limitMicros) {
+      cumulativeCount += histogram.getBucketCount(fineBucket);
+      fineBucket++;
+    }
+    MetricLabels bucketLabels = labels;
+    bucketLabels.emplace_back("le", formatValue(kHistogramBucketsSeconds[i]));
+    appendSample(family, "_bucket", bucketLabels, cumulativeCount);
+  }
+  // counts are read one by one while the owner may be recording, use the
+  // bucket total for +Inf and _count so that the exposition stays consistent
+  while (fineBucket < Histogram::kNumBuckets) {
+    cumulativeCount += histogram.getBucketCount(fineBucket);
+    fineBucket++;
+  }
+  MetricLabels infLabels = labels;
+  infLabels.emplace_back("le", "+Inf");
+  appendSample(family, "_bucket", infLabels, cumulativeCount);
+  appendSample(family, "_sum", labels, histogram.getSum() / 1000000.0);
+  appendSample(family, "_count", labels, cumulativeCount);
+}
+
+void OpenMetricsSerializer::addTransferReport(const TransferReport &report,
+                                              const MetricLabels &labels) {
+  const TransferStats &summary = report.getSummary();
+  MetricLabels headerLabels = labels;
+  headerLabels.emplace_back("kind", "header");
+  MetricLabels dataLabels = labels;
+  dataLabels.emplace_back("kind", "data");
+  const std::string bytesHelp =
+      "Bytes sent or received, including the ones later retransmitted";
+  addSample("wdt_bytes", COUNTER, bytesHelp, headerLabels,
+            summary.getHeaderBytes());
+  addSample("wdt_bytes", COUNTER, bytesHelp, dataLabels,
+            summary.getDataBytes());
+  const std::string effectiveHelp = "Bytes of successfully transferred blocks";
+  addSample("wdt_effective_bytes", COUNTER, effectiveHelp, headerLabels,
+            summary.getEffectiveHeaderBytes());
+  addSample("wdt_effective_bytes", COUNTER, effectiveHelp, dataLabels,
+            summary.getEffectiveDataBytes());
+  addSample("wdt_files", COUNTER, "Files successfully transferred", labels,
+            summary.getNumFiles());
+  addSample("wdt_blocks", COUNTER, "Blocks successfully transferred", labels,
+            summary.getNumBlocks());
+  addSample("wdt_failed_attempts", COUNTER, "Failed block transfer attempts",
+            labels, summary.getFailedAttempts());
+  const ActivityTimes activityTimes = report.getActivityTimes();
+  for (int i = 0; i < NUM_THREAD_ACTIVITIES; i++) {
+    MetricLabels activityLabels = labels;
+    activityLabels.emplace_back("activity",
+                                threadActivityToStr((ThreadActivity)i));
+    addSample("wdt_thread_time_seconds", COUNTER,
+              "Time spent by the transfer threads per activity",
+              activityLabels, activityTimes[i] / 1000000.0);
+  }
+  if (report.getTotalTime() > 0) {
+    addSample("wdt_elapsed_seconds", GAUGE, "Time since the transfer started",
+              labels, report.getTotalTime());
+    addSample("wdt_throughput_bytes_per_second", GAUGE,
+              "Average effective throughput of the transfer", labels,
+              report.getThroughputMBps() * kMbToB);
+  }
+  if (report.getTotalFileSize() > 0) {
+    addSample("wdt_total_file_size_bytes", GAUGE,
+              "Total size of the files to transfer", labels,
+              report.getTotalFileSize());
+  }
+  MetricLabels statusLabels = labels;
+  statusLabels.emplace_back("error_code",
+                            errorCodeToStr(summary.getErrorCode()));
+  addSample("wdt_status", GAUGE, "Current error code of the transfer",
+            statusLabels, 1);
+}
+
+void OpenMetricsSerializer::addPerfStatReport(const PerfStatReport &report,
+                                              const MetricLabels &labels) {
+  for (int i = 0; i < PerfStatReport::END; i++) {
+    const auto statType = (PerfStatReport::StatType)i;
+    const Histogram &histogram = report.getHistogram(statType);
+    if (histogram.getCount() == 0) {
+      continue;
+    }
+    MetricLabels statLabels = labels;
+    statLabels.emplace_back("stat", PerfStatReport::getStatTypeName(statType));
+    addHistogram("wdt_perf_seconds", "Duration of the instrumented operations",
+                 statLabels, histogram);
+  }
+}
+
+void OpenMetricsSerializer::addThrottler(Throttler &throttler,
+                                         const MetricLabels &labels) {
+  addSample("wdt_throttler_avg_rate_bytes_per_second", GAUGE,
+            "Configured average rate of the throttler", labels,
+            throttler.getAvgRateBytesPerSec());
+  addSample("wdt_throttler_peak_rate_bytes_per_second", GAUGE,
+            "Configured peak rate of the throttler", labels,
+            throttler.getPeakRateBytesPerSec());
+  addSample("wdt_throttler_progress_bytes", GAUGE,
+            "Bytes accounted by the throttler", labels,
+            throttler.getBytesProgress());
+}
+
+std::string OpenMetricsSerializer::serialize() const {
+  static const char *kTypeNames[] = {"gauge", "counter", "histogram"};
+  std::string result;
+  for (const auto &family : families_) {
+    std::string help;
+    for (char c : family.help) {
+      if (c == '\\') {
+        help.append("\\\\");
+      } else if (c == '\n') {
+        help.append("\\n");
+      } else {
+        help.push_back(c);
+      }
+    }
+    folly::toAppend("# HELP ", family.name, " ", help, "\n", &result);
+    folly::toAppend("# TYPE ", family.name, " ", kTypeNames[family.type], "\n",
+                    &result);
+    for (const auto &sample : family.samples) {
+      folly::toAppend(sample, "\n", &result);
+    }
+  }
+  result.append("# EOF\n");
+  return result;
+}
+
+OpenMetricsSerializer::MetricFamily &OpenMetricsSerializer::getFamily(
+    const std::string &name, MetricType type, const std::string &help) {
+  for (auto &family : families_) {
+    if (family.name == name) {
+      WDT_CHECK(family.type == type) << "Type mismatch for metric " << name;
+      return family;
+    }
+  }
+  families_.push_back({name, type, help, {}});
+  return families_.back();
+}
+
+void OpenMetricsSerializer::appendSample(MetricFamily &family,
+                                         const std::string &suffix,
+                                         const MetricLabels &labels,
+                                         double value) {
+  family.samples.push_back(folly::to<std::string>(
+      family.name, suffix, formatLabels(labels), " ", formatValue(value)));
+}
+
+std::string OpenMetricsSerializer::formatLabels(const MetricLabels &labels) {
+  if (labels.empty()) {
+    return "";
+  }
+  std::string result = "{";
+  bool first = true;
+  for (const auto &label : labels) {
+    if (!first) {
+      result.push_back(',');
+    }
+    first = false;
+    folly::toAppend(label.first, "=\"", &result);
+    for (char c : label.second) {
+      if (c == '\\' || c == '"') {
+        result.push_back('\\');
+        result.push_back(c);
+      } else if (c == '\n') {
+        result.append("\\n");
+      } else {
+        result.push_back(c);
+      }
+    }
+    result.push_back('"');
+  }
+  result.push_back('}');
+  return result;
+}
+
+std::string OpenMetricsSerializer::formatValue(double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  // integral values (counts, bytes) are printed exactly
+  if (value == std::floor(value) && std::fabs(value) < 1e15) {
+    return folly::to<std::string>((int64_t)value);
+  }
+  std::ostringstream os;
+  os << std::setprecision(12) << value;
+  return os.str();
+}
+}
+}
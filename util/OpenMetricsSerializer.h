@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/Reporting.h>
+#include <wdt/Throttler.h>
+#include <wdt/util/Histogram.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/// ordered list of (label name, label value) attached to a sample
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+/**
+ * Builds an OpenMetrics (Prometheus text exposition) document out of wdt
+ * reports, so that long running wdt users can expose live transfer metrics
+ * to a scraper. Samples of the same metric family are grouped under a single
+ * HELP/TYPE header, in the order the families were first added.
+ *
+ * This class is not thread safe, one instance is meant to be used for one
+ * scrape.
+ */
+class OpenMetricsSerializer {
+ public:
+  enum MetricType {
+    GAUGE,
+    COUNTER,
+    HISTOGRAM,
+  };
+
+  /**
+   * Adds one sample
+   *
+   * @param name      metric family name, for counters without the "_total"
+   *                  suffix (it is added to the sample)
+   * @param type      gauge or counter
+   * @param help      help text of the family
+   * @param labels    labels of the sample
+   * @param value     value of the sample
+   */
+  void addSample(const std::string &name, MetricType type,
+                 const std::string &help, const MetricLabels &labels,
+                 double value);
+
+  /**
+   * Adds a histogram of durations recorded in microseconds. The fine grained
+   * histogram buckets are folded in a few buckets expressed in seconds.
+   */
+  void addHistogram(const std::string &name, const std::string &help,
+                    const MetricLabels &labels, const Histogram &histogram);
+
+  /// Adds byte/block counters, thread activity times and throughput
+  void addTransferReport(const TransferReport &report,
+                         const MetricLabels &labels);
+
+  /// Adds one duration histogram per non empty perf stat type
+  void addPerfStatReport(const PerfStatReport &report,
+                         const MetricLabels &labels);
+
+  /// Adds the configured rates and the current progress of the throttler
+  void addThrottler(Throttler &throttler, const MetricLabels &labels);
+
+  /// @return   the OpenMetrics text, terminated by "# EOF"
+  std::string serialize() const;
+
+  /// upper bounds (in seconds) of the buckets used by addHistogram
+  static const double kHistogramBucketsSeconds[];
+
+ private:
+  struct MetricFamily {
+    std::string name;
+    MetricType type;
+    std::string help;
+    /// already formatted sample lines
+    std::vector<std::string> samples;
+  };
+
+  /// @return   the family with that name, created if needed
+  MetricFamily &getFamily(const std::string &name, MetricType type,
+                          const std::string &help);
+
+  /// appends one sample line to the family
+  static void appendSample(MetricFamily &family, const std::string &suffix,
+                           const MetricLabels &labels, double value);
+
+  /// @return   labels formatted as {name="value",...}, empty if no labels
+  static std::string formatLabels(const MetricLabels &labels);
+
+  /// @return   value formatted as required by the format (+Inf, NaN...)
+  static std::string formatValue(double value);
+
+  std::vector<MetricFamily> families_;
+};
+}
+}
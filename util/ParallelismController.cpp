@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ParallelismController.h>
+#include <wdt/ErrorCodes.h>
+#include <wdt/Reporting.h>
+
+#include <glog/logging.h>
+#include <chrono>
+
+namespace facebook {
+namespace wdt {
+
+const int ParallelismController::kReprobeIntervals;
+const int ParallelismController::kStandbyCheckMillis;
+
+ParallelismController::ParallelismController(int numConnections,
+                                             double minGain)
+    : minGain_(minGain),
+      states_(numConnections, STANDBY),
+      ended_(numConnections, false) {
+  WDT_CHECK(numConnections > 0);
+  activateLocked(0);
+}
+
+void ParallelismController::activateLocked(int index) {
+  states_[index] = ACTIVE;
+  ++numRunning_;
+  cv_.notify_all();
+}
+
+bool ParallelismController::waitForActivation(
+    int index, IAbortChecker const *abortChecker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (states_[index] == STANDBY) {
+    if (numRunning_ == 0) {
+      // all the used connections are done, the transfer is over
+      return false;
+    }
+    if (abortChecker && abortChecker->shouldAbort()) {
+      return false;
+    }
+    cv_.wait_for(lock, std::chrono::milliseconds(kStandbyCheckMillis));
+  }
+  return true;
+}
+
+void ParallelismController::activate(int index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (states_[index] == STANDBY) {
+    activateLocked(index);
+  }
+}
+
+void ParallelismController::activateAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < states_.size(); i++) {
+    if (states_[i] == STANDBY && !ended_[i]) {
+      activateLocked(i);
+    }
+  }
+}
+
+bool ParallelismController::isRetired(int index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return states_[index] == RETIRED;
+}
+
+bool ParallelismController::wasActivated(int index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return states_[index] != STANDBY;
+}
+
+void ParallelismController::markEnded(int index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ended_[index]) {
+    return;
+  }
+  ended_[index] = true;
+  if (states_[index] != STANDBY) {
+    --numRunning_;
+    cv_.notify_all();
+  }
+}
+
+int ParallelismController::getNumActive() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int numActive = 0;
+  for (auto state : states_) {
+    numActive += (state == ACTIVE);
+  }
+  return numActive;
+}
+
+bool ParallelismController::activateOneLocked() {
+  for (size_t i = 0; i < states_.size(); i++) {
+    if (states_[i] == STANDBY && !ended_[i]) {
+      LOG(INFO) << "Opening connection " << i << " after measuring "
+                << lastThroughput_ / kMbToB << " Mbytes/sec";
+      activateLocked(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ParallelismController::retireSlowestLocked(
+    const std::vector<double> &throughputs) {
+  int slowest = -1;
+  int numActive = 0;
+  for (size_t i = 0; i < states_.size(); i++) {
+    if (states_[i] != ACTIVE || ended_[i]) {
+      continue;
+    }
+    ++numActive;
+    if (slowest < 0 || throughputs[i] < throughputs[slowest]) {
+      slowest = i;
+    }
+  }
+  retirePending_ = false;
+  if (numActive <= 1) {
+    return;
+  }
+  LOG(INFO) << "Retiring connection " << slowest << " with "
+            << throughputs[slowest] / kMbToB << " Mbytes/sec";
+  states_[slowest] = RETIRED;
+}
+
+void ParallelismController::update(const std::vector<double> &throughputs,
+                                   bool hasPendingWork, bool canRetire) {
+  WDT_CHECK_EQ(throughputs.size(), states_.size());
+  double totalThroughput = 0;
+  for (double throughput : throughputs) {
+    totalThroughput += throughput;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (probing_) {
+    probing_ = false;
+    intervalsSinceChange_ = 0;
+    if (totalThroughput >= lastThroughput_ * (1 + minGain_)) {
+      // last connection helped, try one more
+      lastThroughput_ = totalThroughput;
+      probing_ = hasPendingWork && activateOneLocked();
+      return;
+    }
+    VLOG(1) << "Last connection did not help " << totalThroughput / kMbToB
+            << " vs " << lastThroughput_ / kMbToB << " Mbytes/sec";
+    retirePending_ = true;
+  } else if (++intervalsSinceChange_ >= kReprobeIntervals && hasPendingWork &&
+             !retirePending_) {
+    // network conditions might have changed since the last change
+    intervalsSinceChange_ = 0;
+    probing_ = activateOneLocked();
+  }
+  if (retirePending_ && canRetire) {
+    retireSlowestLocked(throughputs);
+  }
+  lastThroughput_ = totalThroughput;
+}
+}
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/AbortChecker.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Decides how many of the sender connections are used (dynamic_parallelism
+ * option). The transfer starts with the first connection only, the others
+ * are in standby: their threads wait before connecting. Every interval the
+ * sender reports the throughput of each connection. As long as the last
+ * opened connection improved the aggregate throughput, one more is opened.
+ * When it did not, the slowest connection is retired: its thread stops
+ * taking blocks and sends the done cmd, the remaining connections send the
+ * rest. Retiring waits for file discovery to be over since the done cmd
+ * carries the final number of blocks.
+ * Every kReprobeIntervals steady intervals another connection is tried in
+ * case the network conditions changed. Standby connections which are never
+ * needed are not opened at all.
+ */
+class ParallelismController {
+ public:
+  /**
+   * @param numConnections    maximum number of connections (ports)
+   * @param minGain           minimum relative gain in aggregate throughput
+   *                          for a new connection to be kept
+   */
+  ParallelismController(int numConnections, double minGain);
+
+  /**
+   * Called by a sender thread before connecting, blocks while its
+   * connection is in standby
+   *
+   * @param index           connection/thread index
+   * @param abortChecker    abort checker of the thread
+   *
+   * @return                true once the connection is activated, false if
+   *                        the transfer finished without it or got aborted
+   */
+  bool waitForActivation(int index, IAbortChecker const *abortChecker);
+
+  /// activates a connection right away, for receivers without support
+  void activate(int index);
+
+  /// activates all the standby connections, when no adjustment is needed
+  void activateAll();
+
+  /// @return   whether the connection got retired and should stop sending
+  bool isRetired(int index);
+
+  /// @return   whether the connection was used by the transfer
+  bool wasActivated(int index);
+
+  /// marks the thread of the connection as ended
+  void markEnded(int index);
+
+  /**
+   * Adjusts the number of connections after an interval
+   *
+   * @param throughputs       throughput of every connection during the
+   *                          interval
+   * @param hasPendingWork    whether a new connection would have something
+   *                          to send
+   * @param canRetire         whether connections can be retired
+   */
+  void update(const std::vector<double> &throughputs, bool hasPendingWork,
+              bool canRetire);
+
+  /// @return   number of active (neither standby nor retired) connections
+  int getNumActive();
+
+ private:
+  enum ConnectionState { STANDBY, ACTIVE, RETIRED };
+
+  /// activates the first standby connection, @return false if there is none
+  bool activateOneLocked();
+
+  /// retires the slowest active connection if more than one is active
+  void retireSlowestLocked(const std::vector<double> &throughputs);
+
+  void activateLocked(int index);
+
+  /// steady intervals after which one more connection is tried
+  static const int kReprobeIntervals = 10;
+  /// interval between abort checks of the standby threads
+  static const int kStandbyCheckMillis = 100;
+
+  const double minGain_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<ConnectionState> states_;
+  std::vector<bool> ended_;
+  /// activated connections whose thread did not end yet
+  int numRunning_{0};
+  /// whether the last interval measured a newly opened connection
+  bool probing_{true};
+  /// whether a connection should be retired as soon as it is allowed
+  bool retirePending_{false};
+  int intervalsSinceChange_{0};
+  double lastThroughput_{0};
+};
+}
+}
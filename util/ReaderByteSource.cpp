@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/ReaderByteSource.h>
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+
+namespace facebook {
+namespace wdt {
+
+MemorySourceReader::MemorySourceReader(
+    const std::vector<struct iovec> &segments)
+    : segments_(segments) {
+  for (const auto &segment : segments_) {
+    segmentOffsets_.push_back(size_);
+    size_ += segment.iov_len;
+  }
+}
+
+MemorySourceReader::MemorySourceReader(
+    std::shared_ptr<const std::string> buffer)
+    : buffer_(std::move(buffer)) {
+  struct iovec segment;
+  segment.iov_base = const_cast<char *>(buffer_->data());
+  segment.iov_len = buffer_->size();
+  segments_.push_back(segment);
+  segmentOffsets_.push_back(0);
+  size_ = buffer_->size();
+}
+
+int64_t MemorySourceReader::getSize() const {
+  return size_;
+}
+
+int64_t MemorySourceReader::read(int64_t offset, char *buf, int64_t size) {
+  if (offset < 0 || offset + size > size_) {
+    LOG(ERROR) << "Read of " << size << " bytes at " << offset
+               << " past the end of the memory source " << size_;
+    return -1;
+  }
+  // last segment starting at or before the offset
+  size_t index = std::upper_bound(segmentOffsets_.begin(),
+                                  segmentOffsets_.end(), offset) -
+                 segmentOffsets_.begin() - 1;
+  int64_t numRead = 0;
+  while (numRead < size) {
+    const auto &segment = segments_[index];
+    const int64_t segmentOffset = offset + numRead - segmentOffsets_[index];
+    const int64_t toCopy = std::min<int64_t>(
+        size - numRead, segment.iov_len - segmentOffset);
+    memcpy(buf + numRead, (const char *)segment.iov_base + segmentOffset,
+           toCopy);
+    numRead += toCopy;
+    index++;
+  }
+  return numRead;
+}
+
+ReaderByteSource::ReaderByteSource(SourceMetaData *metadata,
+                                   std::shared_ptr<SourceReader> reader,
+                                   int64_t size, int64_t offset)
+    : metadata_(metadata),
+      reader_(std::move(reader)),
+      size_(size),
+      offset_(offset) {
+  transferStats_.setId(getIdentifier());
+}
+
+ErrorCode ReaderByteSource::open(ThreadCtx *threadCtx) {
+  threadCtx_ = threadCtx;
+  bytesRead_ = 0;
+  hasError_ = false;
+  transferStats_.setLocalErrorCode(OK);
+  return OK;
+}
+
+void ReaderByteSource::advanceOffset(int64_t numBytes) {
+  offset_ += numBytes;
+  size_ -= numBytes;
+}
+
+char *ReaderByteSource::read(int64_t &size) {
+  size = 0;
+  if (hasError_ || finished()) {
+    return nullptr;
+  }
+  const Buffer *buffer = threadCtx_->getBuffer();
+  const int64_t toRead =
+      std::min<int64_t>(buffer->getSize(), size_ - bytesRead_);
+  int64_t numRead;
+  {
+    PerfStatCollector statCollector(*threadCtx_, PerfStatReport::FILE_READ);
+    numRead = reader_->read(offset_ + bytesRead_, buffer->getData(), toRead);
+  }
+  if (numRead <= 0) {
+    LOG(ERROR) << "Failure while reading " << getIdentifier() << " offset "
+               << offset_ + bytesRead_ << " size " << toRead;
+    hasError_ = true;
+    transferStats_.setLocalErrorCode(BYTE_SOURCE_READ_ERROR);
+    return nullptr;
+  }
+  size = numRead;
+  bytesRead_ += numRead;
+  return buffer->getData();
+}
+}
+}
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <sys/uio.h>
+
+#include <wdt/ByteSource.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Produces the content of a source which is not a file, e.g. application
+ * memory or data generated on demand. Blocks of the same source are read by
+ * several threads at once and are read again when retried, so reads must be
+ * thread safe and repeatable for any offset.
+ */
+class SourceReader {
+ public:
+  virtual ~SourceReader() {
+  }
+
+  /**
+   * Reads part of the source
+   *
+   * @param offset    offset in the source
+   * @param buf       buffer to fill
+   * @param size      number of bytes to read, never past the end
+   *
+   * @return          number of bytes read, <= 0 on error
+   */
+  virtual int64_t read(int64_t offset, char *buf, int64_t size) = 0;
+};
+
+/// SourceReader for data already in memory
+class MemorySourceReader : public SourceReader {
+ public:
+  /**
+   * @param segments    segments of the source, the memory must stay valid
+   *                    until the transfer is over
+   */
+  explicit MemorySourceReader(const std::vector<struct iovec> &segments);
+
+  /// @param buffer     buffer holding the whole source
+  explicit MemorySourceReader(std::shared_ptr<const std::string> buffer);
+
+  /// @see SourceReader
+  int64_t read(int64_t offset, char *buf, int64_t size) override;
+
+  /// @return   total size of the segments
+  int64_t getSize() const;
+
+ private:
+  std::vector<struct iovec> segments_;
+  /// offset of every segment in the source
+  std::vector<int64_t> segmentOffsets_;
+  int64_t size_{0};
+  /// keeps the buffer alive, if given
+  std::shared_ptr<const std::string> buffer_;
+};
+
+/// Block of a source produced by a SourceReader
+class ReaderByteSource : public ByteSource {
+ public:
+  /**
+   * @param metadata          shared source data
+   * @param reader            reader of the source
+   * @param size              size of the block
+   * @param offset            block offset
+   */
+  ReaderByteSource(SourceMetaData *metadata,
+                   std::shared_ptr<SourceReader> reader, int64_t size,
+                   int64_t offset);
+
+  /// @see ByteSource.h
+  const std::string &getIdentifier() const override {
+    return metadata_->relPath;
+  }
+
+  /// @see ByteSource.h
+  int64_t getSize() const override {
+    return size_;
+  }
+
+  /// @see ByteSource.h
+  int64_t getOffset() const override {
+    return offset_;
+  }
+
+  /// @see ByteSource.h
+  const SourceMetaData &getMetaData() const override {
+    return *metadata_;
+  }
+
+  /// @see ByteSource.h
+  bool finished() const override {
+    return bytesRead_ == size_ && !hasError_;
+  }
+
+  /// @see ByteSource.h
+  bool hasError() const override {
+    return hasError_;
+  }
+
+  /// @see ByteSource.h
+  char *read(int64_t &size) override;
+
+  /// @see ByteSource.h
+  void advanceOffset(int64_t numBytes) override;
+
+  /// @see ByteSource.h
+  ErrorCode open(ThreadCtx *threadCtx) override;
+
+  /// @see ByteSource.h
+  void close() override {
+    threadCtx_ = nullptr;
+  }
+
+  /// @see ByteSource.h
+  TransferStats &getTransferStats() override {
+    return transferStats_;
+  }
+
+  /// @see ByteSource.h
+  void addTransferStats(const TransferStats &stats) override {
+    transferStats_ += stats;
+  }
+
+ private:
+  ThreadCtx *threadCtx_{nullptr};
+  SourceMetaData *metadata_;
+  std::shared_ptr<SourceReader> reader_;
+  int64_t size_;
+  int64_t offset_;
+  int64_t bytesRead_{0};
+  bool hasError_{false};
+  TransferStats transferStats_;
+};
+}
+}
@@ -7,6 +7,7 @@
  * of patent rights can be found in the PATENTS file in the same directory.
  */
 #include <wdt/util/ServerSocket.h>
+#include <wdt/util/ConnectionDispatcher.h>
 #include <glog/logging.h>
 #include <sys/socket.h>
 #include <poll.h>
@@ -110,8 +111,12 @@ int ServerSocket::getSelectedPortAndNewAddress(int listeningFd,
   return port;
 }
 
+void ServerSocket::setConnectionDispatcher(ConnectionDispatcher *dispatcher) {
+  dispatcher_ = dispatcher;
+}
+
 ErrorCode ServerSocket::listen() {
-  if (!listeningFds_.empty()) {
+  if (dispatcher_ || !listeningFds_.empty()) {
     return OK;
   }
   struct addrinfo sa;
@@ -200,15 +205,28 @@ ErrorCode ServerSocket::listen() {
 
 ErrorCode ServerSocket::acceptNextConnection(int timeoutMillis,
                                              bool tryCurAddressFirst) {
+  WDT_CHECK(timeoutMillis > 0);
+  if (dispatcher_) {
+    closeNoCheck();
+    fd_ = dispatcher_->accept(port_, timeoutMillis, peerIp_, peerPort_);
+    if (fd_ < 0) {
+      VLOG(1) << "No connection dispatched for " << port_;
+      return CONN_ERROR;
+    }
+    VLOG(1) << "New dispatched connection, fd : " << fd_ << " from "
+            << peerIp_ << " " << peerPort_;
+    setSocketTimeouts();
+    return OK;
+  }
   ErrorCode code = listen();
   if (code != OK) {
     return code;
   }
   WDT_CHECK(!listeningFds_.empty());
-  WDT_CHECK(timeoutMillis > 0);
 
-  const int numFds = listeningFds_.size();
-  struct pollfd pollFds[numFds];
+  const int numListeningFds = listeningFds_.size();
+  // one more slot for the kept connection
+  struct pollfd pollFds[numListeningFds + 1];
   auto startTime = Clock::now();
   while (true) {
     // we need this loop because poll() can return before any file handles
@@ -221,9 +239,14 @@ ErrorCode ServerSocket::acceptNextConnection(int timeoutMillis,
       return CONN_ERROR;
     }
     int pollTimeout = timeoutMillis - timeElapsed;
-    for (int i = 0; i < numFds; i++) {
+    for (int i = 0; i < numListeningFds; i++) {
       pollFds[i] = {listeningFds_[i], POLLIN, 0};
     }
+    const bool hasKeptConnection = (fd_ >= 0);
+    const int numFds = numListeningFds + (hasKeptConnection ? 1 : 0);
+    if (hasKeptConnection) {
+      pollFds[numListeningFds] = {fd_, POLLIN, 0};
+    }
 
     int retValue;
     if ((retValue = poll(pollFds, numFds, pollTimeout)) <= 0) {
@@ -240,18 +263,38 @@ ErrorCode ServerSocket::acceptNextConnection(int timeoutMillis,
       }
       return CONN_ERROR;
     }
+    if (hasKeptConnection && pollFds[numListeningFds].revents) {
+      if (hasDataOnKeptConnection()) {
+        VLOG(1) << "New transfer on kept connection, fd : " << fd_ << " from "
+                << peerIp_ << " " << peerPort_;
+        setSocketTimeouts();
+        return OK;
+      }
+      LOG(INFO) << "Kept connection closed by the peer " << port_ << " "
+                << fd_;
+      closeNoCheck();
+      if (retValue == 1) {
+        continue;
+      }
+    }
     break;
   }
+  if (fd_ >= 0) {
+    // a new connection supersedes the kept one
+    LOG(INFO) << "Closing kept connection " << fd_ << " for a new connection "
+              << port_;
+    closeNoCheck();
+  }
 
-  if (lastCheckedPollIndex_ >= numFds) {
+  if (lastCheckedPollIndex_ >= numListeningFds) {
     // can happen if getaddrinfo returns different set of addresses
     lastCheckedPollIndex_ = 0;
   } else if (!tryCurAddressFirst) {
     // else try the next address
-    lastCheckedPollIndex_ = (lastCheckedPollIndex_ + 1) % numFds;
+    lastCheckedPollIndex_ = (lastCheckedPollIndex_ + 1) % numListeningFds;
   }
 
-  for (int count = 0; count < numFds; count++) {
+  for (int count = 0; count < numListeningFds; count++) {
     auto &pollFd = pollFds[lastCheckedPollIndex_];
     if (pollFd.revents & POLLIN) {
       struct sockaddr_storage addr;
@@ -267,12 +310,18 @@ ErrorCode ServerSocket::acceptNextConnection(int timeoutMillis,
       setSocketTimeouts();
       return OK;
     }
-    lastCheckedPollIndex_ = (lastCheckedPollIndex_ + 1) % numFds;
+    lastCheckedPollIndex_ = (lastCheckedPollIndex_ + 1) % numListeningFds;
   }
   LOG(ERROR) << "None of the listening fds got a POLLIN event " << port_;
   return CONN_ERROR;
 }
 
+bool ServerSocket::hasDataOnKeptConnection() {
+  char c;
+  int ret = ::recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return ret == 1;
+}
+
 void ServerSocket::setReceiveBufferSize(int fd) {
   int bufSize = threadCtx_.getOptions().receive_buffer_size;
   if (bufSize <= 0) {
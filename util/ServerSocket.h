@@ -20,15 +20,22 @@ namespace wdt {
 
 typedef struct addrinfo *addrInfoList;
 
+class ConnectionDispatcher;
+
 class ServerSocket : public WdtSocket {
  public:
   ServerSocket(ThreadCtx &threadCtx, int port, int backlog,
                const EncryptionParams &encryptionParams);
   virtual ~ServerSocket();
   /// Sets up listening socket (first wildcard type (ipv4 or ipv6 depending
-  /// on flag)).
+  /// on flag)). No-op when connections come from a dispatcher.
   ErrorCode listen();
-  /// will accept next (/only) incoming connection
+  /// Gets the connections from the given dispatcher instead of listening,
+  /// port is then only the key identifying the connections
+  void setConnectionDispatcher(ConnectionDispatcher *dispatcher);
+  /// will accept next (/only) incoming connection. If a connection was kept
+  /// open at the end of the previous transfer, returns as soon as data is
+  /// available on it. A new incoming connection closes the kept one.
   /// @param timeoutMillis        accept timeout in millis
   /// @param tryCurAddressFirst   if this is true, current address is tried
   ///                             first during poll round-robin
@@ -49,8 +56,14 @@ class ServerSocket : public WdtSocket {
   /// sets the receive buffer size for this socket
   void setReceiveBufferSize(int fd);
 
+  /// @return   whether the peer sent data on the kept connection, false if
+  ///           it was closed
+  bool hasDataOnKeptConnection();
+
   const int backlog_;
   std::vector<int> listeningFds_;
+  /// dispatcher of the single port receiver, not owned
+  ConnectionDispatcher *dispatcher_{nullptr};
   /// index of the poll-fd last checked. This is used to not try the same fd
   /// every-time. We use round-robin policy to avoid accepting from a single fd
   int lastCheckedPollIndex_{0};
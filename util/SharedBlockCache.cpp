@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/SharedBlockCache.h>
+#include <wdt/ErrorCodes.h>
+
+#include <glog/logging.h>
+
+namespace facebook {
+namespace wdt {
+
+SharedBlockCache::SharedBlockCache(int numConsumers, int64_t maxBytes)
+    : maxBytes_(maxBytes) {
+  WDT_CHECK(numConsumers > 0);
+  for (int i = 0; i < numConsumers; i++) {
+    consumers_.insert(i);
+  }
+}
+
+std::set<int> SharedBlockCache::otherConsumersLocked(int consumer) const {
+  std::set<int> others(consumers_);
+  others.erase(consumer);
+  return others;
+}
+
+void SharedBlockCache::dropLocked(std::map<BlockKey, Block>::iterator it) {
+  if (!it->second.pending.empty()) {
+    dropped_[it->first] = std::move(it->second.pending);
+  }
+  numBytes_ -= it->second.data->size();
+  order_.erase(it->second.orderIt);
+  blocks_.erase(it);
+}
+
+bool SharedBlockCache::makeRoomLocked(int64_t size) {
+  while (numBytes_ + size > maxBytes_ && !order_.empty()) {
+    auto it = blocks_.find(order_.front());
+    WDT_CHECK(it != blocks_.end());
+    if (it->second.loading) {
+      return false;
+    }
+    VLOG(1) << "Dropping block " << it->first.first << " at "
+            << it->first.second << ", " << it->second.pending.size()
+            << " destinations will read it again";
+    dropLocked(it);
+  }
+  return numBytes_ + size <= maxBytes_;
+}
+
+SharedBlockCache::LookupResult SharedBlockCache::acquire(
+    int consumer, const std::string &path, int64_t offset, int64_t size,
+    BlockData &data) {
+  const BlockKey key(path, offset);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (dropped_.count(key) > 0) {
+    return acquireDroppedLocked(consumer, key);
+  }
+  auto it = blocks_.find(key);
+  if (it != blocks_.end()) {
+    while (it != blocks_.end() && it->second.loading) {
+      loadedCv_.wait(lock);
+      it = blocks_.find(key);
+    }
+    if (it == blocks_.end()) {
+      // the load failed or the block got dropped meanwhile
+      return acquireDroppedLocked(consumer, key);
+    }
+    data = it->second.data;
+    it->second.pending.erase(consumer);
+    if (it->second.pending.empty()) {
+      dropLocked(it);
+    }
+    return HIT;
+  }
+  std::set<int> others = otherConsumersLocked(consumer);
+  if (others.empty()) {
+    return BYPASS;
+  }
+  if (size > maxBytes_ || !makeRoomLocked(size)) {
+    dropped_[key] = std::move(others);
+    return BYPASS;
+  }
+  Block &block = blocks_[key];
+  block.data = std::make_shared<std::vector<char>>(size);
+  block.pending = std::move(others);
+  block.orderIt = order_.insert(order_.end(), key);
+  numBytes_ += size;
+  data = block.data;
+  return LOAD;
+}
+
+SharedBlockCache::LookupResult SharedBlockCache::acquireDroppedLocked(
+    int consumer, const BlockKey &key) {
+  auto droppedIt = dropped_.find(key);
+  if (droppedIt != dropped_.end()) {
+    droppedIt->second.erase(consumer);
+    if (droppedIt->second.empty()) {
+      dropped_.erase(droppedIt);
+    }
+  }
+  return BYPASS;
+}
+
+void SharedBlockCache::loaded(const std::string &path, int64_t offset,
+                              bool success) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = blocks_.find(BlockKey(path, offset));
+  WDT_CHECK(it != blocks_.end() && it->second.loading);
+  it->second.loading = false;
+  if (!success || it->second.pending.empty()) {
+    // failed, or the others were removed while it was loading
+    dropLocked(it);
+  }
+  loadedCv_.notify_all();
+}
+
+void SharedBlockCache::removeConsumer(int consumer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (consumers_.erase(consumer) == 0) {
+    return;
+  }
+  for (auto it = blocks_.begin(); it != blocks_.end();) {
+    auto cur = it++;
+    cur->second.pending.erase(consumer);
+    if (cur->second.pending.empty() && !cur->second.loading) {
+      dropLocked(cur);
+    }
+  }
+  for (auto it = dropped_.begin(); it != dropped_.end();) {
+    it->second.erase(consumer);
+    if (it->second.empty()) {
+      it = dropped_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  VLOG(1) << "Removed destination " << consumer << ", " << consumers_.size()
+          << " left";
+}
+
+int64_t SharedBlockCache::getNumBytes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return numBytes_;
+}
+
+int64_t SharedBlockCache::getNumDroppedBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_.size();
+}
+
+int64_t SharedBlockCache::getNumBlocks() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WDT_CHECK_EQ(blocks_.size(), order_.size());
+  return blocks_.size();
+}
+}
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Blocks read once from the disk and shared by the senders of several
+ * destinations (@see MultiSender). The first destination to need a block
+ * reads it into memory, the others get the same buffer, and the block is
+ * dropped once every destination got it. Memory is bounded: when full, the
+ * oldest blocks are dropped and the destinations which did not get them yet
+ * read them from the disk again. A slow destination thus costs extra reads
+ * but never stalls the others. Destinations are numbered from 0, a
+ * destination whose transfer ended is removed so that no block waits for it.
+ */
+class SharedBlockCache {
+ public:
+  typedef std::shared_ptr<std::vector<char>> BlockData;
+
+  enum LookupResult {
+    /// data of the block is available
+    HIT,
+    /// the caller has to read the block into the data and call loaded()
+    LOAD,
+    /// the caller has to read the block by itself
+    BYPASS,
+  };
+
+  /**
+   * @param numConsumers    number of destinations reading every block
+   * @param maxBytes        maximum size of the blocks kept in memory
+   */
+  SharedBlockCache(int numConsumers, int64_t maxBytes);
+
+  /**
+   * Gets a block, each destination must ask for a given block only once.
+   * Waits if another destination is loading the block
+   *
+   * @param consumer  destination asking for the block
+   * @param path      full path of the file
+   * @param offset    offset of the block
+   * @param size      size of the block
+   * @param data      set to the data of the block for HIT and LOAD
+   *
+   * @return          how to get the data of the block
+   */
+  LookupResult acquire(int consumer, const std::string &path, int64_t offset,
+                       int64_t size, BlockData &data);
+
+  /**
+   * Ends the loading of a block after LOAD
+   *
+   * @param path      full path of the file
+   * @param offset    offset of the block
+   * @param success   whether the block was read, the others read it by
+   *                  themselves otherwise
+   */
+  void loaded(const std::string &path, int64_t offset, bool success);
+
+  /**
+   * Removes a destination which will not ask for blocks anymore, the blocks
+   * and the dropped blocks only it did not get yet are forgotten
+   *
+   * @param consumer  destination to remove
+   */
+  void removeConsumer(int consumer);
+
+  /// @return   bytes of the blocks in memory
+  int64_t getNumBytes();
+
+  /// @return   number of dropped blocks some destinations did not read yet
+  int64_t getNumDroppedBlocks();
+
+  /// @return   number of blocks in memory
+  int64_t getNumBlocks();
+
+ private:
+  typedef std::pair<std::string, int64_t> BlockKey;
+
+  struct Block {
+    BlockData data;
+    /// destinations which did not get the block yet
+    std::set<int> pending;
+    bool loading{true};
+    /// position of the block in order_
+    std::list<BlockKey>::iterator orderIt;
+  };
+
+  /// drops the block and its key in order_, the pending destinations will
+  /// bypass it
+  void dropLocked(std::map<BlockKey, Block>::iterator it);
+
+  /// accounts a destination bypassing a dropped block
+  LookupResult acquireDroppedLocked(int consumer, const BlockKey &key);
+
+  /// drops the oldest blocks until size more bytes fit, @return success
+  bool makeRoomLocked(int64_t size);
+
+  /// @return   the destinations not removed, except the given one
+  std::set<int> otherConsumersLocked(int consumer) const;
+
+  const int64_t maxBytes_;
+
+  std::mutex mutex_;
+  /// notified when a block is loaded
+  std::condition_variable loadedCv_;
+  std::map<BlockKey, Block> blocks_;
+  /// keys of the blocks in memory by insertion order
+  std::list<BlockKey> order_;
+  /// destinations yet to read a dropped block by themselves
+  std::map<BlockKey, std::set<int>> dropped_;
+  /// destinations not removed
+  std::set<int> consumers_;
+  int64_t numBytes_{0};
+};
+}
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/SocketTuner.h>
+
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <climits>
+#include <fstream>
+
+namespace facebook {
+namespace wdt {
+
+const int64_t SocketTuner::kMinBufferSize;
+
+SocketTuner::SocketTuner(const WdtOptions &options, bool isSender)
+    : enabled_(options.auto_tune_buffers),
+      isSender_(isSender),
+      intervalMillis_(options.auto_tune_interval_millis),
+      maxBufferSize_(options.auto_tune_max_buffer_size),
+      autotuneMaxSize_(enabled_ ? getAutotuneMaxSize(isSender) : -1),
+      settableMaxSize_(enabled_ ? getSettableMaxSize(isSender) : -1) {
+}
+
+/**
+ * @param path    path of the sysctl in /proc/sys
+ * @param field   index of the value to read, for the sysctls with several
+ *
+ * @return        value of the sysctl, -1 if it can not be read
+ */
+static int64_t readSysctl(const char *path, int field) {
+  std::ifstream fin(path);
+  int64_t value = -1;
+  for (int i = 0; i <= field; i++) {
+    if (!(fin >> value)) {
+      return -1;
+    }
+  }
+  return value;
+}
+
+int64_t SocketTuner::getAutotuneMaxSize(bool isSender) {
+  return readSysctl(isSender ? "/proc/sys/net/ipv4/tcp_wmem"
+                             : "/proc/sys/net/ipv4/tcp_rmem",
+                    2);
+}
+
+int64_t SocketTuner::getSettableMaxSize(bool isSender) {
+  return readSysctl(isSender ? "/proc/sys/net/core/wmem_max"
+                             : "/proc/sys/net/core/rmem_max",
+                    0);
+}
+
+void SocketTuner::start(WdtSocket &socket, int64_t totalBytes,
+                        double pacingRateBytesPerSec) {
+  lastTime_ = Clock::now();
+  lastBytes_ = totalBytes;
+#ifdef SO_MAX_PACING_RATE
+  if (pacingRateBytesPerSec > 0) {
+    // the option is 32 bits, faster rates are not paced
+    const int rate = std::min<double>(pacingRateBytesPerSec, INT_MAX);
+    if (socket.setIntOption(SOL_SOCKET, SO_MAX_PACING_RATE, rate)) {
+      VLOG(1) << "Pacing port " << socket.getPort() << " at " << rate
+              << " bytes/sec";
+    }
+  }
+#endif
+}
+
+int64_t SocketTuner::computeBufferSize(double bytesPerSec, int64_t rttMicros,
+                                       int64_t maxSize) {
+  const int64_t bdp = bytesPerSec * rttMicros / kMicroToSec;
+  return std::max(kMinBufferSize, std::min(2 * bdp, maxSize));
+}
+
+void SocketTuner::onProgress(WdtSocket &socket, int64_t totalBytes) {
+  if (!enabled_) {
+    return;
+  }
+  const auto now = Clock::now();
+  if (durationMillis(now - lastTime_) < intervalMillis_) {
+    return;
+  }
+  const double bytesPerSec =
+      (totalBytes - lastBytes_) / durationSeconds(now - lastTime_);
+  lastTime_ = now;
+  lastBytes_ = totalBytes;
+  const int64_t rttMicros = socket.getRttMicros();
+  if (rttMicros <= 0 || bytesPerSec <= 0) {
+    return;
+  }
+  const int64_t size =
+      computeBufferSize(bytesPerSec, rttMicros, maxBufferSize_);
+  const int curSize =
+      isSender_ ? socket.getSendBufferSize() : socket.getReceiveBufferSize();
+  // the kernel doubles the size set (for its bookkeeping overhead), up to
+  // the sysctl cap, and getsockopt reports the doubled size
+  const int64_t kernelSize =
+      2 * (settableMaxSize_ > 0 ? std::min(size, settableMaxSize_) : size);
+  if (kernelSize <= curSize || kernelSize <= autotuneMaxSize_) {
+    // setting a size disables the kernel autotuning, which gets there too
+    return;
+  }
+  const int option = isSender_ ? SO_SNDBUF : SO_RCVBUF;
+  if (!socket.setIntOption(SOL_SOCKET, option, size)) {
+    return;
+  }
+  VLOG(1) << "Buffer of port " << socket.getPort() << " set to " << kernelSize
+          << " from " << curSize << ", rtt " << rttMicros << " us, "
+          << bytesPerSec / kMbToB << " Mbytes/sec";
+#ifdef TCP_NOTSENT_LOWAT
+  if (isSender_) {
+    socket.setIntOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, size / 4);
+  }
+#endif
+}
+}
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/Reporting.h>
+#include <wdt/WdtOptions.h>
+#include <wdt/util/WdtSocket.h>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Sizes the socket buffers of a connection from its measured bandwidth-delay
+ * product (auto_tune_buffers option), instead of static send_buffer_size and
+ * receive_buffer_size guesses. Every auto_tune_interval_millis the
+ * throughput of the connection and the rtt from TCP_INFO are measured and
+ * the buffer grows to twice the product: while the buffer limits the
+ * throughput the measured product is about the buffer itself, so the window
+ * keeps growing until the link is the bottleneck. Buffers never shrink,
+ * and sizes the kernel autotuning grows to by itself (tcp_wmem/tcp_rmem max)
+ * are left to it, as setting a size disables the autotuning of the socket.
+ * On the sender the unsent data kept in the socket (TCP_NOTSENT_LOWAT) is
+ * limited to half the product, and with kernel_pacing the connection is
+ * paced by the kernel at its share of the throttler rate.
+ */
+class SocketTuner {
+ public:
+  /**
+   * @param options     options to use
+   * @param isSender    whether the connections send or receive the data
+   */
+  SocketTuner(const WdtOptions &options, bool isSender);
+
+  /**
+   * Starts tuning a new connection
+   *
+   * @param socket                socket of the connection
+   * @param totalBytes            bytes moved so far by the thread
+   * @param pacingRateBytesPerSec max pacing rate of the connection, <= 0 for
+   *                              none
+   */
+  void start(WdtSocket &socket, int64_t totalBytes,
+             double pacingRateBytesPerSec);
+
+  /**
+   * Called as the transfer makes progress, resizes the buffers once per
+   * interval
+   *
+   * @param socket        socket of the connection
+   * @param totalBytes    bytes moved so far by the thread
+   */
+  void onProgress(WdtSocket &socket, int64_t totalBytes);
+
+  /**
+   * @param bytesPerSec   measured throughput
+   * @param rttMicros     round trip time
+   * @param maxSize       maximum buffer size
+   *
+   * @return              buffer size for the given bandwidth-delay product
+   */
+  static int64_t computeBufferSize(double bytesPerSec, int64_t rttMicros,
+                                   int64_t maxSize);
+
+  /**
+   * @param isSender    send or receive buffer
+   *
+   * @return            largest buffer the kernel autotuning grows to
+   *                    (net.ipv4.tcp_wmem/tcp_rmem max), -1 if unknown
+   */
+  static int64_t getAutotuneMaxSize(bool isSender);
+
+  /**
+   * @param isSender    send or receive buffer
+   *
+   * @return            largest size setsockopt accepts
+   *                    (net.core.wmem_max/rmem_max), -1 if unknown
+   */
+  static int64_t getSettableMaxSize(bool isSender);
+
+  /// smallest buffer size worth setting
+  static const int64_t kMinBufferSize = 64 * 1024;
+
+ private:
+  const bool enabled_;
+  const bool isSender_;
+  const int intervalMillis_;
+  const int64_t maxBufferSize_;
+  const int64_t autotuneMaxSize_;
+  const int64_t settableMaxSize_;
+  Clock::time_point lastTime_;
+  int64_t lastBytes_{0};
+};
+}
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/StreamReader.h>
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace facebook {
+namespace wdt {
+
+FdStreamReader::FdStreamReader(int fd, bool needToClose)
+    : fd_(fd), needToClose_(needToClose) {
+}
+
+FdStreamReader::~FdStreamReader() {
+  if (needToClose_ && ::close(fd_) != 0) {
+    PLOG(ERROR) << "Failed to close stream fd " << fd_;
+  }
+}
+
+int64_t FdStreamReader::read(char *buf, int64_t size,
+                             const IAbortChecker &abortChecker) {
+  while (true) {
+    if (abortChecker.shouldAbort()) {
+      LOG(WARNING) << "Aborting the read of stream fd " << fd_;
+      return -1;
+    }
+    struct pollfd pollFd = {fd_, POLLIN, 0};
+    const int ready = ::poll(&pollFd, 1, kAbortCheckMillis);
+    if (ready < 0 && errno != EINTR) {
+      PLOG(ERROR) << "Failed to poll stream fd " << fd_;
+      return -1;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    const int64_t numRead = ::read(fd_, buf, size);
+    if (numRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numRead < 0) {
+      PLOG(ERROR) << "Failed to read stream fd " << fd_;
+    }
+    return numRead;
+  }
+}
+}
+}
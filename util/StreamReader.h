@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/AbortChecker.h>
+
+#include <cstdint>
+
+namespace facebook {
+namespace wdt {
+
+/**
+ * Produces a source whose size is only known once it ends, e.g. a pipe from
+ * a dump process (@see Sender::addStream). Reads are sequential and done by
+ * a single thread.
+ */
+class StreamReader {
+ public:
+  virtual ~StreamReader() {
+  }
+
+  /**
+   * Reads the next bytes of the stream, may block until they are produced.
+   * Must return soon once the abort checker says so: the queue waits for the
+   * reading thread before it is destroyed
+   *
+   * @param buf           buffer to fill
+   * @param size          maximum number of bytes to read
+   * @param abortChecker  tells when to give up waiting
+   *
+   * @return              number of bytes read, 0 at the end of the stream
+   *                      and < 0 on error or abort
+   */
+  virtual int64_t read(char *buf, int64_t size,
+                       const IAbortChecker &abortChecker) = 0;
+};
+
+/// StreamReader of a file descriptor: pipe, stdin, socket... Waits for data
+/// with poll() to check for aborts every kAbortCheckMillis
+class FdStreamReader : public StreamReader {
+ public:
+  /**
+   * @param fd            file descriptor to read
+   * @param needToClose   whether to close the descriptor once done
+   */
+  FdStreamReader(int fd, bool needToClose);
+
+  ~FdStreamReader() override;
+
+  /// @see StreamReader
+  int64_t read(char *buf, int64_t size,
+               const IAbortChecker &abortChecker) override;
+
+ private:
+  static const int kAbortCheckMillis = 100;
+
+  const int fd_;
+  const bool needToClose_;
+};
+}
+}
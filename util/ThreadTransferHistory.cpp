@@ -221,6 +221,9 @@ void ThreadTransferHistory::markSourceAsFailed(
     threadStats_.decrNumBlocks();
     threadStats_.incrFailedAttempts();
   }
+  if (receivedBytes > 0) {
+    queue_.markSourcePartSent(*source, receivedBytes);
+  }
   source->advanceOffset(receivedBytes);
 }
 
@@ -188,6 +188,17 @@ bool ThreadsController::hasThreads(int threadIndex, ThreadStatus threadState) {
   return false;
 }
 
+int ThreadsController::getNumThreads(ThreadStatus threadState) const {
+  GuardLock lock(controllerMutex_);
+  int numThreads = 0;
+  for (auto &threadPair : threadStateMap_) {
+    if (threadPair.second == threadState) {
+      ++numThreads;
+    }
+  }
+  return numThreads;
+}
+
 shared_ptr<ConditionGuard> ThreadsController::getCondition(
     const uint64_t conditionIndex) {
   bool isExists = (conditionGuards_.size() > conditionIndex) &&
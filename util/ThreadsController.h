@@ -324,6 +324,9 @@ class ThreadsController {
   /// @return     true if any registered thread is in the state
   bool hasThreads(ThreadStatus threadState);
 
+  /// @return     number of threads in the state
+  int getNumThreads(ThreadStatus threadState) const;
+
   /// Get the nunber of registered threads
   int getTotalThreads();
 
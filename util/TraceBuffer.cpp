@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#include <wdt/util/TraceBuffer.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace facebook {
+namespace wdt {
+
+TraceBuffer::TraceBuffer(int64_t capacity) {
+  WDT_CHECK_GT(capacity, 0);
+  events_.resize(capacity);
+}
+
+int64_t TraceBuffer::getNumEvents() const {
+  return std::min<int64_t>(numRecorded_, events_.size());
+}
+
+int64_t TraceBuffer::getNumDropped() const {
+  return numRecorded_ - getNumEvents();
+}
+
+const TraceEvent &TraceBuffer::getEvent(int64_t index) const {
+  const int64_t first = numRecorded_ - getNumEvents();
+  return events_[(first + index) % events_.size()];
+}
+
+/// @return   str quoted and escaped as a JSON string
+static std::string jsonQuote(const std::string &str) {
+  std::string result = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      result.push_back('\\');
+      result.push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      result.push_back(' ');
+    } else {
+      result.push_back(c);
+    }
+  }
+  result.push_back('"');
+  return result;
+}
+
+ErrorCode writeChromeTrace(const std::string &fileName,
+                           const std::string &processName,
+                           const std::vector<const TraceBuffer *> &buffers) {
+  std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc);
+  if (!out) {
+    PLOG(ERROR) << "Unable to open trace file " << fileName;
+    return FILE_WRITE_ERROR;
+  }
+  out << "{\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+      << "\"args\":{\"name\":" << jsonQuote(processName) << "}}";
+  int64_t numEvents = 0;
+  int64_t numDropped = 0;
+  for (size_t tid = 0; tid < buffers.size(); tid++) {
+    const TraceBuffer *buffer = buffers[tid];
+    if (!buffer) {
+      continue;
+    }
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+        << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+    for (int64_t i = 0; i < buffer->getNumEvents(); i++) {
+      const TraceEvent &event = buffer->getEvent(i);
+      out << ",\n{\"name\":" << jsonQuote(event.name) << ",\"cat\":\"wdt\"";
+      if (event.durationMicros > 0) {
+        out << ",\"ph\":\"X\",\"dur\":" << event.durationMicros;
+      } else {
+        out << ",\"ph\":\"i\",\"s\":\"t\"";
+      }
+      out << ",\"ts\":" << event.startMicros << ",\"pid\":0,\"tid\":" << tid;
+      if (event.arg >= 0) {
+        out << ",\"args\":{\"arg\":" << event.arg << "}";
+      }
+      out << "}";
+    }
+    numEvents += buffer->getNumEvents();
+    numDropped += buffer->getNumDropped();
+  }
+  out << "\n]}\n";
+  out.close();
+  if (!out) {
+    PLOG(ERROR) << "Failed writing trace file " << fileName;
+    return FILE_WRITE_ERROR;
+  }
+  LOG(INFO) << "Wrote " << numEvents << " trace events to " << fileName
+            << " (" << numDropped << " oldest events dropped)";
+  return OK;
+}
+}
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/ErrorCodes.h>
+#include <wdt/Reporting.h>
+#include <string>
+#include <vector>
+
+namespace facebook {
+namespace wdt {
+
+/// one timeline event, instant events have a duration of 0
+struct TraceEvent {
+  /// name of the event, must point to static storage
+  const char *name;
+  /// start time in microseconds (Clock based)
+  int64_t startMicros;
+  /// duration in microseconds
+  int64_t durationMicros;
+  /// event argument (typically the block sequence id), -1 for none
+  int64_t arg;
+};
+
+/**
+ * Fixed size ring buffer of the timeline events of one thread. When full,
+ * the oldest events are overwritten so that the end of a long transfer is
+ * always available. Only the owner thread may add events, the buffer can be
+ * read once the thread has been joined.
+ */
+class TraceBuffer {
+ public:
+  /// @param capacity   max number of events kept
+  explicit TraceBuffer(int64_t capacity);
+
+  /**
+   * Records a complete event
+   *
+   * @param name        name of the event (static string)
+   * @param startTime   start of the event
+   * @param endTime     end of the event
+   * @param arg         argument of the event, -1 for none
+   */
+  void addEvent(const char *name, Clock::time_point startTime,
+                Clock::time_point endTime, int64_t arg = -1) {
+    TraceEvent &event = events_[numRecorded_ % events_.size()];
+    event.name = name;
+    event.startMicros = durationMicros(startTime.time_since_epoch());
+    event.durationMicros = durationMicros(endTime - startTime);
+    event.arg = arg;
+    numRecorded_++;
+  }
+
+  /// records an instant event happening now
+  void addInstantEvent(const char *name, int64_t arg = -1) {
+    const Clock::time_point now = Clock::now();
+    addEvent(name, now, now, arg);
+  }
+
+  /// @return   number of events currently kept
+  int64_t getNumEvents() const;
+
+  /// @return   number of events overwritten because the buffer was full
+  int64_t getNumDropped() const;
+
+  /// @return   i-th kept event, oldest first
+  const TraceEvent &getEvent(int64_t index) const;
+
+ private:
+  std::vector<TraceEvent> events_;
+  /// total number of events ever recorded
+  int64_t numRecorded_{0};
+};
+
+/**
+ * Writes the events of the given buffers in the Chrome trace event JSON
+ * format (which can be loaded in Perfetto or chrome://tracing), one timeline
+ * track per buffer
+ *
+ * @param fileName      path of the file to write
+ * @param processName   name of the process track (e.g. sender and transfer id)
+ * @param buffers       per thread buffers, index is used as thread id, null
+ *                      entries are skipped
+ *
+ * @return              OK or FILE_WRITE_ERROR
+ */
+ErrorCode writeChromeTrace(const std::string &fileName,
+                           const std::string &processName,
+                           const std::vector<const TraceBuffer *> &buffers);
+}
+}
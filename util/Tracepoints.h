@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+#pragma once
+
+#include <wdt/WdtConfig.h>
+
+/**
+ * USDT (user level statically defined tracing) probes on the hot paths of the
+ * sender and receiver, so that production transfers can be profiled with
+ * bpftrace/systemtap/perf without restarting them. When nobody is attached a
+ * probe is a single nop, and when sys/sdt.h is not available at build time
+ * the probes are compiled out entirely.
+ *
+ * All the probes use the "wdt" provider. Operations are bracketed by
+ * __start/__done probe pairs fired on the same thread, durations are the
+ * time between the two, e.g:
+ *
+ *   bpftrace -e 'usdt:./wdt:wdt:socket__write__start { @s[tid] = nsecs; }
+ *     usdt:./wdt:wdt:socket__write__done /@s[tid]/ {
+ *       @usec = hist((nsecs - @s[tid]) / 1000); delete(@s[tid]); }'
+ *
+ * Probes and their arguments:
+ *   block__send__start       seqId, offset, size
+ *   block__send__done        seqId, offset, data bytes sent, error code
+ *   block__receive__start    seqId, offset, size
+ *   block__receive__done     seqId, offset, bytes written, error code
+ *   queue__dequeue           seqId, offset, size, thread index
+ *   socket__read__start      fd, requested bytes
+ *   socket__read__done       fd, requested bytes, result
+ *   socket__write__start     fd, requested bytes
+ *   socket__write__done      fd, requested bytes, result
+ *   file__open__start        path
+ *   file__open__done         path, fd
+ *   file__read__start        fd, offset, size
+ *   file__read__done         fd, offset, size, result
+ *   file__write__start       fd, size
+ *   file__write__done        fd, size, result
+ *   throttler__sleep         sleep duration in usec, bytes being throttled
+ *   checkpoint__send         port, num blocks, last block received bytes
+ *   checkpoint__receive      port, num blocks, last block received bytes
+ *   global__checkpoint__send     number of checkpoints
+ *   global__checkpoint__receive  port, num blocks
+ */
+#ifdef WDT_HAS_SDT_H
+
+#include <sys/sdt.h>
+
+#define WDT_TRACEPOINT0(name) DTRACE_PROBE(wdt, name)
+#define WDT_TRACEPOINT1(name, a1) DTRACE_PROBE1(wdt, name, a1)
+#define WDT_TRACEPOINT2(name, a1, a2) DTRACE_PROBE2(wdt, name, a1, a2)
+#define WDT_TRACEPOINT3(name, a1, a2, a3) DTRACE_PROBE3(wdt, name, a1, a2, a3)
+#define WDT_TRACEPOINT4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(wdt, name, a1, a2, a3, a4)
+
+#else
+
+#define WDT_TRACEPOINT0(name) \
+  do {                        \
+  } while (0)
+#define WDT_TRACEPOINT1(name, a1) \
+  do {                            \
+  } while (0)
+#define WDT_TRACEPOINT2(name, a1, a2) \
+  do {                                \
+  } while (0)
+#define WDT_TRACEPOINT3(name, a1, a2, a3) \
+  do {                                    \
+  } while (0)
+#define WDT_TRACEPOINT4(name, a1, a2, a3, a4) \
+  do {                                        \
+  } while (0)
+
+#endif
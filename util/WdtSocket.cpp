@@ -1,9 +1,12 @@
 #include <wdt/util/WdtSocket.h>
 #include <wdt/Protocol.h>
+#include <wdt/util/Tracepoints.h>
 #include <folly/Bits.h>
 #include <folly/String.h>  // for humanify
 #include <unistd.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/ioctl.h>
 #ifdef WDT_HAS_SOCKIOS_H
 #include <linux/sockios.h>
@@ -95,6 +98,9 @@ void WdtSocket::writeEncryptionSettingsOnce() {
 }
 
 int WdtSocket::readInternal(char *buf, int nbyte, int timeoutMs, bool tryFull) {
+  if (corked_) {
+    setCorked(false);
+  }
   int numRead = readWithAbortCheck(buf, nbyte, timeoutMs, tryFull);
   if (numRead == 0) {
     readErrorCode_ = SOCKET_READ_ERROR;
@@ -227,14 +233,26 @@ int WdtSocket::write(char *buf, int nbyte, bool retry) {
 
 int64_t WdtSocket::readWithAbortCheck(char *buf, int64_t nbyte, int timeoutMs,
                                       bool tryFull) {
-  PerfStatCollector statCollector(threadCtx_, PerfStatReport::SOCKET_READ);
-  return ioWithAbortCheck(::read, buf, nbyte, timeoutMs, tryFull);
+  WDT_TRACEPOINT2(socket__read__start, fd_, nbyte);
+  int64_t numRead;
+  {
+    PerfStatCollector statCollector(threadCtx_, PerfStatReport::SOCKET_READ);
+    numRead = ioWithAbortCheck(::read, buf, nbyte, timeoutMs, tryFull);
+  }
+  WDT_TRACEPOINT3(socket__read__done, fd_, nbyte, numRead);
+  return numRead;
 }
 
 int64_t WdtSocket::writeWithAbortCheck(const char *buf, int64_t nbyte,
                                        int timeoutMs, bool tryFull) {
-  PerfStatCollector statCollector(threadCtx_, PerfStatReport::SOCKET_WRITE);
-  return ioWithAbortCheck(::write, buf, nbyte, timeoutMs, tryFull);
+  WDT_TRACEPOINT2(socket__write__start, fd_, nbyte);
+  int64_t written;
+  {
+    PerfStatCollector statCollector(threadCtx_, PerfStatReport::SOCKET_WRITE);
+    written = ioWithAbortCheck(::write, buf, nbyte, timeoutMs, tryFull);
+  }
+  WDT_TRACEPOINT3(socket__write__done, fd_, nbyte, written);
+  return written;
 }
 
 template <typename F, typename T>
@@ -375,18 +393,42 @@ ErrorCode WdtSocket::closeConnectionInternal(bool doTagIOs) {
     PLOG(ERROR) << "Failed to close socket " << fd_ << " " << port_;
     errorCode = getMoreInterestingError(ERROR, errorCode);
   }
-  // This looks like a reset() make it explicit (and check it's complete)
   fd_ = -1;
+  corked_ = false;
+  resetConnectionState();
+  VLOG(1) << "Error code from close " << errorCodeToStr(errorCode);
+  return errorCode;
+}
+
+void WdtSocket::resetConnectionState() {
   readErrorCode_ = OK;
   writeErrorCode_ = OK;
   encryptionSettingsRead_ = false;
   encryptionSettingsWritten_ = false;
   writesFinalized_ = false;
   readsFinalized_ = false;
-  VLOG(1) << "Error code from close " << errorCodeToStr(errorCode);
+  ctxSaveOffset_ = OFFSET_NOT_SET;
+}
+
+ErrorCode WdtSocket::finishSession() {
+  VLOG(1) << "Finishing session on " << port_ << " " << fd_;
+  // writing first on both sides, the tags fit in the socket buffers
+  ErrorCode errorCode = finalizeWrites(true);
+  errorCode = getMoreInterestingError(errorCode, finalizeReads(true));
+  resetConnectionState();
   return errorCode;
 }
 
+int WdtSocket::releaseConnection() {
+  WDT_CHECK(!encryptionSettingsRead_ && !encryptionSettingsWritten_)
+      << "Releasing connection in the middle of a session " << port_;
+  setCorked(false);
+  int fd = fd_;
+  fd_ = -1;
+  resetConnectionState();
+  return fd;
+}
+
 int WdtSocket::getFd() const {
   return fd_;
 }
@@ -468,6 +510,21 @@ void WdtSocket::setSocketTimeouts() {
   }
 }
 
+void WdtSocket::setCorked(bool corked) {
+#ifdef TCP_CORK
+  if (fd_ < 0 || corked == corked_) {
+    return;
+  }
+  int optval = corked;
+  if (setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval)) != 0) {
+    PLOG(WARNING) << "Unable to set TCP_CORK to " << corked << " for "
+                  << port_ << " " << fd_;
+    return;
+  }
+  corked_ = corked;
+#endif
+}
+
 /* static */
 bool WdtSocket::getNameInfo(const struct sockaddr *sa, socklen_t salen,
                             std::string &host, std::string &port) {
@@ -483,6 +540,35 @@ bool WdtSocket::getNameInfo(const struct sockaddr *sa, socklen_t salen,
   return true;
 }
 
+bool WdtSocket::setIntOption(int level, int option, int value) {
+  if (fd_ < 0) {
+    return false;
+  }
+  if (setsockopt(fd_, level, option, &value, sizeof(value)) != 0) {
+    PLOG(WARNING) << "Unable to set socket option " << option << " to "
+                  << value << " for " << port_ << " " << fd_;
+    return false;
+  }
+  return true;
+}
+
+int64_t WdtSocket::getRttMicros() const {
+#ifdef TCP_INFO
+  struct tcp_info info;
+  socklen_t infoLen = sizeof(info);
+  if (fd_ < 0 || getsockopt(fd_, IPPROTO_TCP, TCP_INFO, &info, &infoLen) != 0) {
+    return -1;
+  }
+  if (info.tcpi_rtt > 0) {
+    return info.tcpi_rtt;
+  }
+  // nothing was acked yet, use the estimate of the receive side
+  return info.tcpi_rcv_rtt > 0 ? info.tcpi_rcv_rtt : -1;
+#else
+  return -1;
+#endif
+}
+
 int WdtSocket::getReceiveBufferSize() const {
   int size;
   socklen_t sizeSize = sizeof(size);
@@ -40,6 +40,22 @@ class WdtSocket {
   /// expect logical and physical end of stream: read the tag and finialize
   virtual ErrorCode expectEndOfStream();
 
+  /**
+   * Logically ends the current transfer without closing the connection: the
+   * tags are exchanged as for a normal close and the encryption state is
+   * reset so that the next transfer on this connection starts with new
+   * encryption settings. Both sides must call this.
+   */
+  ErrorCode finishSession();
+
+  /**
+   * Detaches the connection from this socket without closing it, should only
+   * be called after a successful finishSession()
+   *
+   * @return      fd of the connection, ownership goes to the caller
+   */
+  int releaseConnection();
+
   /**
    * Normal closing of the current connection.
    * may return ENCRYPTION_ERROR if the stream is corrupt (gcm mode)
@@ -76,6 +92,28 @@ class WdtSocket {
   /// verify whether the given tag matches previously saved context
   bool verifyTag(std::string &tag);
 
+  /**
+   * Corks the connection (TCP_CORK where available): partial packets are held
+   * back so that the small writes preceding the next read go out together.
+   * The next read uncorks, the peer can't reply to data it didn't get.
+   */
+  void setCorked(bool corked);
+
+  /**
+   * Sets an integer socket option of the current connection
+   *
+   * @param level     option level (SOL_SOCKET, IPPROTO_TCP)
+   * @param option    option name
+   * @param value     option value
+   *
+   * @return          whether the option could be set
+   */
+  bool setIntOption(int level, int option, int value);
+
+  /// @return   smoothed round trip time in micro seconds from TCP_INFO, -1 if
+  ///           it is not available
+  int64_t getRttMicros() const;
+
   /// @return   tcp receive buffer size
   int getReceiveBufferSize() const;
 
@@ -102,6 +140,9 @@ class WdtSocket {
   /// If doTagIOs is false will not try to read/write the final encryption tag
   virtual ErrorCode closeConnectionInternal(bool doTagIOs);
 
+  /// resets the error and encryption state of the connection
+  void resetConnectionState();
+
   ErrorCode finalizeWrites(bool doTagIOs);
 
   ErrorCode finalizeReads(bool doTagIOs);
@@ -155,6 +196,9 @@ class WdtSocket {
   /// offset after which decryptor ctx should be saved
   int ctxSaveOffset_{OFFSET_NOT_SET};
 
+  /// whether partial packets are currently held back, @see setCorked
+  bool corked_{false};
+
  private:
   /// computes effective timeout depending on the network timeout and abort
   /// check interval
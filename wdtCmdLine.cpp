@@ -40,7 +40,8 @@ DEFINE_bool(run_as_daemon, false,
 DEFINE_string(directory, ".", "Source/Destination directory");
 DEFINE_string(manifest, "",
               "If specified, then we will read a list of files and optional "
-              "sizes from this file, use - for stdin");
+              "sizes, odirect flags, priorities and deadlines in ms from this "
+              "file, use - for stdin");
 DEFINE_string(
     destination, "",
     "empty is server (destination) mode, non empty is destination host");
@@ -67,6 +68,10 @@ DEFINE_int32(abort_after_seconds, 0,
 
 DEFINE_string(recovery_id, "", "Recovery-id to use for download resumption");
 
+DEFINE_string(downstream_url, "",
+              "Connection url of a next receiver: received blocks are "
+              "forwarded to it while being written (chain replication)");
+
 DEFINE_bool(treat_fewer_port_as_error, false,
             "If the receiver is unable to bind to all the ports, treat that as "
             "an error.");
@@ -140,12 +145,18 @@ void readManifest(std::istream &fin, WdtTransferRequest &req, bool dfltDirect) {
   while (std::getline(fin, line)) {
     std::vector<std::string> fields;
     folly::split('\t', line, fields, true);
-    if (fields.empty() || fields.size() > 3) {
+    if (fields.empty() || fields.size() > 5) {
       LOG(FATAL) << "Invalid input manifest: " << line;
     }
     int64_t filesize = fields.size() > 1 ? folly::to<int64_t>(fields[1]) : -1;
     bool odirect = fields.size() > 2 ? folly::to<bool>(fields[2]) : dfltDirect;
     req.fileInfo.emplace_back(fields[0], filesize, odirect);
+    if (fields.size() > 3) {
+      req.fileInfo.back().priority = folly::to<int32_t>(fields[3]);
+    }
+    if (fields.size() > 4) {
+      req.fileInfo.back().deadlineMillis = folly::to<int64_t>(fields[4]);
+    }
   }
   req.disableDirectoryTraversal = true;
 }
@@ -284,6 +295,15 @@ int main(int argc, char *argv[]) {
       recOptions.enable_download_resumption = true;
       receiver.setRecoveryId(FLAGS_recovery_id);
     }
+    if (!FLAGS_downstream_url.empty()) {
+      WdtTransferRequest downstreamReq(FLAGS_downstream_url);
+      if (downstreamReq.errorCode != OK) {
+        LOG(ERROR) << "Invalid downstream url "
+                   << errorCodeToStr(downstreamReq.errorCode);
+        return ERROR;
+      }
+      receiver.setDownstreamRequest(downstreamReq);
+    }
     WdtTransferRequest augmentedReq = receiver.init();
     retCode = augmentedReq.errorCode;
     if (retCode == FEWER_PORTS) {